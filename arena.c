@@ -0,0 +1,179 @@
+/*
+ * File:   arena.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:31
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "project.h"
+#include "arena.h"
+#include "xprintf.h"
+
+// Fail the build if a phase layout outgrows the arena or moves from the
+// map in arena.h
+typedef char arena_cli_fits[(sizeof(arena_cli_t) == ARENA_SIZE) ? 1 : -1];
+typedef char arena_run_fits[(sizeof(arena_run_t) == ARENA_SIZE) ? 1 : -1];
+typedef char arena_used_at[(offsetof(arena_cli_t, used) == CMD_MAX_LINE) ? 1 : -1];
+typedef char arena_history_at[(offsetof(arena_cli_t, history) == CMD_MAX_LINE + 1) ? 1 : -1];
+typedef char arena_history_fits[(ARENA_HISTORY_SIZE >= ARENA_HISTORY_MIN) ? 1 : -1];
+typedef char arena_buffer_at[(offsetof(arena_run_t, op) == ARENA_MONITOR_SIZE) ? 1 : -1];
+typedef char arena_segment_size[(sizeof(sweep_segment_t) == SWEEP_SEGMENT_SIZE) ? 1 : -1];
+#if FEATURE_MONITOR
+typedef char arena_reply_at[(offsetof(arena_run_t, monitor_reply) == MONITOR_LINE_MAX) ? 1 : -1];
+#endif
+#if FEATURE_SWEEP
+typedef char arena_sweep_fits[(sizeof(((arena_run_t *)0)->op.sweep) <= sizeof(((arena_run_t *)0)->op.buffer)) ? 1 : -1];
+#endif
+
+#if FEATURE_MEMORY
+typedef struct {
+    const char *name;
+    uint8_t phase;
+    uint8_t offset;
+    uint8_t size;
+} arena_region_t;
+
+#define ARENA_REGION(phase, type, member) \
+    { #member, phase, offsetof(type, member), sizeof(((type *)0)->member) }
+
+static const arena_region_t _g_arena_layout[] = {
+    ARENA_REGION(ARENA_PHASE_CLI, arena_cli_t, line),
+    ARENA_REGION(ARENA_PHASE_CLI, arena_cli_t, used),
+    ARENA_REGION(ARENA_PHASE_CLI, arena_cli_t, history),
+#if FEATURE_MONITOR
+    ARENA_REGION(ARENA_PHASE_RUN, arena_run_t, monitor_line),
+    ARENA_REGION(ARENA_PHASE_RUN, arena_run_t, monitor_reply),
+#endif
+    ARENA_REGION(ARENA_PHASE_RUN, arena_run_t, op.buffer),
+#if FEATURE_SWEEP
+    ARENA_REGION(ARENA_PHASE_RUN, arena_run_t, op.sweep),
+#endif
+};
+#endif
+
+arena_t _g_arena;
+uint8_t _g_arena_phase;
+
+void arena_enter(uint8_t phase)
+{
+    memset(&_g_arena, 0, sizeof(_g_arena));
+    _g_arena_phase = phase;
+}
+
+#if FEATURE_MEMORY
+void arena_report(void)
+{
+    uint8_t i;
+
+    xprintf("Arena: %u bytes\r\n", ARENA_SIZE);
+
+    for (i = 0; i < sizeof(_g_arena_layout) / sizeof(_g_arena_layout[0]); i++)
+    {
+        const arena_region_t *region = &_g_arena_layout[i];
+        xprintf("  %s 0x%02x %3u %s\r\n",
+            region->phase == ARENA_PHASE_CLI ? "cli" : "run",
+            region->offset, region->size, region->name);
+    }
+
+    if (_g_arena_phase == ARENA_PHASE_CLI)
+        xprintf("History: %u commands in %u bytes\r\n", history_count(), _g_arena.cli.used);
+}
+#endif
+
+static bool history_match(const uint8_t *entry, const char *cmd, uint8_t len)
+{
+    uint8_t i;
+
+    if (entry[0] != len)
+        return false;
+
+    for (i = 0; i < len; i++)
+    {
+        if (toupper(entry[i + 1]) != toupper((uint8_t)cmd[i]))
+            return false;
+    }
+
+    return true;
+}
+
+static void history_remove(uint8_t offset)
+{
+    arena_cli_t *cli = &_g_arena.cli;
+    uint8_t size = cli->history[offset] + 1;
+
+    memmove(&cli->history[offset], &cli->history[offset + size], cli->used - offset - size);
+    cli->used -= size;
+}
+
+void history_add(const char *cmd, uint8_t len)
+{
+    arena_cli_t *cli = &_g_arena.cli;
+    uint8_t offset = 0;
+
+    if (_g_arena_phase != ARENA_PHASE_CLI || !len || len >= ARENA_HISTORY_SIZE)
+        return;
+
+    // A repeated command moves to the newest slot rather than taking another
+    while (offset < cli->used)
+    {
+        if (history_match(&cli->history[offset], cmd, len))
+        {
+            history_remove(offset);
+            break;
+        }
+        offset += cli->history[offset] + 1;
+    }
+
+    // Drop the oldest commands until the new one fits
+    while (cli->used + len + 1 > ARENA_HISTORY_SIZE)
+        history_remove(0);
+
+    cli->history[cli->used] = len;
+    memcpy(&cli->history[cli->used + 1], cmd, len);
+    cli->used += len + 1;
+}
+
+uint8_t history_count(void)
+{
+    arena_cli_t *cli = &_g_arena.cli;
+    uint8_t offset = 0;
+    uint8_t count = 0;
+
+    if (_g_arena_phase != ARENA_PHASE_CLI)
+        return 0;
+
+    while (offset < cli->used)
+    {
+        offset += cli->history[offset] + 1;
+        count++;
+    }
+
+    return count;
+}
+
+/* Copies the command 'age' entries back (1 is the newest) into buf */
+uint8_t history_copy(uint8_t age, char *buf)
+{
+    arena_cli_t *cli = &_g_arena.cli;
+    uint8_t count = history_count();
+    uint8_t offset = 0;
+    uint8_t len;
+
+    if (!age || age > count)
+        return 0;
+
+    for (count -= age; count; count--)
+        offset += cli->history[offset] + 1;
+
+    len = cli->history[offset];
+    memcpy(buf, &cli->history[offset + 1], len);
+    buf[len] = 0;
+
+    return len;
+}
@@ -0,0 +1,102 @@
+/*
+ * File:   arena.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:31
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "monitor.h"
+#include "config.h"
+
+#define ARENA_PHASE_CLI         0
+#define ARENA_PHASE_RUN         1
+
+/*
+ * Shared RAM arena. The same bytes are used by exactly one phase at a
+ * time:
+ *
+ *   CLI phase (config> prompt)
+ *     0x00  line             64 bytes, command or script line being typed
+ *     0x40  used             1 byte
+ *     0x41  history        >=127 bytes, packed [len][text] oldest first
+ *
+ *   Operation phase
+ *     0x00  monitor_line     12 bytes, live command line (FEATURE_MONITOR)
+ *     0x0C  monitor_reply    64 bytes, reply part being sent (FEATURE_MONITOR)
+ *     0x4C  buffer           the rest, carved up by run-time features:
+ *           sweep            96 bytes, per segment read-back totals (FEATURE_SWEEP)
+ *
+ * Without FEATURE_MONITOR the buffer starts at 0x00. The arena is as
+ * large as the larger phase in the build; when the operation phase is
+ * the larger, history gets the difference. Every offset and size above
+ * is checked at build time in arena.c and printed by the 'memory'
+ * command.
+ */
+#define ARENA_HISTORY_MIN       127
+#define ARENA_CLI_SIZE          (CMD_MAX_LINE + 1 + ARENA_HISTORY_MIN)
+
+#if FEATURE_MONITOR
+#define ARENA_MONITOR_SIZE      (MONITOR_LINE_MAX + MONITOR_REPLY_MAX)
+#else
+#define ARENA_MONITOR_SIZE      0
+#endif
+
+#define SWEEP_SEGMENT_SIZE      12
+#if FEATURE_SWEEP
+#define ARENA_SWEEP_SIZE        (SWEEP_MAX_STEPS * SWEEP_SEGMENT_SIZE)
+#else
+#define ARENA_SWEEP_SIZE        0
+#endif
+
+#define ARENA_RUN_SIZE          (ARENA_MONITOR_SIZE + ARENA_SWEEP_SIZE)
+#define ARENA_SIZE              (ARENA_RUN_SIZE > ARENA_CLI_SIZE ? ARENA_RUN_SIZE : ARENA_CLI_SIZE)
+#define ARENA_HISTORY_SIZE      (ARENA_SIZE - CMD_MAX_LINE - 1)
+
+typedef struct {
+    char line[CMD_MAX_LINE];
+    uint8_t used;
+    uint8_t history[ARENA_HISTORY_SIZE];
+} arena_cli_t;
+
+typedef struct {
+    int16_t start;          // Tach position the segment was written from
+    uint16_t transitions;
+    uint32_t ticks;         // Timer1 counts from the first transition to the last
+    uint32_t deviation;     // Sum of |interval - nominal| in instruction cycles
+} sweep_segment_t;
+
+typedef struct {
+#if FEATURE_MONITOR
+    char monitor_line[MONITOR_LINE_MAX];
+    char monitor_reply[MONITOR_REPLY_MAX];
+#endif
+    union {
+        uint8_t buffer[ARENA_SIZE - ARENA_MONITOR_SIZE];
+#if FEATURE_SWEEP
+        sweep_segment_t sweep[SWEEP_MAX_STEPS];
+#endif
+    } op;
+} arena_run_t;
+
+typedef union {
+    arena_cli_t cli;
+    arena_run_t run;
+} arena_t;
+
+extern arena_t _g_arena;
+extern uint8_t _g_arena_phase;
+
+void arena_enter(uint8_t phase);
+void arena_report(void);
+
+void history_add(const char *cmd, uint8_t len);
+uint8_t history_count(void);
+uint8_t history_copy(uint8_t age, char *buf);
+
+#endif /* __ARENA_H__ */
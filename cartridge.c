@@ -0,0 +1,202 @@
+/*
+ * File:   cartridge.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:10
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+#include "util.h"
+#include "xprintf.h"
+#include "telemetry.h"
+#include "cartridge.h"
+
+#if FEATURE_CARTRIDGE
+
+/*
+ * Nominal lengths and hole spacings. Entry 0 stands in for a cartridge
+ * that has not been measured or matched nothing. Check the spacings
+ * against a known cartridge before relying on a new entry.
+ */
+static const cartridge_type_t _g_cartridge_types[] = {
+    { "unknown",   0,  0 },
+    { "DC300XL", 450, 36 },
+    { "DC600A",  600, 36 },
+    { "DC6150",  620, 48 },
+};
+
+#define CARTRIDGE_TYPES     (sizeof(_g_cartridge_types) / sizeof(_g_cartridge_types[0]))
+
+// Hole spacing as a share of the tape length, in parts per 100000
+#define HOLE_SCALE          100000UL
+
+typedef char cartridge_fits[(CARTRIDGE_TYPES <= 0xFF) ? 1 : -1];
+
+static uint32_t expected_ms(const cartridge_type_t *type)
+{
+    return ((uint32_t)type->length_ft * 12 * 1000) / CARTRIDGE_IPS;
+}
+
+static uint16_t permille_error(uint32_t measured, uint32_t nominal)
+{
+    uint32_t diff = (measured > nominal) ? measured - nominal : nominal - measured;
+
+    diff = (diff * 1000) / nominal;
+
+    return (diff > 0xFFFF) ? 0xFFFF : (uint16_t)diff;
+}
+
+/*
+ * Classifies the cartridge after a full forward leg at normal speed.
+ * The leg time narrows the candidates, which on its own cannot split
+ * cartridges a few percent apart in length; the EW to EOT spacing as a
+ * share of the tach count does that without knowing the tach scale.
+ */
+bool cartridge_detect(sys_runstate_t *rs)
+{
+    const cartridge_type_t *type;
+    uint16_t best = 0xFFFF;
+    uint32_t share = 0;
+    uint16_t score;
+    uint16_t hole_error;
+    uint8_t i;
+
+    rs->cartridge = CARTRIDGE_UNKNOWN;
+    rs->cartridge_measured = true;
+    rs->tape_tach = (rs->eot_position > 0) ? (uint16_t)rs->eot_position : 0;
+    rs->hole_tach = 0;
+
+    // The EW hole only counts when it was seen between BOT and EOT
+    if (rs->ew_position > 0 && rs->ew_position < rs->eot_position)
+    {
+        rs->hole_tach = (uint16_t)(rs->eot_position - rs->ew_position);
+        share = ((uint32_t)rs->hole_tach * HOLE_SCALE) / rs->tape_tach;
+    }
+
+    for (i = 1; i < CARTRIDGE_TYPES; i++)
+    {
+        type = &_g_cartridge_types[i];
+
+        score = permille_error(rs->leg_ms, expected_ms(type));
+        if (score > CARTRIDGE_TIME_TOLERANCE)
+            continue;
+
+        if (share)
+        {
+            hole_error = permille_error(share,
+                ((uint32_t)type->ew_in * HOLE_SCALE) / ((uint32_t)type->length_ft * 12));
+
+            if (hole_error > CARTRIDGE_HOLE_TOLERANCE)
+                continue;
+
+            score += hole_error;
+        }
+
+        if (score < best)
+        {
+            best = score;
+            rs->cartridge = i;
+        }
+    }
+
+    progress("Cartridge: %s\r\n", cartridge_name(rs));
+
+    return rs->cartridge != CARTRIDGE_UNKNOWN;
+}
+
+void cartridge_forget(sys_runstate_t *rs)
+{
+    rs->cartridge = CARTRIDGE_UNKNOWN;
+    rs->cartridge_measured = false;
+    rs->tape_tach = 0;
+    rs->hole_tach = 0;
+}
+
+/*
+ * Expected end to end time at normal speed. Until the cartridge is known
+ * this allows for anything up to the longest tape in use.
+ */
+uint32_t cartridge_leg_ms(const sys_runstate_t *rs)
+{
+    if (rs->cartridge == CARTRIDGE_UNKNOWN)
+        return CARTRIDGE_UNKNOWN_LEG_MS;
+
+    return expected_ms(&_g_cartridge_types[rs->cartridge]);
+}
+
+const char *cartridge_name(const sys_runstate_t *rs)
+{
+    return _g_cartridge_types[rs->cartridge].name;
+}
+
+/*
+ * Appends a distance and share of the tape to a position report, once
+ * the tach count for the whole tape is known.
+ */
+void cartridge_where(const sys_runstate_t *rs, int16_t position)
+{
+    uint32_t done;
+
+    if (rs->cartridge == CARTRIDGE_UNKNOWN || !rs->tape_tach)
+        return;
+
+    done = (position > 0) ? (uint32_t)position : 0;
+    if (done > rs->tape_tach)
+        done = rs->tape_tach;
+
+    xprintf(" (%lu ft, %lu%%)",
+        (done * _g_cartridge_types[rs->cartridge].length_ft) / rs->tape_tach,
+        (done * 100) / rs->tape_tach);
+}
+
+/* One part per call, as for odometer_report(); false past the last */
+bool cartridge_report(const sys_runstate_t *rs, uint8_t part)
+{
+    const cartridge_type_t *type = &_g_cartridge_types[rs->cartridge];
+    char buf[MAX_FDP];
+
+    if (!rs->cartridge_measured)
+    {
+        if (part)
+            return false;
+
+        xprintf("Cartridge: not measured, needs a full forward leg\r\n");
+        return true;
+    }
+
+    switch (part)
+    {
+        case 0:
+        {
+            xprintf("Cartridge: %s", type->name);
+            if (rs->cartridge != CARTRIDGE_UNKNOWN)
+                xprintf(", %u ft, EW hole %u in before EOT", type->length_ft, type->ew_in);
+            xprintf("\r\n");
+            break;
+        }
+        case 1:
+        {
+            xprintf("Measured: %u tach BOT to EOT, %u tach EW to EOT\r\n", rs->tape_tach, rs->hole_tach);
+            break;
+        }
+        case 2:
+        {
+            format_fixedpoint(buf, (int16_t)(cartridge_leg_ms(rs) / 100), U_1DP);
+            xprintf("Expected leg: %s s ", buf);
+            format_fixedpoint(buf, (int16_t)(rs->normal_leg_ms / 100), U_1DP);
+            xprintf("last normal speed leg: %s s\r\n", buf);
+            break;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* FEATURE_CARTRIDGE */
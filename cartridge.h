@@ -0,0 +1,45 @@
+/*
+ * File:   cartridge.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:10
+ */
+
+#ifndef __CARTRIDGE_H__
+#define __CARTRIDGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+
+#define CARTRIDGE_UNKNOWN           0
+#define CARTRIDGE_IPS               90          /* normal tape speed, inches per second */
+#define CARTRIDGE_UNKNOWN_LEG_MS    200000UL    /* longer than any cartridge in the table */
+#define CARTRIDGE_TIME_TOLERANCE    60          /* permille */
+#define CARTRIDGE_HOLE_TOLERANCE    150         /* permille */
+
+/*
+ * Nominal figures for one cartridge type. The hole spacing is from the
+ * early warning hole to the EOT hole, the part of the layout the sensors
+ * see on every forward traversal.
+ */
+typedef struct {
+    const char *name;
+    uint16_t length_ft;
+    uint8_t ew_in;
+} cartridge_type_t;
+
+#if FEATURE_CARTRIDGE
+bool cartridge_detect(sys_runstate_t *rs);
+void cartridge_forget(sys_runstate_t *rs);
+uint32_t cartridge_leg_ms(const sys_runstate_t *rs);
+const char *cartridge_name(const sys_runstate_t *rs);
+void cartridge_where(const sys_runstate_t *rs, int16_t position);
+bool cartridge_report(const sys_runstate_t *rs, uint8_t part);
+#else
+#define cartridge_forget(rs)            ((void)0)
+#define cartridge_leg_ms(rs)            CARTRIDGE_UNKNOWN_LEG_MS
+#endif
+
+#endif /* __CARTRIDGE_H__ */
@@ -6,7 +6,6 @@
  */
 
 
-#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -15,8 +14,15 @@
 #include "project.h"
 #include "config.h"
 #include "util.h"
+#include "xprintf.h"
 #include "usart.h"
 #include "iopins.h"
+#include "arena.h"
+#include "script.h"
+#include "plan.h"
+#include "odometer.h"
+#include "timers.h"
+#include "pattern.h"
 
 #define CMD_NONE              0x00
 #define CMD_READLINE          0x01
@@ -45,14 +51,16 @@
 #define SEQ_PGDN              0x36
 #define SEQ_NAV_END           0x7E
 
-#define CMD_MAX_LINE          64
-#define CMD_MAX_HISTORY       4
+#define TUNE_TRIALS           5
+#define TUNE_TIMEOUT_MS       5000
+#define TUNE_MARGIN_MS        100
+#define TUNE_RESET_MIN_MS     20     /* below this a reset cannot be told from none */
 
 #define PARAM_U16             1
 #define PARAM_U8              2
 #define PARAM_DESC            3
 
-static inline int8_t configuration_prompt_handler(char *message, sys_config_t *config);
+static inline int8_t configuration_prompt_handler(char *message, sys_config_t *config, uint8_t *ignore_lf);
 static int8_t get_line(char *str, int8_t max, uint8_t *ignore_lf);
 static int get_string(char *str, int8_t max, uint8_t *ignore_lf);
 static uint8_t parse_param(void *param, uint8_t type, char *arg);
@@ -64,41 +72,192 @@ static uint8_t do_reset_drive(char *arg);
 static uint8_t do_select_track(char *arg);
 static uint8_t do_go_drive(char *arg);
 static uint8_t do_state(char *arg);
+#if FEATURE_TRACKS
+static uint8_t do_tracks(char *arg, sys_config_t *config);
+#endif
+#if FEATURE_HIGHSPEED
+static uint8_t do_highspeed(char *arg, sys_config_t *config);
+#endif
+#if FEATURE_TUNE
+static uint8_t do_tune(sys_config_t *config);
+#endif
+#if FEATURE_SWEEP
+static uint8_t do_sweep(char *arg, sys_config_t *config);
+#endif
+#if FEATURE_PATTERN
+static uint8_t do_pattern(char *arg, sys_config_t *config);
+#endif
+#if FEATURE_SCRIPT
+static int8_t do_script(char *arg, sys_config_t *config, uint8_t *ignore_lf);
+#endif
+
+// Operations left out of the build have no name, so they cannot be picked
+#define OPERATION_NAME(feature, name)   ((feature) ? (name) : "")
 
-uint8_t _g_max_history;
 uint8_t _g_show_history;
-uint8_t _g_next_history;
-char _g_cmd_history[CMD_MAX_HISTORY][CMD_MAX_LINE];
+
+#if FEATURE_HIGHSPEED
+static const char * const _g_hsd_names[] = {
+    "rewind", "reposition", "slowdown"
+};
+#endif
+
+static const char * const _g_operation_names[] = {
+    "none", "exercise", "writetest", "rewind",
+    OPERATION_NAME(FEATURE_SCRIPT, "script"),
+    OPERATION_NAME(FEATURE_RETENSION, "retension"),
+    OPERATION_NAME(FEATURE_ERASE, "erase"),
+    OPERATION_NAME(FEATURE_RAMP, "ramp"),
+    OPERATION_NAME(FEATURE_SHUTTLE, "exercise shuttle"),
+    OPERATION_NAME(FEATURE_SWEEP, "sweep")
+};
+
+#define OPERATIONS          (sizeof(_g_operation_names) / sizeof(_g_operation_names[0]))
 
 static void do_help(void)
 {
-    printf(
+    xputs(
         "\r\nCommands:\r\n\r\n"
-        "\toperation none|exercise|rewind|writetest\r\n"
+        "\toperation none|exercise"
+#if FEATURE_SHUTTLE
+        "|exercise shuttle"
+#endif
+        "|rewind|writetest"
+#if FEATURE_SCRIPT
+        "|script"
+#endif
+#if FEATURE_RETENSION
+        "|retension"
+#endif
+#if FEATURE_ERASE
+        "|erase"
+#endif
+#if FEATURE_RAMP
+        "|ramp"
+#endif
+#if FEATURE_SWEEP
+        "|sweep"
+#endif
+        "\r\n"
         "\t\tIn the case of 'writetest' Ensure 150.15 KHz test signal input\r\n"
+#if FEATURE_RETENSION
+        "\t\t'retension' runs BOT to EOT and back at high speed, never writing\r\n"
+#endif
+#if FEATURE_ERASE
+        "\t\t'erase' bulk erases the whole cartridge in one BOT to EOT pass\r\n"
+#endif
+#if FEATURE_RAMP
+        "\t\t'ramp' times motor start and stop in both directions\r\n"
+#endif
+#if FEATURE_SHUTTLE
+        "\t\t'exercise shuttle' makes random short moves, reversals and track changes\r\n"
+#endif
+#if FEATURE_SWEEP
+        "\t\t'sweep' writes a segment per sweep frequency on each track and reads it back\r\n"
+        "\t\tThe on chip tone covers 25-60 kHz only, below the 150 kHz working band\r\n"
+        "\t\tDisconnect the external test signal first, the write gate passes it too\r\n"
+#endif
+#if FEATURE_PATTERN
+        "\tpattern 0-8|all external|all|isolated|prbs\r\n"
+        "\t\tWrite test pattern per track. All but 'external' are made on chip\r\n"
+        "\t\tand need the external test signal disconnected\r\n"
+        "\tpatternrate 25-60\r\n"
+        "\t\tOn chip pattern speed, as the kHz the 'all' pattern writes at\r\n"
+#endif
+#if FEATURE_TELEMETRY
+        "\ttelemetry 0-65535\r\n"
+        "\t\tSend a 16 byte binary status frame every this many ms while running,\r\n"
+        "\t\tin place of progress text. 0 turns it off\r\n"
+        "\ttachstream 0|1\r\n"
+        "\t\tSend the timestamp of every tach edge in binary frames while running,\r\n"
+        "\t\tfor wow and flutter analysis on the host. Replaces progress text\r\n"
+#endif
+#if FEATURE_SWEEP
+        "\tsweep <kHz>[,<kHz>...]\r\n"
+        "\t\tUp to 8 write frequencies for 'sweep', 25-60 kHz\r\n"
+#endif
+#if FEATURE_SHUTTLE
+        "\tseed 0-65535\r\n"
+        "\t\tStarting point for 'exercise shuttle'; the same seed repeats the same run\r\n"
+#endif
+#if FEATURE_RAMP
+        "\trampms 0-65535\r\n"
+        "\t\tLongest acceptable time to reach speed in the ramp test\r\n"
+        "\tramptach 0-255\r\n"
+        "\t\tLongest acceptable stopping distance in tach counts\r\n"
+#endif
+#if FEATURE_ERASE
+        "\teraseverify 0|1\r\n"
+        "\t\tCount read transitions on the way back to BOT after an erase\r\n"
+#endif
+#if FEATURE_RETENSION
+        "\tbatch 0|1\r\n"
+        "\t\tAfter a retension wait for the cartridge to be swapped and go again\r\n"
+#endif
         "\tstopat 0-8\r\n"
         "\t\tThe index of the last track to record when writing a test tape\r\n"
+#if FEATURE_TRACKS
+        "\ttracks default|all|<n>[,<n>...]\r\n"
+        "\t\tTrack set for exercise and writetest, run in the order needing\r\n"
+        "\t\tthe fewest tape traversals. 'default' uses 0..stopat for writetest\r\n"
+#endif
+#if FEATURE_HIGHSPEED
+        "\thighspeed none|<rewind,reposition,slowdown>\r\n"
+        "\t\tUse HSD for rewinds and empty legs, optionally dropping back to\r\n"
+        "\t\tnormal speed when the tape leaves the data zone\r\n"
+#endif
+#if FEATURE_TUNE
+        "\tresetpulse 1-255\r\n"
+        "\t\tDrive reset pulse in ms\r\n"
+        "\tsettle 0-255\r\n"
+        "\t\tWait after a drive reset before selecting, in 10 ms units\r\n"
+        "\ttune\r\n"
+        "\t\tMeasure this drive's shortest reset pulse and settle time\r\n"
+#endif
         "\tdriveselect|s 0|1\r\n"
         "\tdrivereset|r\r\n"
         "\tdrivego|g f|fwd r|rev s|stop\r\n"
         "\tdrivetrack|r 0-8\r\n"
         "\t\tOnly observed by drive at EOT/BOT and only before motor start\r\n"
         "\tdrivestate|t\r\n"
+#if FEATURE_SCRIPT
+        "\tscript load|list|run 0-1\r\n"
+        "\t\tload takes one step per line, finish with 'end':\r\n"
+        "\t\tselect 0|1, track 0-8, go fwd|rev|stop, wait bot|eot|ew|data [1-255 s],\r\n"
+        "\t\tdelay 1-65535, write off|on|erase, loop 1-255 ... next, report\r\n"
+#endif
+#if FEATURE_MEMORY
+        "\tmemory\r\n"
+        "\t\tShow the shared RAM arena layout\r\n"
+#endif
+#if FEATURE_ODOMETER
+        "\todometer\r\n"
+        "\t\tShow lifetime passes, motor time, selects and resets\r\n"
+#endif
         "\trun [none|exercise|rewind|writetesttape]\r\n"
+        "\r\nWhile running:\r\n\r\n"
+#if FEATURE_MONITOR
+        "\tstatus|where|speed|stats"
+#if FEATURE_ODOMETER
+        "|odometer"
+#endif
+        "|pause|resume|abort\r\n"
+#endif
+        "\t\tCtrl+D stops the drive immediately and resets\r\n"
         "\r\n"
     );
 }
 
 void configuration_bootprompt(sys_config_t *config)
 {
-    char cmdbuf[64];
+    char *cmdbuf = _g_arena.cli.line;
     uint8_t i;
     int8_t enter_bootpromt = 0;
     uint8_t ignore_lf = 0;
     
     if (config->operation != OPERATION_NONE)
     {
-        printf("<Press Ctrl+C to enter configuration prompt>\r\n");
+        xprintf("<Press Ctrl+C to enter configuration prompt>\r\n");
 
         for (i = 0; i < 100; i++)
         {
@@ -122,24 +281,26 @@ void configuration_bootprompt(sys_config_t *config)
     if (!enter_bootpromt)
         return;
 
-    printf("\r\n");
+    arena_enter(ARENA_PHASE_CLI);
+
+    xprintf("\r\n");
     
     for (;;)
     {
         int8_t ret;
 
-        printf("config>");
-        ret = get_line(cmdbuf, sizeof(cmdbuf), &ignore_lf);
+        xprintf("config>");
+        ret = get_line(cmdbuf, CMD_MAX_LINE, &ignore_lf);
 
         if (ret == 0 || ret == -1) {
-            printf("\r\n");
+            xprintf("\r\n");
             continue;
         }
 
-        ret = configuration_prompt_handler(cmdbuf, config);
+        ret = configuration_prompt_handler(cmdbuf, config, &ignore_lf);
 
         if (ret > 0)
-            printf("Error: command failed\r\n");
+            xprintf("Error: command failed\r\n");
 
         if (ret == -1) {
             return;
@@ -147,16 +308,97 @@ void configuration_bootprompt(sys_config_t *config)
     }
 }
 
+const char *operation_name(uint8_t operation)
+{
+    if (operation >= OPERATIONS)
+        return "?";
+
+    return _g_operation_names[operation];
+}
+
 static void do_show(sys_config_t *config)
 {
-    printf(
+#if FEATURE_TRACKS || FEATURE_HIGHSPEED || FEATURE_PATTERN || FEATURE_SWEEP
+    uint8_t track;
+#endif
+
+    xprintf(
             "\r\nCurrent configuration:\r\n\r\n"
         );
 
-    printf("\r\n");
+    xprintf("Operation: %s\r\n", operation_name(config->operation));
+    xprintf("Stop at track: %u\r\n", config->stopat_track);
+#if FEATURE_TRACKS
+    xprintf("Tracks: ");
+
+    if (!config->track_mask)
+    {
+        xprintf("default");
+    }
+    else
+    {
+        for (track = 0; track <= MAX_TRACK; track++)
+        {
+            if (config->track_mask & (1 << track))
+                xprintf("%u ", track);
+        }
+    }
+
+    xprintf("\r\n");
+#endif
+#if FEATURE_HIGHSPEED
+    xprintf("High speed: ");
+
+    for (track = 0; track < sizeof(_g_hsd_names) / sizeof(_g_hsd_names[0]); track++)
+    {
+        if (config->hsd_flags & (1 << track))
+            xprintf("%s ", _g_hsd_names[track]);
+    }
+
+    xprintf("\r\n");
+#endif
+#if FEATURE_SCRIPT
+    xprintf("Script slot: %u\r\n", config->script_slot);
+#endif
+#if FEATURE_RETENSION
+    xprintf("Batch: %u\r\n", config->batch);
+#endif
+#if FEATURE_ERASE
+    xprintf("Erase verify: %u\r\n", config->erase_verify);
+#endif
+#if FEATURE_TUNE
+    xprintf("Reset pulse: %u ms settle: %u0 ms\r\n", config->reset_ms, config->settle_10ms);
+#endif
+#if FEATURE_RAMP
+    xprintf("Ramp limits: %u ms to speed, %u tach to stop\r\n", config->ramp_max_ms, config->ramp_max_tach);
+#endif
+#if FEATURE_SHUTTLE
+    xprintf("Shuttle seed: %u\r\n", config->shuttle_seed);
+#endif
+#if FEATURE_TELEMETRY
+    xprintf("Telemetry: %u ms\r\n", config->telemetry_ms);
+    xprintf("Tach stream: %u\r\n", config->tach_stream);
+#endif
+#if FEATURE_PATTERN
+    xprintf("Patterns:");
+
+    for (track = 0; track <= MAX_TRACK; track++)
+        xprintf(" %u:%s", track, pattern_name(PATTERN_FOR_TRACK(config->track_patterns, track)));
+
+    xprintf(" at %u kHz\r\n", config->pattern_khz);
+#endif
+#if FEATURE_SWEEP
+    xprintf("Sweep kHz:");
+
+    for (track = 0; track < SWEEP_MAX_STEPS && config->sweep_khz[track]; track++)
+        xprintf(" %u", config->sweep_khz[track]);
+
+    xprintf("\r\n");
+#endif
+    xprintf("\r\n");
 }
 
-static inline int8_t configuration_prompt_handler(char *text, sys_config_t *config)
+static inline int8_t configuration_prompt_handler(char *text, sys_config_t *config, uint8_t *ignore_lf)
 {
     char *command;
     char *arg;
@@ -168,7 +410,7 @@ static inline int8_t configuration_prompt_handler(char *text, sys_config_t *conf
         int8_t operation = parse_operation_arg(arg);
         if (operation < 0)
         {
-            printf("Error: Missing or invalid parameter\r\n");
+            xprintf("Error: Missing or invalid parameter\r\n");
             return 1;
         }
         config->operation = operation;
@@ -176,6 +418,80 @@ static inline int8_t configuration_prompt_handler(char *text, sys_config_t *conf
     if (!stricmp(command, "stopat")) {
         return parse_param(&config->stopat_track, PARAM_U8, arg);
     }
+#if FEATURE_RETENSION
+    else if (!stricmp(command, "batch")) {
+        return parse_param(&config->batch, PARAM_U8, arg);
+    }
+#endif
+#if FEATURE_PATTERN
+    else if (!stricmp(command, "pattern")) {
+        return do_pattern(arg, config);
+    }
+    else if (!stricmp(command, "patternrate")) {
+        uint8_t khz = config->pattern_khz;
+
+        if (parse_param(&khz, PARAM_U8, arg) || khz < PATTERN_MIN_KHZ || khz > PATTERN_MAX_KHZ)
+        {
+            xprintf("Error: Rate must be %u-%u kHz\r\n", PATTERN_MIN_KHZ, PATTERN_MAX_KHZ);
+            return 1;
+        }
+
+        config->pattern_khz = khz;
+        return 0;
+    }
+#endif
+#if FEATURE_TELEMETRY
+    else if (!stricmp(command, "telemetry")) {
+        return parse_param(&config->telemetry_ms, PARAM_U16, arg);
+    }
+    else if (!stricmp(command, "tachstream")) {
+        return parse_param(&config->tach_stream, PARAM_U8, arg);
+    }
+#endif
+#if FEATURE_SWEEP
+    else if (!stricmp(command, "sweep")) {
+        return do_sweep(arg, config);
+    }
+#endif
+#if FEATURE_SHUTTLE
+    else if (!stricmp(command, "seed")) {
+        return parse_param(&config->shuttle_seed, PARAM_U16, arg);
+    }
+#endif
+#if FEATURE_RAMP
+    else if (!stricmp(command, "rampms")) {
+        return parse_param(&config->ramp_max_ms, PARAM_U16, arg);
+    }
+    else if (!stricmp(command, "ramptach")) {
+        return parse_param(&config->ramp_max_tach, PARAM_U8, arg);
+    }
+#endif
+#if FEATURE_TUNE
+    else if (!stricmp(command, "resetpulse")) {
+        return parse_param(&config->reset_ms, PARAM_U8, arg);
+    }
+    else if (!stricmp(command, "settle")) {
+        return parse_param(&config->settle_10ms, PARAM_U8, arg);
+    }
+    else if (!stricmp(command, "tune")) {
+        return do_tune(config);
+    }
+#endif
+#if FEATURE_ERASE
+    else if (!stricmp(command, "eraseverify")) {
+        return parse_param(&config->erase_verify, PARAM_U8, arg);
+    }
+#endif
+#if FEATURE_TRACKS
+    else if (!stricmp(command, "tracks")) {
+        return do_tracks(arg, config);
+    }
+#endif
+#if FEATURE_HIGHSPEED
+    else if (!stricmp(command, "highspeed")) {
+        return do_highspeed(arg, config);
+    }
+#endif
     else if (!stricmp(command, "driveselect") || !stricmp(command, "s")) {
         return do_select_drive(arg);
     }
@@ -193,16 +509,16 @@ static inline int8_t configuration_prompt_handler(char *text, sys_config_t *conf
     }
     else if (!stricmp(command, "save")) {
         save_configuration(config);
-        printf("\r\nConfiguration saved.\r\n\r\n");
+        xprintf("\r\nConfiguration saved.\r\n\r\n");
         return 0;
     }
     else if (!stricmp(command, "default")) {
         default_configuration(config);
-        printf("\r\nDefault configuration loaded.\r\n\r\n");
+        xprintf("\r\nDefault configuration loaded.\r\n\r\n");
         return 0;
     }
     else if (!stricmp(command, "run")) {
-        printf("\r\nStarting...\r\n");
+        xprintf("\r\nStarting...\r\n");
         
         if (arg && *arg)
         {
@@ -217,6 +533,26 @@ static inline int8_t configuration_prompt_handler(char *text, sys_config_t *conf
         
         return -1;
     }
+#if FEATURE_SCRIPT
+    else if (!stricmp(command, "script")) {
+        return do_script(arg, config, ignore_lf);
+    }
+#endif
+#if FEATURE_MEMORY
+    else if (!stricmp(command, "memory")) {
+        arena_report();
+        return 0;
+    }
+#endif
+#if FEATURE_ODOMETER
+    else if (!stricmp(command, "odometer")) {
+        uint8_t part = 0;
+
+        while (odometer_report(part))
+            part++;
+        return 0;
+    }
+#endif
     else if (!stricmp(command, "show")) {
         do_show(config);
     }
@@ -226,7 +562,7 @@ static inline int8_t configuration_prompt_handler(char *text, sys_config_t *conf
     }
     else
     {
-        printf("Error: no such command (%s)\r\n", command);
+        xprintf("Error: no such command (%s)\r\n", command);
         return 1;
     }
 
@@ -234,31 +570,20 @@ static inline int8_t configuration_prompt_handler(char *text, sys_config_t *conf
 }
 
 static int8_t parse_operation_arg(const char *arg)
-{        
+{
+    uint8_t operation;
+
     if (!arg || !*arg)
         return -1;
-    
-    if (!stricmp(arg, "none"))
-    {
-        return OPERATION_NONE;
-    }
-    else if (!stricmp(arg, "exercise"))
-    {
-        return OPERATION_EXERCISE;
-    }
-    else if (!stricmp(arg, "writetest"))
-    {
-        return OPERATION_WRITE_TEST;
-    }
-    else if (!stricmp(arg, "rewind"))
-    {
-        return OPERATION_REWIND;
-    }
-    else
+
+    for (operation = 0; operation < OPERATIONS; operation++)
     {
-        printf("Error: Invalid operation\r\n");
-        return -1;
+        if (!stricmp(arg, _g_operation_names[operation]))
+            return operation;
     }
+
+    xprintf("Error: Invalid operation\r\n");
+    return -1;
 }
 
 static uint8_t do_select_drive(char *arg)
@@ -284,7 +609,7 @@ static uint8_t do_go_drive(char *arg)
     
     if (!arg || !*arg)
     {
-        printf("Error: Missing parameter\r\n");
+        xprintf("Error: Missing parameter\r\n");
         return 1;
     }
 
@@ -304,7 +629,7 @@ static uint8_t do_go_drive(char *arg)
     }
     else
     {
-        printf("Error: Invalid parameter\r\n");
+        xprintf("Error: Invalid parameter\r\n");
         return 1;
     }
     
@@ -326,7 +651,7 @@ static uint8_t do_select_track(char *arg)
     
     if (track > 8)
     {
-        printf("Error: Invalid parameter\r\n");
+        xprintf("Error: Invalid parameter\r\n");
         return 1;
     }
     
@@ -344,17 +669,362 @@ static uint8_t do_reset_drive(char *arg)
 static uint8_t do_state(char *arg)
 {
     if (!LTHbit && !UTHbit)
-        printf("TAPE_ZONE_BOT\r\n");
+        xprintf("TAPE_ZONE_BOT\r\n");
     if (UTHbit && !LTHbit)
-        printf("TAPE_ZONE_EOT\r\n");
+        xprintf("TAPE_ZONE_EOT\r\n");
     if (!UTHbit && LTHbit)
-        printf("TAPE_ZONE_EW\r\n");
+        xprintf("TAPE_ZONE_EW\r\n");
     if (UTHbit && LTHbit)
-        printf("TAPE_ZONE_DATA\r\n");
+        xprintf("TAPE_ZONE_DATA\r\n");
     
     return 0;
 }
 
+#if FEATURE_TRACKS
+static uint8_t do_tracks(char *arg, sys_config_t *config)
+{
+    uint16_t mask = 0;
+    char *token;
+
+    if (!arg || !*arg)
+    {
+        xprintf("Error: Missing parameter\r\n");
+        return 1;
+    }
+
+    if (!stricmp(arg, "default"))
+    {
+        config->track_mask = 0;
+        return 0;
+    }
+
+    if (!stricmp(arg, "all"))
+    {
+        config->track_mask = ALL_TRACKS;
+        return 0;
+    }
+
+    for (token = strtok(arg, ","); token; token = strtok(NULL, ","))
+    {
+        uint8_t track = (uint8_t)atoi(token);
+
+        if (track > MAX_TRACK)
+        {
+            xprintf("Error: Invalid parameter\r\n");
+            return 1;
+        }
+
+        mask |= (1 << track);
+    }
+
+    config->track_mask = mask;
+
+    return 0;
+}
+#endif
+
+#if FEATURE_TUNE
+/* Time from the end of the reset pulse until the drive answers a select */
+static uint16_t measure_select_ms(void)
+{
+    uint16_t ms;
+
+    drive_reset();
+    ASSERT(DS0);
+
+    for (ms = 0; ms < TUNE_TIMEOUT_MS; ms++)
+    {
+        if (INPUT_ASSERTED(SLD))
+            break;
+        __delay_ms(1);
+    }
+
+    DEASSERT(DS0);
+
+    return ms;
+}
+
+/*
+ * Runs TUNE_TRIALS resets with the current pulse and records the slowest
+ * and quickest select. Stops at the first trial that times out or comes
+ * in under min_ms, and returns false for it.
+ */
+static bool select_trials(uint16_t min_ms, bool verbose, uint16_t *slowest, uint16_t *quickest)
+{
+    uint8_t i;
+
+    *slowest = 0;
+    *quickest = TUNE_TIMEOUT_MS;
+
+    for (i = 0; i < TUNE_TRIALS; i++)
+    {
+        uint16_t ms = measure_select_ms();
+
+        if (verbose)
+            xprintf("Trial %u: selected %u ms after reset\r\n", i + 1, ms);
+
+        if (ms >= TUNE_TIMEOUT_MS || ms < min_ms)
+            return false;
+
+        if (ms > *slowest)
+            *slowest = ms;
+        if (ms < *quickest)
+            *quickest = ms;
+
+        delay_10ms(50);
+    }
+
+    return true;
+}
+
+static uint8_t do_tune(sys_config_t *config)
+{
+    uint8_t previous_settle = config->settle_10ms;
+    uint8_t previous_reset = config->reset_ms;
+    uint16_t worst;
+    uint16_t quickest;
+    uint16_t slow;
+    uint16_t quick;
+    uint16_t settle;
+    uint8_t pulse;
+
+    if (!select_trials(0, true, &worst, &quickest))
+    {
+        xprintf("Error: Drive did not respond to select request.\r\n");
+        return 1;
+    }
+
+    // A quarter on top of the slowest trial plus a fixed margin
+    settle = worst + (worst / 4) + TUNE_MARGIN_MS;
+    config->settle_10ms = (uint8_t)min_((settle + 9) / 10, 255);
+
+    // A pulse the drive ignores leaves it answering the select at once, so
+    // the shortest pulse that still holds off every select for half the
+    // quickest full reset is taken as accepted, then doubled
+    pulse = previous_reset;
+
+    if (quickest >= TUNE_RESET_MIN_MS)
+    {
+        for (pulse = 1; pulse < previous_reset; pulse++)
+        {
+            config->reset_ms = pulse;
+
+            if (select_trials(quickest / 2, false, &slow, &quick))
+                break;
+
+            xprintf("Reset pulse %u ms: ignored\r\n", pulse);
+        }
+    }
+    else
+    {
+        xprintf("Drive selects too soon after reset to measure the pulse\r\n");
+    }
+
+    config->reset_ms = (uint8_t)min_(pulse * 2, previous_reset);
+
+    // Confirm with the same sequence the operations use
+    drive_reset();
+    delay_10ms(config->settle_10ms);
+
+    if (!drive_select(true))
+    {
+        config->settle_10ms = previous_settle;
+        config->reset_ms = previous_reset;
+        return 1;
+    }
+
+    drive_select(false);
+
+    xprintf("Reset pulse set to %u ms (was %u ms), settle to %u0 ms (was %u0 ms). Use 'save' to keep them.\r\n",
+        config->reset_ms, previous_reset, config->settle_10ms, previous_settle);
+
+    return 0;
+}
+#endif
+
+#if FEATURE_PATTERN
+static uint8_t do_pattern(char *arg, sys_config_t *config)
+{
+    char *which = strtok(arg, " ");
+    char *name = strtok(NULL, " ");
+    uint8_t pattern;
+    uint8_t track;
+
+    if (!which || !name)
+    {
+        xprintf("Error: Give a track or 'all' and a pattern\r\n");
+        return 1;
+    }
+
+    for (pattern = 0; pattern <= PATTERN_MASK; pattern++)
+    {
+        if (!stricmp(name, pattern_name(pattern)))
+            break;
+    }
+
+    if (pattern > PATTERN_MASK)
+    {
+        xprintf("Error: Invalid pattern\r\n");
+        return 1;
+    }
+
+    if (stricmp(which, "all") && (uint8_t)atoi(which) > MAX_TRACK)
+    {
+        xprintf("Error: Invalid track\r\n");
+        return 1;
+    }
+
+    for (track = 0; track <= MAX_TRACK; track++)
+    {
+        if (stricmp(which, "all") && atoi(which) != track)
+            continue;
+
+        config->track_patterns &= ~((uint32_t)PATTERN_MASK << (track * PATTERN_BITS));
+        config->track_patterns |= (uint32_t)pattern << (track * PATTERN_BITS);
+    }
+
+    return 0;
+}
+#endif
+
+#if FEATURE_SWEEP
+static uint8_t do_sweep(char *arg, sys_config_t *config)
+{
+    uint8_t khz[SWEEP_MAX_STEPS];
+    uint8_t count = 0;
+    char *token;
+
+    memset(khz, 0, sizeof(khz));
+
+    if (!arg || !*arg)
+    {
+        xprintf("Error: No frequencies given\r\n");
+        return 1;
+    }
+
+    for (token = strtok(arg, ","); token; token = strtok(NULL, ","))
+    {
+        int value = atoi(token);
+
+        if (count == SWEEP_MAX_STEPS || value < TONE_MIN_KHZ || value > TONE_MAX_KHZ)
+        {
+            xprintf("Error: Give up to %u frequencies of %u-%u kHz\r\n",
+                SWEEP_MAX_STEPS, TONE_MIN_KHZ, TONE_MAX_KHZ);
+            return 1;
+        }
+
+        khz[count++] = (uint8_t)value;
+    }
+
+    memcpy(config->sweep_khz, khz, sizeof(khz));
+
+    return 0;
+}
+#endif
+
+#if FEATURE_HIGHSPEED
+static uint8_t do_highspeed(char *arg, sys_config_t *config)
+{
+    uint8_t flags = 0;
+    uint8_t i;
+    char *token;
+
+    if (!arg || !*arg)
+    {
+        xprintf("Error: Missing parameter\r\n");
+        return 1;
+    }
+
+    if (stricmp(arg, "none"))
+    {
+        for (token = strtok(arg, ","); token; token = strtok(NULL, ","))
+        {
+            for (i = 0; i < sizeof(_g_hsd_names) / sizeof(_g_hsd_names[0]); i++)
+            {
+                if (!stricmp(token, _g_hsd_names[i]))
+                    break;
+            }
+
+            if (i == sizeof(_g_hsd_names) / sizeof(_g_hsd_names[0]))
+            {
+                xprintf("Error: Invalid parameter\r\n");
+                return 1;
+            }
+
+            flags |= (1 << i);
+        }
+    }
+
+    config->hsd_flags = flags;
+
+    return 0;
+}
+#endif
+
+#if FEATURE_SCRIPT
+static int8_t do_script(char *arg, sys_config_t *config, uint8_t *ignore_lf)
+{
+    // The command has been parsed by the time lines are read over it
+    char *line = _g_arena.cli.line;
+    char *action;
+    char *slotarg;
+    uint8_t slot;
+
+    action = strtok(arg, " ");
+    slotarg = strtok(NULL, "");
+
+    if (!action || parse_param(&slot, PARAM_U8, slotarg))
+        return 1;
+
+    if (slot >= EE_SCRIPT_SLOTS)
+    {
+        xprintf("Error: Invalid parameter\r\n");
+        return 1;
+    }
+
+    if (!stricmp(action, "list"))
+    {
+        script_list(slot);
+        return 0;
+    }
+
+    if (!stricmp(action, "run"))
+    {
+        config->operation = OPERATION_SCRIPT;
+        config->script_slot = slot;
+        xprintf("\r\nStarting...\r\n");
+        return -1;
+    }
+
+    if (stricmp(action, "load"))
+    {
+        xprintf("Error: Invalid parameter\r\n");
+        return 1;
+    }
+
+    script_load_begin(slot);
+
+    for (;;)
+    {
+        int8_t ret;
+
+        xprintf("script>");
+        ret = get_string(line, CMD_MAX_LINE, ignore_lf);
+        xprintf("\r\n");
+
+        if (ret < 0)
+            return 1;
+
+        ret = script_load_line(line);
+
+        if (ret < 0)
+            break;
+    }
+
+    return script_load_end() ? 0 : 1;
+}
+#endif
+
 static uint8_t parse_param(void *param, uint8_t type, char *arg)
 {
     uint16_t u16param;
@@ -365,7 +1035,7 @@ static uint8_t parse_param(void *param, uint8_t type, char *arg)
     if (!arg || !*arg)
     {
         /* Avoid stack overflow */
-        printf("Error: Missing parameter\r\n");
+        xprintf("Error: Missing parameter\r\n");
         return 1;
     }
 
@@ -391,50 +1061,46 @@ static uint8_t parse_param(void *param, uint8_t type, char *arg)
 
 static void cmd_erase_line(uint8_t count)
 {
-    printf("%c[%dD%c[K", SEQ_ESCAPE_CHAR, count, SEQ_ESCAPE_CHAR);
+    xprintf("%c[%dD%c[K", SEQ_ESCAPE_CHAR, count, SEQ_ESCAPE_CHAR);
 }
 
-static void config_next_command(char *cmdbuf, int8_t *count)
+static void config_show_history(char *cmdbuf, int8_t *count)
 {
-    uint8_t previdx;
-
-    if (!_g_max_history)
-        return;
-
     if (*count)
         cmd_erase_line(*count);
 
-    previdx = ++_g_show_history;
+    *count = history_copy(_g_show_history, cmdbuf);
+    xputs(cmdbuf);
+}
 
-    if (_g_show_history == CMD_MAX_HISTORY)
-    {
-        _g_show_history = 0;
-        previdx = 0;
-    }
+static void config_next_command(char *cmdbuf, int8_t *count)
+{
+    uint8_t entries = history_count();
+
+    if (!entries)
+        return;
+
+    if (_g_show_history <= 1)
+        _g_show_history = entries;
+    else
+        _g_show_history--;
 
-    strcpy(cmdbuf, _g_cmd_history[previdx]);
-    *count = strlen(cmdbuf);
-    printf("%s", cmdbuf);
+    config_show_history(cmdbuf, count);
 }
 
 static void config_prev_command(char *cmdbuf, int8_t *count)
 {
-    uint8_t previdx;
+    uint8_t entries = history_count();
 
-    if (!_g_max_history)
+    if (!entries)
         return;
 
-    if (*count)
-        cmd_erase_line(*count);
-
-    if (_g_show_history == 0)
-        _g_show_history = CMD_MAX_HISTORY;
-
-    previdx = --_g_show_history;
+    if (_g_show_history >= entries)
+        _g_show_history = 1;
+    else
+        _g_show_history++;
 
-    strcpy(cmdbuf, _g_cmd_history[previdx]);
-    *count = strlen(cmdbuf);
-    printf("%s", cmdbuf);
+    config_show_history(cmdbuf, count);
 }
 
 static int get_string(char *str, int8_t max, uint8_t *ignore_lf)
@@ -566,49 +1232,19 @@ static int get_string(char *str, int8_t max, uint8_t *ignore_lf)
 
 static int8_t get_line(char *str, int8_t max, uint8_t *ignore_lf)
 {
-    uint8_t i;
     int8_t ret;
-    int8_t tostore = -1;
 
     ret = get_string(str, max, ignore_lf);
 
     if (ret <= 0) {
         return ret;
     }
-    
-    if (_g_next_history >= CMD_MAX_HISTORY)
-        _g_next_history = 0;
-    else
-        _g_max_history++;
 
-    for (i = 0; i < CMD_MAX_HISTORY; i++)
-    {
-        if (!stricmp(_g_cmd_history[i], str))
-        {
-            tostore = i;
-            break;
-        }
-    }
-
-    if (tostore < 0)
-    {
-        // Don't have this command in history. Store it
-        strcpy(_g_cmd_history[_g_next_history], str);
-        _g_next_history++;
-        _g_show_history = _g_next_history;
-    }
-    else
-    {
-        // Already have this command in history, set the 'up' arrow to retrieve it.
-        tostore++;
-
-        if (tostore == CMD_MAX_HISTORY)
-            tostore = 0;
-
-        _g_show_history = tostore;
-    }
+    // Repeats are moved to the newest slot, so 'up' always recalls this one first
+    history_add(str, ret);
+    _g_show_history = 0;
 
-    printf("\r\n");
+    xprintf("\r\n");
 
     return ret;
 }
@@ -616,17 +1252,17 @@ static int8_t get_line(char *str, int8_t max, uint8_t *ignore_lf)
 void load_configuration(sys_config_t *config)
 {
     uint16_t config_size = sizeof(sys_config_t);
-    if (config_size > 0x100)
+    if (config_size > EE_CONFIG_SIZE)
     {
-        printf("\r\nConfiguration size is too large. Currently %u bytes.", config_size);
+        xprintf("\r\nConfiguration size is too large. Currently %u bytes.", config_size);
         reset();
     }
     
-    eeprom_read_data(0, (uint8_t *)config, sizeof(sys_config_t));
+    eeprom_read_data(EE_CONFIG_ADDR, (uint8_t *)config, sizeof(sys_config_t));
 
     if (config->magic != CONFIG_MAGIC)
     {
-        printf("\r\nNo configuration found. Setting defaults\r\n");
+        xprintf("\r\nNo configuration found. Setting defaults\r\n");
         default_configuration(config);
         save_configuration(config);
     }
@@ -637,9 +1273,30 @@ static void default_configuration(sys_config_t *config)
     config->magic = CONFIG_MAGIC;
     config->operation = OPERATION_NONE;
     config->stopat_track = 1;
+    config->script_slot = 0;
+    config->track_mask = 0;
+    config->hsd_flags = HSD_REWIND | HSD_REPOSITION | HSD_SLOWDOWN;
+    config->batch = 0;
+    config->erase_verify = 1;
+    config->reset_ms = 15;
+    config->settle_10ms = 200;
+    config->ramp_max_ms = 200;
+    config->ramp_max_tach = 50;
+    config->shuttle_seed = 1;
+    memset(config->sweep_khz, 0, sizeof(config->sweep_khz));
+    config->sweep_khz[0] = 25;
+    config->sweep_khz[1] = 30;
+    config->sweep_khz[2] = 35;
+    config->sweep_khz[3] = 40;
+    config->sweep_khz[4] = 50;
+    config->sweep_khz[5] = 60;
+    config->track_patterns = 0;
+    config->pattern_khz = 50;
+    config->telemetry_ms = 0;
+    config->tach_stream = 0;
 }
 
 static void save_configuration(sys_config_t *config)
 {
-    eeprom_write_data(0, (uint8_t *)config, sizeof(sys_config_t));
+    eeprom_write_data(EE_CONFIG_ADDR, (uint8_t *)config, sizeof(sys_config_t));
 }
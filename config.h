@@ -11,21 +11,65 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define CONFIG_MAGIC        0x5243
+#define CONFIG_MAGIC        0x524F
 #define MAX_DESC            32
+#define CMD_MAX_LINE        64
 
 #define OPERATION_NONE          0
 #define OPERATION_EXERCISE      1
 #define OPERATION_WRITE_TEST    2
 #define OPERATION_REWIND        3
+#define OPERATION_SCRIPT        4
+#define OPERATION_RETENSION     5
+#define OPERATION_ERASE         6
+#define OPERATION_RAMP          7
+#define OPERATION_SHUTTLE       8
+#define OPERATION_SWEEP         9
+
+#define SWEEP_MAX_STEPS         8
+
+// High speed (HSD) switches
+#define HSD_REWIND              0x01    // Rewind operation
+#define HSD_REPOSITION          0x02    // Empty legs in exercise and writetest
+#define HSD_SLOWDOWN            0x04    // Drop to normal speed on leaving the data zone
+
+// EEPROM layout. The odometer is rewritten every few minutes while
+// running, so it gets the most slots to spread the wear.
+#define EE_CONFIG_ADDR          0x00
+#define EE_CONFIG_SIZE          0x30
+#define EE_ODOMETER_ADDR        0x30
+#define EE_ODOMETER_SLOT_SIZE   0x20
+#define EE_ODOMETER_SLOTS       4
+#define EE_SCRIPT_ADDR          0xB0
+#define EE_SCRIPT_SLOT_SIZE     0x28
+#define EE_SCRIPT_SLOTS         2
+#define EE_SIZE                 0x100
 
 typedef struct {
     uint16_t magic;
     uint8_t operation;
     uint8_t stopat_track;
+    uint8_t script_slot;
+    uint16_t track_mask;
+    uint8_t hsd_flags;
+    uint8_t batch;
+    uint8_t erase_verify;
+    uint8_t reset_ms;
+    uint8_t settle_10ms;
+    uint16_t ramp_max_ms;
+    uint8_t ramp_max_tach;
+    uint16_t shuttle_seed;
+    uint8_t sweep_khz[SWEEP_MAX_STEPS];    // Zero ends a shorter list
+    uint32_t track_patterns;                // PATTERN_BITS per track, track 0 lowest
+    uint8_t pattern_khz;
+    uint16_t telemetry_ms;                  // Zero for text progress instead
+    uint8_t tach_stream;                    // Send tach edge frames while running
 } sys_config_t;
 
 void configuration_bootprompt(sys_config_t *config);
 void load_configuration(sys_config_t *config);
+const char *operation_name(uint8_t operation);
+
+extern sys_config_t _g_cfg;
 
 #endif /* __CONFIG_H__ */
\ No newline at end of file
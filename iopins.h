@@ -8,18 +8,62 @@
 #ifndef __IOPINS_H__
 #define __IOPINS_H__
 
-#define ASSERT(pin) do {\
-    pin##lat = 0;   \
-    pin##tris = 0; \
+/*
+ * Drive outputs are open collector: LAT is held at 0 from io_init()
+ * onwards and a signal is asserted by turning its TRIS bit into an
+ * output (pulled low) and deasserted by returning it to an input. Every
+ * assert or deassert is therefore a single TRIS bit write.
+ */
+#define ASSERT(pin)             do { pin##tris = 0; } while (0)
+#define DEASSERT(pin)           do { pin##tris = 1; } while (0)
+
+#define INPUT_ASSERTED(pin)     (!(pin##bit))
+#define OUTPUT_ASSERTED(pin)    (!(pin##tris))
+
+/*
+ * Several signals on one port change with a single masked TRIS write.
+ * 'asserted' holds the bits (within 'mask') that should end up asserted.
+ * The new value is computed before the store so the drive only ever
+ * sees the old or the new state of the port.
+ */
+#define PORT_ASSERT(port, mask)     do { TRIS##port &= (uint8_t)~(mask); } while (0)
+#define PORT_DEASSERT(port, mask)   do { TRIS##port |= (mask); } while (0)
+#define PORT_TRIS_VALUE(port, mask, asserted) \
+    ((uint8_t)((TRIS##port | (mask)) & ~((asserted) & (mask))))
+
+/*
+ * The emergency stop releases outputs from interrupt context, so main
+ * line read-modify-write updates of TRISA/TRISD run with interrupts
+ * masked. Otherwise a stale value could assert GO or WEN again.
+ */
+#define PORT_UPDATE(port, mask, asserted) do { \
+    uint8_t __bits = (asserted); \
+    uint8_t __gie = INTCONbits.GIEH; \
+    INTCONbits.GIEH = 0; \
+    TRIS##port = PORT_TRIS_VALUE(port, mask, __bits); \
+    INTCONbits.GIEH = __gie; \
     } while (0)
 
-#define DEASSERT(pin) do {\
-    pin##tris = 1; \
-    pin##lat = 1;   \
+/*
+ * As PORT_UPDATE, but 'stop' is tested with interrupts masked and, when
+ * true, keeps the 'stopped' bits released. An emergency stop between a
+ * test outside and the store would otherwise be undone by the store.
+ */
+#define PORT_UPDATE_UNLESS(port, mask, asserted, stop, stopped) do { \
+    uint8_t __bits = (asserted); \
+    uint8_t __gie = INTCONbits.GIEH; \
+    INTCONbits.GIEH = 0; \
+    if (stop) \
+        __bits &= (uint8_t)~(stopped); \
+    TRIS##port = PORT_TRIS_VALUE(port, mask, __bits); \
+    INTCONbits.GIEH = __gie; \
     } while (0)
 
-#define INPUT_ASSERTED(pin) (!(pin##bit))
-#define OUTPUT_ASSERTED(pin) (!(pin##lat))
+/* Single instruction releases, safe from any context */
+#define EMERGENCY_STOP() do { \
+    TRISA |= (GATES_A_MASK | HSDmask); \
+    TRISD |= GOmask; \
+    } while (0)
 
 #define GObit       PORTDbits.RD0
 #define REVbit      PORTDbits.RD3
@@ -80,4 +124,26 @@
 #define WENtris     TRISAbits.TRISA1
 #define EENtris     TRISAbits.TRISA0
 
+// Bit masks of the open collector outputs within their port
+#define EENmask     0x01    // PORTA
+#define WENmask     0x02    // PORTA
+#define HSDmask     0x04    // PORTA
+#define TR3mask     0x20    // PORTA
+#define DS0mask     0x02    // PORTB
+#define GOmask      0x01    // PORTD
+#define REVmask     0x08    // PORTD
+#define TR2mask     0x10    // PORTD
+#define TR1mask     0x20    // PORTD
+#define TR0mask     0x40    // PORTD
+#define RSTmask     0x80    // PORTD
+
+// Signal groups that are always updated together
+#define MOTION_D_MASK   (GOmask | REVmask)
+#define TRACK_D_MASK    (TR0mask | TR1mask | TR2mask)
+#define TRACK_A_MASK    (TR3mask)
+#define GATES_A_MASK    (WENmask | EENmask)
+#define OUTPUTS_A_MASK  (EENmask | WENmask | HSDmask | TR3mask)
+#define OUTPUTS_B_MASK  (DS0mask)
+#define OUTPUTS_D_MASK  (GOmask | REVmask | TR2mask | TR1mask | TR0mask | RSTmask)
+
 #endif /* __IOPINS_H__ */
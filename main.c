@@ -6,7 +6,6 @@
  */
 
 
-#include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -15,9 +14,19 @@
 #include "project.h"
 #include "config.h"
 #include "util.h"
+#include "xprintf.h"
 #include "usart.h"
 #include "iopins.h"
 #include "timers.h"
+#include "arena.h"
+#include "script.h"
+#include "plan.h"
+#include "monitor.h"
+#include "persist.h"
+#include "odometer.h"
+#include "pattern.h"
+#include "telemetry.h"
+#include "cartridge.h"
 
 #ifdef __18F4320
 #pragma config OSC = HSPLL     // Oscillator Selection bits (HS oscillator 4x PLL)
@@ -46,7 +55,7 @@
 #pragma config CPD = OFF
 #pragma config CPB = OFF
 #pragma config WDTPS = 16384
-#pragma config CCP2MX = ON
+#pragma config CCP2MX = OFF    // CCP2 on RB3, to count RDP pulses in the erase verify
 #pragma config PBAD = DIG
 #pragma config MCLRE = ON
 #pragma config STVR = ON
@@ -54,287 +63,1551 @@
 #pragma config DEBUG = OFF
 #endif
 
-#define TAPE_ZONE_UNKNOWN  0
-#define TAPE_ZONE_BOT      1
-#define TAPE_ZONE_EOT      2
-#define TAPE_ZONE_EW       3
-#define TAPE_ZONE_DATA     4
+#define CTL_ABORT          0x04    /* Ctrl+D */
 
-typedef struct {
-    uint8_t tape_zone;
-} sys_runstate_t;
+#define ERASE_VERIFY_MAX   16      /* RDP pulses tolerated on an erased track */
+#define CCP2_CAPTURE_RISING 0x05   /* CCP2CON: capture every rising edge */
+
+#define RAMP_STEADY_COUNT  8       /* tach intervals in a row that agree once up to speed */
+#define RAMP_TOLERANCE     4       /* steady intervals agree within 1/16 (2^n) */
+#define RAMP_RUN_TACH      200     /* tach counts run at speed between start and stop */
+#define RAMP_STOPPED_MS    100     /* no tach for this long and the tape has stopped */
+#define RAMP_TIMEOUT_MS    3000
+
+#define SHUTTLE_MIN_TACH   20      /* shortest random move */
+#define SHUTTLE_MAX_TACH   1000    /* longest random move */
+#define SHUTTLE_STALL_MS   1000    /* no tach for this long while moving is a stall */
+#define SHUTTLE_EOT_SLOP   50      /* tach counts EOT may drift from where it was first seen */
+#define SHUTTLE_REPORT     16      /* moves between summary lines */
+
+#define LEG_TIMEOUT_PCT    150     /* of the expected leg time before a leg is abandoned */
+#define SPEED_REFERENCE_TACH 500   /* shortest normal speed leg used to estimate high speed savings */
+
+#define SWEEP_LEAD_TACH    50      /* tape left after entering the data zone */
+#define SWEEP_SEGMENT_TACH 100     /* length of each frequency segment */
+#define SWEEP_GUARD_TACH   10      /* skipped at each end of a segment on read-back */
+
+#define ESTOP_NONE         0
+#define ESTOP_KEY          1
+#define ESTOP_USF          2
+#define ESTOP_CIN          3
 
 sys_config_t _g_cfg;
 sys_runstate_t _g_rs;
 
+volatile uint8_t _g_estop;
+volatile uint16_t _g_estop_ticks;
+volatile uint8_t _g_estop_lag;
+static uint8_t _g_fault_lines;
+
+#if FEATURE_ERASE
+static volatile uint16_t _g_rdp_pulses;
+#endif
+
+#if FEATURE_SHUTTLE
+typedef struct {
+    uint32_t moves;
+    uint32_t reversals;
+    uint16_t anomalies;
+    uint16_t move_min, move_max;
+    uint32_t move_total;
+    uint16_t reverse_min, reverse_max;
+    uint32_t reverse_total;
+    int16_t eot_position;
+} shuttle_stats_t;
+
+static shuttle_stats_t _g_shuttle;
+#endif
+
+// Helpers shared by the optional operations
+#define NEED_CARTRIDGE_SWAP     (FEATURE_RETENSION || FEATURE_ERASE || FEATURE_SWEEP)
+#define NEED_TACH_SNAPSHOT      (FEATURE_RAMP || FEATURE_SHUTTLE || FEATURE_HIGHSPEED)
+#define NEED_MOVING_CLOCK       (FEATURE_RAMP || FEATURE_SHUTTLE)
+#define NEED_TACH               (NEED_TACH_SNAPSHOT || FEATURE_SWEEP || FEATURE_MONITOR || \
+                                 FEATURE_TELEMETRY || FEATURE_CARTRIDGE || FEATURE_PERSIST)
+
+#if NEED_MOVING_CLOCK
+static uint32_t _g_moving_ms;
+static uint32_t _g_moving_last;
+#endif
+
 static void operation_exercise(sys_runstate_t *rs, sys_config_t *config);
 static void operation_rewind(sys_runstate_t *rs, sys_config_t *config);
-static void write_test_pattern(uint8_t tape_zone, uint8_t track);
+#if FEATURE_SCRIPT
+static void operation_script(sys_runstate_t *rs, sys_config_t *config);
+#endif
+#if FEATURE_RETENSION
+static void operation_retension(sys_runstate_t *rs, sys_config_t *config);
+#endif
+#if NEED_CARTRIDGE_SWAP
+static void wait_cartridge_swap(void);
+#endif
+#if FEATURE_ERASE
+static void operation_erase(sys_runstate_t *rs, sys_config_t *config);
+static bool verify_erase(sys_runstate_t *rs);
+#endif
+#if FEATURE_RAMP
+static void operation_ramp(sys_runstate_t *rs, sys_config_t *config);
+static bool ramp_direction(sys_runstate_t *rs, sys_config_t *config, bool reverse, uint16_t run_tach, uint8_t *failures);
+#endif
+#if NEED_TACH_SNAPSHOT
+static uint32_t tach_snapshot(uint16_t *interval);
+#endif
+#if NEED_MOVING_CLOCK
+static uint32_t moving_clock(const sys_runstate_t *rs);
+#endif
+#if FEATURE_SHUTTLE
+static void operation_shuttle(sys_runstate_t *rs, sys_config_t *config);
+static bool shuttle_move(sys_runstate_t *rs, bool reverse, uint16_t length);
+static void shuttle_report(void);
+#endif
+#if FEATURE_SWEEP
+static void operation_sweep(sys_runstate_t *rs, sys_config_t *config);
+static bool sweep_write(sys_runstate_t *rs, const uint8_t *khz, uint8_t steps, bool reverse);
+static bool sweep_read(sys_runstate_t *rs, const uint8_t *khz, uint8_t steps, bool reverse);
+static void sweep_report(uint8_t track, const uint8_t *khz, uint8_t steps);
+static bool sweep_reached(int16_t mark, bool reverse);
+static int16_t position_snapshot(void);
+static void enable_testfreq(uint8_t khz);
+#endif
+static bool run_leg(sys_runstate_t *rs, sys_config_t *config, uint8_t track, bool reverse, bool high_speed);
+#if FEATURE_HIGHSPEED
+static uint32_t normal_speed_ms(const sys_runstate_t *rs, uint16_t tach);
+#endif
+static void print_seconds(uint32_t ms);
+static bool drive_prepare(sys_runstate_t *rs);
+static void write_test_pattern(uint8_t tape_zone, uint8_t track, bool erase);
+static uint8_t read_tape_zone(void);
+static void estop_record(uint8_t reason, uint16_t ticks, uint8_t lag);
+static void estop_report(void);
 static void io_init(void);
-static void check_keys(void);
-static void check_toggle(void);
 
-static void enable_testfreq(bool enable);
+void drive_reset(void);
+bool drive_select(bool selected);
+void drive_select_track(uint8_t track);
+
+void high_priority interrupt interrupt_handler_high(void) 
+{
+    // Ctrl+D stops the drive before anything else runs
+    if (PIR1bits.RCIF)
+    {
+        uint16_t entry = timer1_read();
+        char c = RCREG;
+
+        if (c == CTL_ABORT)
+        {
+            EMERGENCY_STOP();
+            estop_record(ESTOP_KEY, timer1_read() - entry, 0);
+        }
+        else
+        {
+            usart1_rx_push(c);
+        }
+    }
+
+#if NEED_TACH
+    // Tach pulse: one per fixed length of tape
+    if (INTCONbits.INT0IF)
+    {
+        uint16_t now = timer1_read();
+
+        INTCONbits.INT0IF = 0;
+        _g_rs.tach_interval = now - _g_rs.tach_last;
+        _g_rs.tach_last = now;
+        _g_rs.tach_total++;
+
+#if FEATURE_TELEMETRY
+        // The capture above and one store: telemetry_poll() frames them
+        if (_g_cfg.tach_stream)
+            _g_tach_ring[_g_tach_head++ & (TACH_RING_SIZE - 1)] = now;
+#endif
+
+        if (OUTPUT_ASSERTED(REV))
+            _g_rs.position--;
+        else
+            _g_rs.position++;
+    }
+#endif /* NEED_TACH */
+
+    if (INTCONbits.TMR0IF)
+    {
+        // Test tone generator. This interrupts the MCU so often that
+        // __delay_mx macros become 8x longer when this is running
+        INTCONbits.TMR0IF = 0;
+
+#if FEATURE_PATTERN
+        if (!_g_pattern.active)
+        {
+            LATC ^= 0x03;
+        }
+        else
+        {
+            // One bit per interrupt, NRZI: a 1 is a flux transition
+            if (_g_pattern.bits & 0x80)
+                LATC ^= 0x03;
+
+            _g_pattern.bits <<= 1;
+
+            if (!--_g_pattern.count)
+            {
+                // An empty ring repeats transitions, which any code allows
+                if (_g_pattern.tail != _g_pattern.head)
+                {
+                    _g_pattern.bits = _g_pattern.ring[_g_pattern.tail];
+                    _g_pattern.tail = (_g_pattern.tail + 1) & (PATTERN_RING_SIZE - 1);
+                }
+                else
+                {
+                    _g_pattern.bits = 0xFF;
+
+                    if (_g_pattern.underruns < 0xFF)
+                        _g_pattern.underruns++;
+                }
+
+                _g_pattern.count = 8;
+            }
+        }
+#else
+        LATC ^= 0x03;
+#endif
+
+        TMR0L += _g_tone_reload;
+    }
+}
+
+void low_priority interrupt interrupt_handler_low(void)
+{
+#if FEATURE_ERASE
+    // RDP pulse during the erase verify; the holes and leader do not count
+    if (PIR2bits.CCP2IF)
+    {
+        PIR2bits.CCP2IF = 0;
+        if (_g_rs.tape_zone == TAPE_ZONE_DATA && _g_rdp_pulses < 0xFFFF)
+            _g_rdp_pulses++;
+    }
+#endif
+
+    if (PIR1bits.TMR2IF)
+    {
+        // TMR2 restarted from 0 when the flag was raised, so its count is
+        // how long this entry was held off. It wraps after 62.5 us.
+        uint8_t lag = TMR2;
+        uint16_t entry = timer1_read();
+        uint8_t lines = (USFbit ? 0x01 : 0) | (CINbit ? 0x02 : 0);
+
+        PIR1bits.TMR2IF = 0;
+        _g_ms++;
+
+        // USF or CIN changing while the drive is moving or writing is a fault
+        if (lines != _g_fault_lines)
+        {
+            if (OUTPUT_ASSERTED(GO) || OUTPUT_ASSERTED(WEN) || OUTPUT_ASSERTED(EEN))
+            {
+                EMERGENCY_STOP();
+                estop_record((lines ^ _g_fault_lines) & 0x01 ? ESTOP_USF : ESTOP_CIN, timer1_read() - entry, lag);
+            }
+
+            _g_fault_lines = lines;
+        }
+
+#if FEATURE_ODOMETER
+        if (OUTPUT_ASSERTED(GO))
+            _g_motor_ms++;
+#endif
+    }
+
+    if (INTCONbits.RBIF)
+    {
+        INTCONbits.RBIF = 0;
+        _g_rs.tape_zone = read_tape_zone();
+#if FEATURE_SCRIPT
+        _g_zone_seen |= SCRIPT_ZONE_BIT(_g_rs.tape_zone);
+#endif
+
+#if NEED_TACH
+        // Positions are counted in tach pulses from BOT. The EW hole
+        // passes too quickly for the run loop to see it reliably
+        if (_g_rs.tape_zone == TAPE_ZONE_BOT)
+            _g_rs.position = 0;
+#if FEATURE_CARTRIDGE
+        else if (_g_rs.tape_zone == TAPE_ZONE_EW)
+            _g_rs.ew_position = _g_rs.position;
+        else if (_g_rs.tape_zone == TAPE_ZONE_EOT)
+            _g_rs.eot_position = _g_rs.position;
+#endif
+#endif /* NEED_TACH */
+    }
+}
+
+static void estop_record(uint8_t reason, uint16_t ticks, uint8_t lag)
+{
+    if (!_g_estop)
+    {
+        _g_estop = reason;
+        _g_estop_ticks = ticks;
+        _g_estop_lag = lag;
+    }
+}
+
+static uint8_t read_tape_zone(void)
+{
+    if (INPUT_ASSERTED(LTH) && INPUT_ASSERTED(UTH))
+        return TAPE_ZONE_BOT;
+    if (!INPUT_ASSERTED(UTH) && INPUT_ASSERTED(LTH))
+        return TAPE_ZONE_EOT;
+    if (INPUT_ASSERTED(UTH) && !INPUT_ASSERTED(LTH))
+        return TAPE_ZONE_EW;
+
+    return TAPE_ZONE_DATA;
+}
+
+int main(void)
+{
+    sys_runstate_t *rs = &_g_rs;
+    sys_config_t *config = &_g_cfg;
+
+    usart1_open(USART_CONT_RX, (((_XTAL_FREQ / UART_BAUD) / 64) - 1));
+    
+    io_init();
+    timer0_init();
+    timer0_stop();
+    timer1_init();
+    timer2_init();
+
+    load_configuration(config);
+    odometer_load();
+    
+    configuration_bootprompt(config);
+
+    // History is no longer needed, hand the arena to the run-time buffers
+    arena_enter(ARENA_PHASE_RUN);
+    
+    // From here on Ctrl+D is caught by the receive interrupt
+    _g_fault_lines = (USFbit ? 0x01 : 0) | (CINbit ? 0x02 : 0);
+    usart1_rx_interrupt(true);
+
+    // Enable interrupts
+    INTCONbits.GIE_GIEH = 1;
+    INTCONbits.PEIE_GIEL = 1;
+
+    rs->tape_zone = TAPE_ZONE_UNKNOWN;
+
+    if (persist_restore(rs, config->operation))
+    {
+        rs->resumed = true;
+        xprintf("Resumed state: zone %u track %u position %d pass %u\r\n",
+            rs->tape_zone, rs->track, rs->position, rs->passes);
+    }
+
+    for (;;)
+    {
+        switch (config->operation)
+        {
+            case OPERATION_EXERCISE:
+            case OPERATION_WRITE_TEST:
+            {
+                operation_exercise(rs, config);
+                break;
+            }
+            case OPERATION_REWIND:
+            {
+                operation_rewind(rs, config);
+                break;
+            }
+#if FEATURE_SCRIPT
+            case OPERATION_SCRIPT:
+            {
+                operation_script(rs, config);
+                break;
+            }
+#endif
+#if FEATURE_RETENSION
+            case OPERATION_RETENSION:
+            {
+                operation_retension(rs, config);
+                break;
+            }
+#endif
+#if FEATURE_ERASE
+            case OPERATION_ERASE:
+            {
+                operation_erase(rs, config);
+                break;
+            }
+#endif
+#if FEATURE_RAMP
+            case OPERATION_RAMP:
+            {
+                operation_ramp(rs, config);
+                break;
+            }
+#endif
+#if FEATURE_SHUTTLE
+            case OPERATION_SHUTTLE:
+            {
+                operation_shuttle(rs, config);
+                break;
+            }
+#endif
+#if FEATURE_SWEEP
+            case OPERATION_SWEEP:
+            {
+                operation_sweep(rs, config);
+                break;
+            }
+#endif
+            default:
+            {
+                xprintf("Invalid or no operation specified. Press Ctrl+D to reset.\r\n");
+                break;
+            }
+        }
+
+        check_keys();
+
+        delay_10ms(100);
+    }
+}
+
+static void operation_rewind(sys_runstate_t *rs, sys_config_t *config)
+{
+    xprintf("Rewind running...\r\n");
+
+    if (!drive_prepare(rs))
+        return;
+
+    xprintf("Rewinding tape\r\n");
+
+    if (!run_leg(rs, config, PLAN_REPOSITION, true, (config->hsd_flags & HSD_REWIND) != 0))
+        return;
+    
+    reset();
+}
+
+#if FEATURE_RETENSION
+static void operation_retension(sys_runstate_t *rs, sys_config_t *config)
+{
+    uint16_t cartridge = 0;
+
+    xprintf("Retension running...\r\n");
+
+    for (;;)
+    {
+        cartridge++;
+
+        if (config->batch)
+            xprintf("Cartridge %u\r\n", cartridge);
+
+        if (!drive_prepare(rs))
+            return;
+
+        // Always at high speed; run_leg() never opens the gates outside a write test
+        if (rs->tape_zone != TAPE_ZONE_BOT && !run_leg(rs, config, PLAN_REPOSITION, true, true))
+            return;
+
+        if (!run_leg(rs, config, PLAN_REPOSITION, false, true))
+            return;
+
+        if (!run_leg(rs, config, PLAN_REPOSITION, true, true))
+            return;
+
+        xprintf("Retension complete\r\n");
+
+        if (!config->batch)
+            reset();
+
+        wait_cartridge_swap();
+    }
+}
+#endif
+
+#if FEATURE_ERASE
+static void operation_erase(sys_runstate_t *rs, sys_config_t *config)
+{
+    xprintf("Erase running...\r\n");
+
+    if (!drive_prepare(rs))
+        return;
+
+    if (rs->write_protected)
+    {
+        xprintf("Error: Cartridge is write protected. Not erasing.\r\n");
+
+        // Nothing changes until the cartridge does, so do not retry
+        wait_cartridge_swap();
+        return;
+    }
+
+    if (rs->tape_zone != TAPE_ZONE_BOT &&
+            !run_leg(rs, config, PLAN_REPOSITION, true, (config->hsd_flags & HSD_REPOSITION) != 0))
+        return;
+
+    // The erase leg asserts EEN alone, which energises the full width erase head
+    xprintf("Erasing\r\n");
+
+    if (!run_leg(rs, config, 0, false, false))
+        return;
+
+    if (config->erase_verify)
+    {
+        // Erasing again would not help a tape that failed, so stop here
+        if (!verify_erase(rs))
+        {
+            wait_cartridge_swap();
+            return;
+        }
+    }
+    else if (!run_leg(rs, config, PLAN_REPOSITION, true, (config->hsd_flags & HSD_REWIND) != 0))
+    {
+        return;
+    }
+
+    xprintf("End of erase\r\n");
+
+    reset();
+}
+
+/*
+ * Reads back on the way to BOT and counts RDP pulses seen in the data
+ * zone: an erased tape should show (almost) none. CCP2 is moved to RB3
+ * so each rising edge of RDP raises a capture interrupt, and no pulse is
+ * missed however long the run loop takes. Returns false if it shows
+ * more, or the drive fails.
+ */
+static bool verify_erase(sys_runstate_t *rs)
+{
+    uint16_t transitions;
+
+    xprintf("Verifying erase on track 1... ");
+
+    drive_select_track(1);
+
+    if (!drive_go(true, true))
+        return false;
+
+    // The tape starts at EOT, so no data zone pulse comes before this
+    _g_rdp_pulses = 0;
+    CCP2CON = CCP2_CAPTURE_RISING;
+    PIR2bits.CCP2IF = 0;
+    IPR2bits.CCP2IP = 0;
+    PIE2bits.CCP2IE = 1;
+
+    while (rs->tape_zone != TAPE_ZONE_BOT)
+        check_keys();
+
+    PIE2bits.CCP2IE = 0;
+    CCP2CON = 0;
+    transitions = _g_rdp_pulses;
+
+    if (!drive_go(false, false))
+        return false;
+
+    if (transitions > ERASE_VERIFY_MAX)
+    {
+        xprintf("%u transitions, FAILED\r\n", transitions);
+        return false;
+    }
+
+    xprintf("%u transitions, erased\r\n", transitions);
+
+    return true;
+}
+#endif
+
+#if FEATURE_RAMP
+static void operation_ramp(sys_runstate_t *rs, sys_config_t *config)
+{
+    uint8_t failures = 0;
+
+    xprintf("Ramp test running...\r\n");
+
+    if (!drive_prepare(rs))
+        return;
+
+    if (rs->tape_zone != TAPE_ZONE_BOT &&
+            !run_leg(rs, config, PLAN_REPOSITION, true, (config->hsd_flags & HSD_REPOSITION) != 0))
+        return;
+
+    // The forward run goes twice as far so the reverse run never reaches BOT
+    if (!ramp_direction(rs, config, false, RAMP_RUN_TACH * 2, &failures))
+        return;
+
+    if (!ramp_direction(rs, config, true, RAMP_RUN_TACH, &failures))
+        return;
+
+    xprintf(failures ? "Ramp test FAILED, drive may be worn\r\n" : "Ramp test passed\r\n");
+
+    reset();
+}
+
+/*
+ * Starts the motor and waits for RAMP_STEADY_COUNT tach intervals in a
+ * row that agree with each other; the run of steady intervals marks the
+ * time and distance to speed. After run_tach counts at speed GO is
+ * released and tach pulses are counted until they stop arriving.
+ */
+static bool ramp_direction(sys_runstate_t *rs, sys_config_t *config, bool reverse, uint16_t run_tach, uint8_t *failures)
+{
+    uint8_t end = reverse ? TAPE_ZONE_BOT : TAPE_ZONE_EOT;
+    uint8_t steady = 0;
+    uint16_t interval;
+    uint16_t previous = 0;
+    uint16_t speed_ms, speed_tach, stop_ms, stop_tach;
+    uint32_t start_ms, steady_ms, last_ms, now;
+    uint32_t start_tach, steady_tach, last_tach, tach;
+    bool worn;
+
+    xprintf(reverse ? "Reverse: " : "Forward: ");
+
+    start_tach = steady_tach = last_tach = tach = tach_snapshot(&interval);
+    start_ms = steady_ms = moving_clock(rs);
+
+    if (!drive_go(true, reverse))
+        return false;
+
+    while (steady < RAMP_STEADY_COUNT || tach - steady_tach < run_tach)
+    {
+        now = moving_clock(rs);
+        tach = tach_snapshot(&interval);
+
+        if (tach != last_tach && steady < RAMP_STEADY_COUNT)
+        {
+            uint16_t diff = (interval > previous) ? interval - previous : previous - interval;
+
+            // The first interval after GO spans the time the tape stood still
+            if (tach - start_tach > 1 && diff <= (previous >> RAMP_TOLERANCE))
+            {
+                steady++;
+            }
+            else
+            {
+                steady = 0;
+                steady_ms = now;
+                steady_tach = tach;
+            }
+
+            previous = interval;
+            last_tach = tach;
+        }
+
+        // Running out of tape says nothing about the drive, so it is not a speed failure
+        if (rs->tape_zone == end)
+        {
+            drive_go(false, false);
+            xprintf("\r\nError: %s reached %s.\r\n", reverse ? "BOT" : "EOT",
+                steady < RAMP_STEADY_COUNT ? "before the speed was steady" : "during the run at speed");
+            return false;
+        }
+
+        if (steady < RAMP_STEADY_COUNT && now - start_ms > RAMP_TIMEOUT_MS)
+        {
+            drive_go(false, false);
+            xprintf("\r\nError: Drive did not reach a steady speed.\r\n");
+            return false;
+        }
+
+        check_keys();
+    }
+
+    speed_ms = (uint16_t)(steady_ms - start_ms);
+    speed_tach = (uint16_t)(steady_tach - start_tach);
+
+    // REV stays put while coasting so the position keeps counting the right way
+    start_tach = last_tach = tach;
+    start_ms = last_ms = moving_clock(rs);
+
+    if (!drive_go(false, reverse))
+        return false;
+
+    for (;;)
+    {
+        now = moving_clock(rs);
+        tach = tach_snapshot(&interval);
+
+        if (tach != last_tach)
+        {
+            last_tach = tach;
+            last_ms = now;
+        }
+
+        if (now - last_ms >= RAMP_STOPPED_MS)
+            break;
+
+        if (now - start_ms > RAMP_TIMEOUT_MS)
+        {
+            xprintf("\r\nError: Tape did not stop.\r\n");
+            return false;
+        }
+
+        check_keys();
+    }
+
+    drive_go(false, false);
+
+    stop_ms = (uint16_t)(last_ms - start_ms);
+    stop_tach = (uint16_t)(last_tach - start_tach);
+
+    worn = (speed_ms > config->ramp_max_ms || stop_tach > config->ramp_max_tach);
+    if (worn)
+        (*failures)++;
+
+    xprintf("up to speed in %u ms / %u tach, stopped in %u ms / %u tach%s\r\n",
+        speed_ms, speed_tach, stop_ms, stop_tach, worn ? " - OUT OF LIMITS" : "");
+
+    return true;
+}
+#endif
+
+#if FEATURE_SHUTTLE
+/*
+ * Short random moves in both directions from a seeded generator, so a
+ * seed always asks for the same moves from BOT. Most moves reverse the
+ * last one; reaching either end changes to a random track from the set
+ * and sends the tape back the other way.
+ */
+static void operation_shuttle(sys_runstate_t *rs, sys_config_t *config)
+{
+    uint16_t mask = config->track_mask ? config->track_mask : ALL_TRACKS;
+    bool reverse = true;
+    uint8_t track;
+
+    xprintf("Shuttle exercise running, seed %u...\r\n", config->shuttle_seed);
+
+    if (!drive_prepare(rs))
+        return;
+
+    if (rs->tape_zone != TAPE_ZONE_BOT &&
+            !run_leg(rs, config, PLAN_REPOSITION, true, (config->hsd_flags & HSD_REPOSITION) != 0))
+        return;
+
+    prng_seed(config->shuttle_seed);
+    memset(&_g_shuttle, 0, sizeof(_g_shuttle));
+    _g_shuttle.move_min = _g_shuttle.reverse_min = 0xFFFF;
+
+    for (;;)
+    {
+        uint16_t length = SHUTTLE_MIN_TACH + (prng_next() % (SHUTTLE_MAX_TACH - SHUTTLE_MIN_TACH + 1));
+
+        if (rs->tape_zone == TAPE_ZONE_BOT || rs->tape_zone == TAPE_ZONE_EOT)
+        {
+            do
+            {
+                track = prng_next() % (MAX_TRACK + 1);
+            } while (!(mask & (1 << track)));
+
+            drive_select_track(track);
+            reverse = (rs->tape_zone == TAPE_ZONE_EOT);
+        }
+        else if (prng_next() & 0x03)
+        {
+            reverse = !reverse;
+        }
+
+        if (!shuttle_move(rs, reverse, length))
+            return;
+
+        if (_g_shuttle.moves % SHUTTLE_REPORT == 0)
+            shuttle_report();
+    }
+}
+
+/*
+ * One move of up to length tach counts. The move time runs from GO to
+ * its release; after a reversal the time to the first tach pulse is the
+ * reversal latency, which includes the coast from the last move. A hole
+ * that cannot be ahead of the tape, or an EOT that has moved, is counted
+ * as a hole detection anomaly.
+ */
+static bool shuttle_move(sys_runstate_t *rs, bool reverse, uint16_t length)
+{
+    uint8_t end = reverse ? TAPE_ZONE_BOT : TAPE_ZONE_EOT;
+    uint8_t zone = rs->tape_zone;
+    bool reversal = (OUTPUT_ASSERTED(REV) != reverse);
+    bool first = false;
+    uint16_t interval;
+    uint16_t elapsed;
+    uint32_t start_ms, last_ms, now;
+    uint32_t start_tach, last_tach, tach;
+
+    start_tach = last_tach = tach = tach_snapshot(&interval);
+    start_ms = last_ms = moving_clock(rs);
+
+    if (!drive_go(true, reverse))
+        return false;
+
+    while (tach - start_tach < length && rs->tape_zone != end)
+    {
+        now = moving_clock(rs);
+        tach = tach_snapshot(&interval);
+
+        if (tach != last_tach)
+        {
+            if (!first && reversal)
+            {
+                elapsed = (uint16_t)(now - start_ms);
+                _g_shuttle.reversals++;
+                _g_shuttle.reverse_total += elapsed;
+                _g_shuttle.reverse_min = min_(_g_shuttle.reverse_min, elapsed);
+                _g_shuttle.reverse_max = max_(_g_shuttle.reverse_max, elapsed);
+            }
+
+            first = true;
+            last_tach = tach;
+            last_ms = now;
+        }
+
+        if (rs->tape_zone != zone)
+        {
+            zone = rs->tape_zone;
+
+            if ((reverse && zone == TAPE_ZONE_EOT) || (!reverse && zone == TAPE_ZONE_BOT))
+            {
+                _g_shuttle.anomalies++;
+                xprintf("\r\nAnomaly: zone %u moving %s at %d\r\n", zone, reverse ? "reverse" : "forward", rs->position);
+            }
+        }
+
+        if (now - last_ms > SHUTTLE_STALL_MS)
+        {
+            drive_go(false, false);
+            xprintf("\r\nError: Tape stalled at %d.\r\n", rs->position);
+            return false;
+        }
+
+        check_keys();
+    }
+
+    // REV is left as it is so the coast is counted the right way
+    if (!drive_go(false, reverse))
+        return false;
+
+    elapsed = (uint16_t)(moving_clock(rs) - start_ms);
+    _g_shuttle.moves++;
+    _g_shuttle.move_total += elapsed;
+    _g_shuttle.move_min = min_(_g_shuttle.move_min, elapsed);
+    _g_shuttle.move_max = max_(_g_shuttle.move_max, elapsed);
+
+    if (rs->tape_zone == TAPE_ZONE_EOT)
+    {
+        if (!_g_shuttle.eot_position)
+        {
+            _g_shuttle.eot_position = rs->position;
+        }
+        else if (abs(rs->position - _g_shuttle.eot_position) > SHUTTLE_EOT_SLOP)
+        {
+            _g_shuttle.anomalies++;
+            xprintf("\r\nAnomaly: EOT at %d, first seen at %d\r\n", rs->position, _g_shuttle.eot_position);
+        }
+    }
+
+    xprintf("Move %lu: %s %u tach in %u ms%s\r\n", _g_shuttle.moves, reverse ? "rev" : "fwd",
+        (uint16_t)(tach - start_tach), elapsed, reversal ? " (reversal)" : "");
+
+    return true;
+}
+
+static void shuttle_report(void)
+{
+    xprintf("Moves: %lu reversals: %lu anomalies: %u\r\n",
+        _g_shuttle.moves, _g_shuttle.reversals, _g_shuttle.anomalies);
+    xprintf("Move ms min/avg/max: %u/%lu/%u\r\n", _g_shuttle.move_min,
+        _g_shuttle.move_total / _g_shuttle.moves, _g_shuttle.move_max);
+
+    if (_g_shuttle.reversals)
+        xprintf("Reversal ms min/avg/max: %u/%lu/%u\r\n", _g_shuttle.reverse_min,
+            _g_shuttle.reverse_total / _g_shuttle.reversals, _g_shuttle.reverse_max);
+}
+#endif
+
+#if FEATURE_SWEEP
+/*
+ * Records a short segment at each sweep frequency along every track in
+ * the track set, using the timer0 tone on WDP/WDM, then reads the track
+ * back in the same direction. Segments are placed by tach position, so
+ * the read-back finds them again without any marks on the tape.
+ */
+static void operation_sweep(sys_runstate_t *rs, sys_config_t *config)
+{
+    uint16_t mask = config->track_mask ? config->track_mask : ALL_TRACKS;
+    uint8_t steps = 0;
+    uint8_t track;
+
+    while (steps < SWEEP_MAX_STEPS && config->sweep_khz[steps])
+        steps++;
+
+    xprintf("Sweep running, %u frequencies...\r\n", steps);
+
+    if (!steps || !drive_prepare(rs))
+        return;
+
+    if (rs->write_protected)
+    {
+        xprintf("Error: Cartridge is write protected. Not sweeping.\r\n");
+        wait_cartridge_swap();
+        return;
+    }
+
+    for (track = 0; track <= MAX_TRACK; track++)
+    {
+        bool reverse = (track & 0x01) != 0;
+
+        if (!(mask & (1 << track)))
+            continue;
+
+        // Each pass starts from the end its track is recorded from
+        if (rs->tape_zone != (reverse ? TAPE_ZONE_EOT : TAPE_ZONE_BOT) &&
+                !run_leg(rs, config, PLAN_REPOSITION, !reverse, (config->hsd_flags & HSD_REPOSITION) != 0))
+            return;
+
+        drive_select_track(track);
+        xprintf("Track %u: writing... ", track);
+
+        if (!sweep_write(rs, config->sweep_khz, steps, reverse))
+            return;
+
+        if (!run_leg(rs, config, PLAN_REPOSITION, !reverse, (config->hsd_flags & HSD_REPOSITION) != 0))
+            return;
+
+        xprintf("Track %u: reading... ", track);
+
+        if (!sweep_read(rs, config->sweep_khz, steps, reverse))
+            return;
+
+        sweep_report(track, config->sweep_khz, steps);
+    }
+
+    if (!run_leg(rs, config, PLAN_REPOSITION, true, (config->hsd_flags & HSD_REWIND) != 0))
+        return;
+
+    xprintf("End of sweep\r\n");
+
+    reset();
+}
+
+static bool sweep_write(sys_runstate_t *rs, const uint8_t *khz, uint8_t steps, bool reverse)
+{
+    sweep_segment_t *segments = _g_arena.run.op.sweep;
+    int16_t mark;
+    uint8_t i;
+    bool done = false;
+
+    memset(segments, 0, sizeof(_g_arena.run.op.sweep));
+
+    if (!drive_go(true, reverse))
+        return false;
+
+    while (rs->tape_zone != TAPE_ZONE_DATA && rs->tape_zone != (reverse ? TAPE_ZONE_BOT : TAPE_ZONE_EOT))
+        check_keys();
+
+    mark = position_snapshot() + (reverse ? -SWEEP_LEAD_TACH : SWEEP_LEAD_TACH);
+
+    // The tone changes frequency at each mark without closing the gate
+    for (i = 0; i <= steps && rs->tape_zone == TAPE_ZONE_DATA; i++)
+    {
+        while (!sweep_reached(mark, reverse) && rs->tape_zone == TAPE_ZONE_DATA)
+            check_keys();
+
+        if (i == steps)
+        {
+            done = true;
+            break;
+        }
+
+        segments[i].start = mark;
+        enable_testfreq(khz[i]);
+        drive_write_gate(true, false);
+
+        mark += reverse ? -SWEEP_SEGMENT_TACH : SWEEP_SEGMENT_TACH;
+    }
+
+    drive_write_gate(false, false);
+    enable_testfreq(0);
+
+    if (!drive_go(false, false))
+        return false;
+
+    if (!done)
+    {
+        xprintf("\r\nError: Track too short for %u segments.\r\n", steps);
+        return false;
+    }
+
+    xprintf("Done\r\n");
+
+    return true;
+}
+
+/*
+ * RB3 has no interrupt or capture, so RDP is polled in a tight loop with
+ * Timer1 timestamps. Keys are only looked at between segments; Ctrl+D
+ * still stops the drive from the receive interrupt and ends the loop.
+ */
+static bool sweep_read(sys_runstate_t *rs, const uint8_t *khz, uint8_t steps, bool reverse)
+{
+    sweep_segment_t *segments = _g_arena.run.op.sweep;
+    int8_t step = reverse ? -1 : 1;
+    uint8_t i;
+
+    if (!drive_go(true, reverse))
+        return false;
+
+    for (i = 0; i < steps; i++)
+    {
+        sweep_segment_t *segment = &segments[i];
+        uint16_t nominal = (uint16_t)((_XTAL_FREQ / 4 / 2000UL) / khz[i]);
+        int16_t from = segment->start + step * SWEEP_GUARD_TACH;
+        int16_t to = segment->start + step * (SWEEP_SEGMENT_TACH - SWEEP_GUARD_TACH);
+        uint16_t last = 0;
+        bool level = RDPbit;
+
+        while (!sweep_reached(from, reverse) && rs->tape_zone == TAPE_ZONE_DATA)
+            check_keys();
+
+        while (!sweep_reached(to, reverse) && rs->tape_zone == TAPE_ZONE_DATA && !_g_estop)
+        {
+            if (RDPbit != level)
+            {
+                uint16_t now = timer1_read();
+                uint16_t ticks = now - last;
+                uint16_t cycles = (ticks < 0x2000) ? ticks * TIMER1_PRESCALE : 0xFFFF;
+
+                level = !level;
+
+                // The first transition only starts the clock
+                if (segment->transitions)
+                {
+                    segment->ticks += ticks;
+                    segment->deviation += (cycles > nominal) ? cycles - nominal : nominal - cycles;
+                }
+
+                last = now;
+                segment->transitions++;
+            }
+        }
+
+        check_keys();
+    }
+
+    if (!drive_go(false, false))
+        return false;
+
+    xprintf("Done\r\n");
+
+    return true;
+}
+
+static void sweep_report(uint8_t track, const uint8_t *khz, uint8_t steps)
+{
+    sweep_segment_t *segments = _g_arena.run.op.sweep;
+    char rate[MAX_FDP];
+    char jitter[MAX_FDP];
+    uint8_t i;
+
+    // The tone is limited to TONE_MIN_KHZ-TONE_MAX_KHZ, well below the working band
+    xprintf("Track %u, tone %u-%u kHz, below the 150 kHz working band\r\n"
+        "\tkHz\twritten/ms\tread/ms\tjitter %%\r\n", track, TONE_MIN_KHZ, TONE_MAX_KHZ);
+
+    for (i = 0; i < steps; i++)
+    {
+        sweep_segment_t *segment = &segments[i];
+        uint16_t nominal = (uint16_t)((_XTAL_FREQ / 4 / 2000UL) / khz[i]);
+        uint32_t intervals = segment->transitions ? segment->transitions - 1 : 0;
+
+        // Transitions per ms and mean deviation as a share of the half cycle, both to 1 dp
+        format_fixedpoint(rate, intervals && segment->ticks ?
+            (int16_t)((intervals * (TIMER1_HZ / 100)) / segment->ticks) : 0, U_1DP);
+        format_fixedpoint(jitter, intervals ?
+            (int16_t)(min_((segment->deviation * 1000) / (intervals * nominal), 9999)) : 0, U_1DP);
 
-void drive_reset(void);
-bool drive_select(bool selected);
-void drive_select_track(uint8_t track);
+        xprintf("\t%u\t%u\t\t%s\t%s\r\n", khz[i], khz[i] * 2, rate, jitter);
+    }
+}
 
-void high_priority interrupt interrupt_handler_high(void) 
+static bool sweep_reached(int16_t mark, bool reverse)
 {
-    // Test tone generator. This interrupts the MCU so often that
-    // __delay_mx macros become 8x longer when this is running
-    INTCONbits.TMR0IF = 0;
-    LATC ^= 0x03;
-    TMR0L = 0xFE;
+    int16_t position = position_snapshot();
+
+    return reverse ? (position <= mark) : (position >= mark);
 }
 
-void low_priority interrupt interrupt_handler_low(void)
+static int16_t position_snapshot(void)
 {
-    if (INTCONbits.RBIF)
-    {
-        INTCONbits.RBIF = 0;
+    int16_t position;
+    uint8_t gie = INTCONbits.GIEH;
 
-        if (INPUT_ASSERTED(LTH) && INPUT_ASSERTED(UTH))
-            _g_rs.tape_zone = TAPE_ZONE_BOT;
-        if (!INPUT_ASSERTED(UTH) && INPUT_ASSERTED(LTH))
-            _g_rs.tape_zone = TAPE_ZONE_EOT;
-        if (INPUT_ASSERTED(UTH) && !INPUT_ASSERTED(LTH))
-            _g_rs.tape_zone = TAPE_ZONE_EW;
-        if (!INPUT_ASSERTED(UTH) && !INPUT_ASSERTED(LTH))
-            _g_rs.tape_zone = TAPE_ZONE_DATA;
-    }
+    INTCONbits.GIEH = 0;
+    position = _g_rs.position;
+    INTCONbits.GIEH = gie;
+
+    return position;
 }
+#endif
 
-int main(void)
+#if NEED_TACH_SNAPSHOT
+static uint32_t tach_snapshot(uint16_t *interval)
 {
-    sys_runstate_t *rs = &_g_rs;
-    sys_config_t *config = &_g_cfg;
-
-    usart1_open(USART_CONT_RX, (((_XTAL_FREQ / UART_BAUD) / 64) - 1));
-    
-    io_init();
-    timer0_init();
-    timer0_stop();
+    uint32_t total;
+    uint8_t gie = INTCONbits.GIEH;
 
-    load_configuration(config);
-    
-    configuration_bootprompt(config);
-    
-    // Enable interrupts
-    INTCONbits.GIE_GIEH = 1;
-    INTCONbits.PEIE_GIEL = 1;
+    INTCONbits.GIEH = 0;
+    total = _g_rs.tach_total;
+    *interval = _g_rs.tach_interval;
+    INTCONbits.GIEH = gie;
 
-    rs->tape_zone = TAPE_ZONE_UNKNOWN;
+    return total;
+}
+#endif
 
-    for (;;)
-    {
-        switch (config->operation)
-        {
-            case OPERATION_EXERCISE:
-            case OPERATION_WRITE_TEST:
-            {
-                operation_exercise(rs, config);
-                break;
-            }
-            case OPERATION_REWIND:
-            {
-                operation_rewind(rs, config);
-                break;
-            }
-            default:
-            {
-                printf("Invalid or no operation specified. Press Ctrl+D to reset.\r\n");
-                break;
-            }
-        }
+#if NEED_MOVING_CLOCK
+/*
+ * Milliseconds that stand still while paused, as run_leg() keeps its
+ * leg time, so a pause neither trips a timeout nor stretches a
+ * measurement. Only the calls see a pause: the time up to the first call
+ * after pausing still counts, as it does for a leg.
+ */
+static uint32_t moving_clock(const sys_runstate_t *rs)
+{
+    uint32_t now = timer_ms();
 
-        check_keys();
+    if (!rs->paused)
+        _g_moving_ms += now - _g_moving_last;
+    _g_moving_last = now;
 
-        delay_10ms(100);
-    }
+    return _g_moving_ms;
 }
+#endif
 
-static void operation_rewind(sys_runstate_t *rs, sys_config_t *config)
+#if NEED_CARTRIDGE_SWAP
+static void wait_cartridge_swap(void)
 {
-    printf("Rewind running...\r\n");
+    xprintf("Remove cartridge... ");
 
-    printf("Resetting drive\r\n");
+    while (INPUT_ASSERTED(CIN))
+        check_keys();
 
-    drive_reset();
-    delay_10ms(200);
+    xprintf("Insert next cartridge... ");
 
-    printf("Selecting drive\r\n");
-    if (!drive_select(true))
-        return;
+    while (!INPUT_ASSERTED(CIN))
+        check_keys();
 
-    printf("Rewinding tape... ");
+    xprintf("Done\r\n");
 
-    if (!drive_go(true, true))
+    cartridge_forget(&_g_rs);
+
+    // Let the cartridge seat before the drive is reset
+    delay_10ms(100);
+}
+#endif
+
+#if FEATURE_SCRIPT
+static void operation_script(sys_runstate_t *rs, sys_config_t *config)
+{
+    xprintf("Script %u running...\r\n", config->script_slot);
+
+    if (!script_start(config->script_slot))
         return;
 
-    while (rs->tape_zone != TAPE_ZONE_BOT)
+    // One step per pass, so keys are seen between and during every step
+    while (script_step(rs))
         check_keys();
 
-    printf("Done\r\n");
-    
+    script_stop();
+
+    xprintf("Script done\r\n");
+
     reset();
 }
+#endif
 
 static void operation_exercise(sys_runstate_t *rs, sys_config_t *config)
 {
+    track_plan_t plan;
+    uint16_t mask = config->track_mask;
+    uint8_t i;
+
     if (config->operation == OPERATION_WRITE_TEST)
-        printf("Writing test tape...\r\n");
+        progress("Writing test tape...\r\n");
     else
-        printf("Exercise running...\r\n");
+        progress("Exercise running...\r\n");
     
-    if (config->stopat_track > 8)
-        config->stopat_track = 8;
+    if (config->stopat_track > MAX_TRACK)
+        config->stopat_track = MAX_TRACK;
+
+    // Without a track set the write test stops at 'stopat' and the exercise uses every track
+    if (!mask)
+        mask = (config->operation == OPERATION_WRITE_TEST) ? ((2 << config->stopat_track) - 1) : ALL_TRACKS;
 
     for (;;)
     {
-        uint8_t track = 0;
-        printf("Resetting drive\r\n");
-        
-        drive_reset();
-        delay_10ms(200);
-        
-        printf("Selecting drive\r\n");
-        if (!drive_select(true))
+        if (!drive_prepare(rs))
             return;
-        
-        for (;;)
+
+        rs->traversals = 0;
+        rs->passes++;
+        progress("Pass: %u\r\n", rs->passes);
+
+        plan_tracks(&plan, mask, rs->tape_zone);
+        progress("Planned traversals: %u\r\n", plan.count);
+
+        for (i = 0; i < plan.count; i++)
         {
-            if (track == 0)
-                printf("Rewinding tape... ");
-            else
-                printf("Running tape to BOT... ");
+            bool reposition = (plan.legs[i] == PLAN_REPOSITION);
 
-            if (!drive_go(true, true))
+            if (!run_leg(rs, config, plan.legs[i], plan_leg_reverse(&plan, i),
+                    reposition && (config->hsd_flags & HSD_REPOSITION)))
                 return;
+        }
 
-            while (rs->tape_zone != TAPE_ZONE_BOT)
-            {
-                if (config->operation == OPERATION_WRITE_TEST)
-                    write_test_pattern(rs->tape_zone, track);
-                
-                check_keys();
-            }
-            
-            if (config->operation == OPERATION_WRITE_TEST)
-                write_test_pattern(rs->tape_zone, track);
+        progress("Traversals planned: %u actual: %u\r\n", plan.count, rs->traversals);
 
-            if (!drive_go(false, false))
-                return;
+        if (config->operation == OPERATION_WRITE_TEST)
+        {
+            progress("End of write\r\n");
+            reset();
+        }
 
-            printf("Done\r\n");
-            
-            if (config->operation == OPERATION_WRITE_TEST && track >= config->stopat_track)
-            {
-                printf("End of write\r\n");
-                reset();
-            }
-        
-            if (track)
-                track++;
-            
-            printf("Moving to track: %d\r\n", track);
-            
-            drive_select_track(track);
+        progress("End of exercise\r\n");
+    }
+}
 
-            printf("Running tape to EOT... ");
+#if FEATURE_HIGHSPEED
+/*
+ * What a leg covering 'tach' counts would take at normal speed, from the
+ * last normal speed leg or, before there is one, the detected cartridge.
+ * Zero when there is nothing to go on.
+ */
+static uint32_t normal_speed_ms(const sys_runstate_t *rs, uint16_t tach)
+{
+    uint32_t ms = rs->normal_leg_ms;
+    uint16_t reference = rs->normal_leg_tach;
 
-            if (!drive_go(true, false))
-                return;
+    if (!reference && rs->cartridge != CARTRIDGE_UNKNOWN && rs->tape_tach)
+    {
+        ms = cartridge_leg_ms(rs);
+        reference = rs->tape_tach;
+    }
 
-            while (rs->tape_zone != TAPE_ZONE_EOT)
-            {
-                if (config->operation == OPERATION_WRITE_TEST)
-                    write_test_pattern(rs->tape_zone, track);
-                
-                check_keys();
-            }
+    if (!reference)
+        return 0;
 
-            if (config->operation == OPERATION_WRITE_TEST)
-                write_test_pattern(rs->tape_zone, track);
+    // Through ms per 256 tach, so the product stays within 32 bits
+    return (((ms << 8) / reference) * tach) >> 8;
+}
+#endif
 
-            if (!drive_go(false, false))
-                return;
+/*
+ * Runs the tape end to end in one direction. Track legs select the
+ * track first and record it during a write test or erase; reposition legs only
+ * move the tape, optionally at high speed. The first full forward leg at
+ * normal speed measures the cartridge, and its expected leg time bounds
+ * every leg after that.
+ */
+static bool run_leg(sys_runstate_t *rs, sys_config_t *config, uint8_t track, bool reverse, bool high_speed)
+{
+    uint8_t target = reverse ? TAPE_ZONE_BOT : TAPE_ZONE_EOT;
+    bool erase = (config->operation == OPERATION_ERASE && track != PLAN_REPOSITION);
+    bool write = ((config->operation == OPERATION_WRITE_TEST || erase) && track != PLAN_REPOSITION);
+    bool full = (rs->tape_zone == (reverse ? TAPE_ZONE_EOT : TAPE_ZONE_BOT));
+    uint32_t limit = (cartridge_leg_ms(rs) * LEG_TIMEOUT_PCT) / 100;
+    uint32_t moving_ms = 0;
+    uint32_t start;
+    uint32_t last;
+    uint32_t now;
+#if FEATURE_HIGHSPEED
+    bool seen_data = false;
+    uint32_t start_tach;
+    uint32_t normal_ms;
+    uint16_t interval;
+    uint16_t tach;
+#else
+    // Every leg runs at normal speed, whatever the HSD flags say
+    high_speed = false;
+#endif
+#if FEATURE_CARTRIDGE
+    bool measure = (full && !reverse && !high_speed && !rs->cartridge_measured);
+#endif
 
-            printf("Done\r\n");
-            
-            if (config->operation == OPERATION_WRITE_TEST && track >= config->stopat_track)
-            {
-                printf("End of write\r\n");
-                reset();
-            }
+    if (track != PLAN_REPOSITION)
+    {
+        progress("Moving to track: %d\r\n", track);
+        drive_select_track(track);
+    }
 
-            if (track == 8)
-            {
-                printf("End of exercise\r\n");
-                track = 0;
-            }
-            else
-            {
-                track++;
-                printf("Moving to track: %d\r\n", track);
-                drive_select_track(track);
-            }
+    progress(reverse ? "Running tape to BOT" : "Running tape to EOT");
+
+#if FEATURE_CARTRIDGE
+    if (full && !high_speed && rs->cartridge != CARTRIDGE_UNKNOWN)
+        progress(" (%s, about %lu s)", cartridge_name(rs), cartridge_leg_ms(rs) / 1000);
+#endif
+
+    progress(high_speed ? " at high speed... " : "... ");
+
+    // A leg that starts at its target end moves no tape
+    if (rs->tape_zone != target)
+        rs->traversals++;
+
+#if FEATURE_HIGHSPEED
+    // High speed is never combined with writing
+    if (high_speed && !write)
+        drive_high_speed(true);
+#endif
+
+    // Patterns are generated on chip; 'external' leaves the gate to the generator
+    if (write && config->operation == OPERATION_WRITE_TEST)
+        pattern_start(PATTERN_FOR_TRACK(config->track_patterns, track), config->pattern_khz);
+
+#if FEATURE_CARTRIDGE
+    // The tape is still, so the interrupt cannot be midway through these
+    if (measure)
+    {
+        rs->ew_position = 0;
+        rs->eot_position = 0;
+    }
+#endif
+
+    start = timer_ms();
+    last = start;
+#if FEATURE_HIGHSPEED
+    start_tach = tach_snapshot(&interval);
+#endif
+
+    if (!drive_go(true, reverse))
+    {
+        pattern_stop();
+        return false;
+    }
+
+    while (rs->tape_zone != target)
+    {
+        // Time spent paused does not count against the leg
+        now = timer_ms();
+        if (!rs->paused)
+            moving_ms += now - last;
+        last = now;
+
+        if (moving_ms > limit)
+        {
+            drive_go(false, false);
+            drive_write_gate(false, false);
+            drive_high_speed(false);
+            pattern_stop();
+
+            xprintf("\r\nError: %s not reached after %lu s. Stopped.\r\n",
+                reverse ? "BOT" : "EOT", moving_ms / 1000);
+            return false;
+        }
+
+#if FEATURE_HIGHSPEED
+        if (rs->tape_zone == TAPE_ZONE_DATA)
+            seen_data = true;
+
+        // Back to normal speed as soon as the tape reaches the end it is heading for
+        if (seen_data && (config->hsd_flags & HSD_SLOWDOWN) && OUTPUT_ASSERTED(HSD) &&
+                (reverse ? rs->tape_zone == TAPE_ZONE_BOT :
+                    (rs->tape_zone == TAPE_ZONE_EW || rs->tape_zone == TAPE_ZONE_EOT)))
+            drive_high_speed(false);
+#endif
+
+        if (write)
+            write_test_pattern(rs->tape_zone, track, erase);
+
+        check_keys();
+    }
+
+    if (write)
+        write_test_pattern(rs->tape_zone, track, erase);
+
+    if (!drive_go(false, false))
+        return false;
+
+#if FEATURE_PATTERN
+    if (_g_pattern.active)
+    {
+        pattern_stop();
+
+        if (_g_pattern.underruns)
+            progress("%u pattern underruns, ", _g_pattern.underruns);
+    }
+#endif
+
+    drive_high_speed(false);
+
+    if (full)
+        odometer_count_pass(rs->track);
+
+    rs->leg_ms = timer_ms() - start;
+
+    progress("Done in ");
+    print_seconds(rs->leg_ms);
+
+#if FEATURE_HIGHSPEED
+    tach = (uint16_t)(tach_snapshot(&interval) - start_tach);
+
+    // Any normal speed leg long enough gives the speed reference
+    if (!high_speed && tach >= SPEED_REFERENCE_TACH)
+    {
+        rs->normal_leg_ms = rs->leg_ms;
+        rs->normal_leg_tach = tach;
+    }
+
+    if (high_speed)
+    {
+        normal_ms = normal_speed_ms(rs, tach);
+
+        if (normal_ms > rs->leg_ms)
+        {
+            progress("s, saved ");
+            print_seconds(normal_ms - rs->leg_ms);
         }
     }
+#endif
+
+    progress("s\r\n");
+
+#if FEATURE_CARTRIDGE
+    if (measure)
+        cartridge_detect(rs);
+#endif
+
+    return true;
 }
 
-static void write_test_pattern(uint8_t tape_zone, uint8_t track)
+/*
+ * Resets and selects the drive, then works out where the tape is. After
+ * a software reset with a valid saved state the drive is still powered
+ * and the tape has not moved, so the reset and settle are skipped and the
+ * saved zone stands in when the sensors show no hole.
+ */
+static bool drive_prepare(sys_runstate_t *rs)
 {
-    if (tape_zone == TAPE_ZONE_DATA)
+#if FEATURE_PERSIST
+    uint8_t saved_zone = rs->tape_zone;
+
+    if (rs->resumed)
+    {
+        progress("Resuming, drive reset skipped\r\n");
+    }
+    else
+#endif
     {
-        ASSERT(WEN); // This will also gate in the signal from the external function generator
+        progress("Resetting drive\r\n");
 
-        if (track == 0)
-            ASSERT(EEN);
-        else
-            DEASSERT(EEN);
+        drive_reset();
+        delay_10ms(_g_cfg.settle_10ms);
+    }
+
+    progress("Selecting drive\r\n");
+    if (!drive_select(true))
+    {
+        rs->resumed = false;
+        return false;
+    }
+
+    rs->tape_zone = read_tape_zone();
+
+    // Only now, selected with the tape still and the gates closed, does
+    // USF mean write protect. Once anything moves, a change on it is a
+    // fault for the tick to stop on.
+    rs->write_protected = INPUT_ASSERTED(USF);
+
+#if FEATURE_PERSIST
+    if (rs->resumed && rs->tape_zone == TAPE_ZONE_DATA &&
+            (saved_zone == TAPE_ZONE_BOT || saved_zone == TAPE_ZONE_EOT))
+        rs->tape_zone = saved_zone;
+
+    rs->resumed = false;
+#endif
+
+    return true;
+}
+
+static void print_seconds(uint32_t ms)
+{
+    char buf[MAX_FDP];
+
+    format_fixedpoint(buf, (int16_t)(ms / 100), U_1DP);
+    progress("%s", buf);
+}
+
+static void write_test_pattern(uint8_t tape_zone, uint8_t track, bool erase)
+{
+    pattern_poll();
+
+    if (tape_zone == TAPE_ZONE_DATA)
+    {
+        // This will also gate in the signal from the external function
+        // generator. The bulk erase uses the erase head alone.
+        drive_write_gate(!erase, erase || track == 0);
     }
     else
     {
-        DEASSERT(EEN);
-        DEASSERT(WEN);
+        drive_write_gate(false, false);
     }
 }
 
-static void check_keys(void)
+void check_keys(void)
+{
+    if (_g_estop)
+        estop_report();
+
+    monitor_poll(&_g_rs);
+    odometer_poll();
+    telemetry_poll();
+}
+
+/*
+ * The outputs were already released by the interrupt; this only reports
+ * and resets. Key stops run from the high priority receive interrupt,
+ * which only the short masked port updates can hold off, so the measured
+ * handler time is the latency. Fault lines are sampled by the low
+ * priority 1 ms tick: a change can wait a whole tick for the sample,
+ * then however long the entry was held off, then the handler time. The
+ * worst case reported is the sum of the three.
+ */
+static void estop_report(void)
 {
-    if (usart1_data_ready())
+    char buf[MAX_FDP];
+    uint32_t cycles;
+
+    if (_g_estop == ESTOP_KEY)
+        xprintf("\r\nCtrl+D received.");
+    else
+        xprintf("\r\nDrive fault: %s changed.", _g_estop == ESTOP_USF ? "USF" : "CIN");
+
+    // Shown in tenths of a microsecond
+    cycles = (uint32_t)_g_estop_ticks * TIMER1_PRESCALE;
+    format_fixedpoint(buf, (int16_t)((cycles * 10000) / TICK_CYCLES), U_1DP);
+    xprintf(" Stopped %u cycles (%s us) after interrupt entry", (uint16_t)cycles, buf);
+
+    if (_g_estop != ESTOP_KEY)
     {
-        char c = usart1_get();
-        if (c == 4)
-        {
-            printf("\r\nCtrl+D received. Resetting...\r\n");
-            reset();
-        }
-        if (c == 't')
-        {
-            if (OUTPUT_ASSERTED(TR0))
-            {
-                DEASSERT(TR0);
-                putch('1');
-                putch(' ');
-            }
-            else
-            {
-                ASSERT(TR0);
-                putch('0');
-                putch(' ');
-            }
-        }
+        cycles += TICK_CYCLES + (uint16_t)_g_estop_lag * TIMER2_PRESCALE;
+        format_fixedpoint(buf, (int16_t)((cycles * 10000) / TICK_CYCLES), U_1DP);
+        xprintf(", entered %u cycles after the tick; at most %s us after the change",
+            (uint16_t)_g_estop_lag * TIMER2_PRESCALE, buf);
     }
+
+    xprintf(". Resetting...\r\n");
+
+    // The cartridge or drive may have changed, so a fault never resumes
+    if (_g_estop == ESTOP_KEY)
+        reset();
+
+    reset_cold();
 }
 
 void drive_reset(void)
 {
+    uint8_t i;
+
     ASSERT(RST);
-    __delay_ms(15);
+
+    for (i = 0; i < _g_cfg.reset_ms || !i; i++)
+        __delay_ms(1);
+
     DEASSERT(RST);
+
+    odometer_count_reset();
 }
 
 bool drive_select(bool selected)
@@ -363,15 +1636,19 @@ bool drive_select(bool selected)
     if (!INPUT_ASSERTED(CIN))
     {
         DEASSERT(DS0);
-        printf("Error: No cartridge in drive.\r\n");
+        telemetry_count_select_error();
+        xprintf("Error: No cartridge in drive.\r\n");
         return false;
     }
     
     if (!INPUT_ASSERTED(SLD))
     {
-        printf("Error: Drive did not respond to select request.\r\n");
+        telemetry_count_select_error();
+        xprintf("Error: Drive did not respond to select request.\r\n");
         return false;
     }
+
+    odometer_count_select();
     
     return true;
 }
@@ -380,51 +1657,75 @@ bool drive_go(bool go, bool reverse)
 {
     if (SLDbit)
     {
-        printf("Error: failed to start drive motor. Drive not selected.\r\n");
+        xprintf("Error: failed to start drive motor. Drive not selected.\r\n");
         return false;
     }
 
-    if (go)
-        ASSERT(GO);
-    else
-        DEASSERT(GO);
-    
-    if (reverse)
-        ASSERT(REV);
-    else
-        DEASSERT(REV);
+    // GO and REV share PORTD so direction and motion change together.
+    // Nothing moves again after an emergency stop or while paused.
+    PORT_UPDATE_UNLESS(D, MOTION_D_MASK, (go ? GOmask : 0) | (reverse ? REVmask : 0),
+        _g_estop || _g_rs.paused, GOmask);
     
     return true;
 }
 
 void drive_select_track(uint8_t track)
 {
-    if (track & 0x01)
-        ASSERT(TR0);
-    else
-        DEASSERT(TR0);
+    uint8_t trisd;
+    uint8_t trisa;
+    uint8_t asserted = 0;
+    uint8_t gie;
 
+    if (track & 0x01)
+        asserted |= TR0mask;
     if (track & 0x02)
-        ASSERT(TR1);
-    else
-        DEASSERT(TR1);
-
+        asserted |= TR1mask;
     if (track & 0x04)
-        ASSERT(TR2);
-    else
-        DEASSERT(TR2);
+        asserted |= TR2mask;
+
+    // Both port values are worked out first so the code reaches the bus
+    // in two consecutive stores. TR3 goes last: it only changes between
+    // tracks 7 and 8, where the one cycle intermediate code is 0 or 15.
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    trisd = PORT_TRIS_VALUE(D, TRACK_D_MASK, asserted);
+    trisa = PORT_TRIS_VALUE(A, TRACK_A_MASK, (track & 0x08) ? TR3mask : 0);
+
+    TRISD = trisd;
+    TRISA = trisa;
+
+    INTCONbits.GIEH = gie;
+
+    _g_rs.track = track;
+}
+
+void drive_write_gate(bool write, bool erase)
+{
+    // Writing at high speed, after an emergency stop or while paused is never allowed
+    PORT_UPDATE_UNLESS(A, GATES_A_MASK, (write ? WENmask : 0) | (erase ? EENmask : 0),
+        OUTPUT_ASSERTED(HSD) || _g_estop || _g_rs.paused, GATES_A_MASK);
+}
 
-    if (track & 0x08)
-        ASSERT(TR3);
+void drive_high_speed(bool high)
+{
+    // HSD and the write gates share PORTA, so one write closes the gates
+    // and raises the speed together
+    if (high)
+        PORT_UPDATE_UNLESS(A, HSDmask | GATES_A_MASK, HSDmask, _g_estop, HSDmask);
     else
-        DEASSERT(TR3);
+        DEASSERT(HSD);
 }
 
-#if 0
-static void enable_testfreq(bool enable)
+#if FEATURE_SWEEP
+static void enable_testfreq(uint8_t khz)
 {
-    if (enable)
+    if (khz && timer0_frequency(khz))
     {
+        // Already running: only the period changes, from the next half cycle
+        if (T0CONbits.TMR0ON)
+            return;
+
         LATC = 0x01;
         WDMtris = 0;
         WDPtris = 0;
@@ -472,26 +1773,31 @@ static void io_init(void)
     WENtris = 1;
     EENtris = 1;
 
-    GOlat  = 1;
-    REVlat = 1;
-    TR3lat = 1;
-    TR2lat = 1;
-    TR1lat = 1;
-    TR0lat = 1;
-    RSTlat = 1;
-    DS0lat = 1;
+    // Open collector outputs keep LAT low; ASSERT/DEASSERT only touch TRIS
+    GOlat  = 0;
+    REVlat = 0;
+    TR3lat = 0;
+    TR2lat = 0;
+    TR1lat = 0;
+    TR0lat = 0;
+    RSTlat = 0;
+    DS0lat = 0;
     RDLlat = 1;
     WDMlat = 1;
     WDPlat = 1;
-    HSDlat = 1;
-    WENlat = 1;
-    EENlat = 1;
+    HSDlat = 0;
+    WENlat = 0;
+    EENlat = 0;
 
     INTCONbits.GIE_GIEH = 0;
     INTCONbits.PEIE_GIEL = 0;
 
     INTCONbits.RBIE = 1;
     INTCON2bits.RBIP = 0;
+#if NEED_TACH
+    INTCON2bits.INTEDG0 = 1;
+    INTCONbits.INT0IE = 1;
+#endif
     INTCON2bits.TMR0IP = 1;
     RCONbits.IPEN = 1;
 }
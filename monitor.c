@@ -0,0 +1,352 @@
+/*
+ * File:   monitor.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:38
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "project.h"
+#include "config.h"
+#include "util.h"
+#include "xprintf.h"
+#include "usart.h"
+#include "iopins.h"
+#include "timers.h"
+#include "arena.h"
+#include "monitor.h"
+#include "odometer.h"
+#include "cartridge.h"
+#include "pattern.h"
+#include "telemetry.h"
+
+#if FEATURE_MONITOR
+
+#define REPLY_NONE          0
+#define REPLY_STATUS        1
+#define REPLY_WHERE         2
+#define REPLY_SPEED         3
+#define REPLY_STATS         4
+#define REPLY_ODOMETER      5
+#define REPLY_CARTRIDGE     6
+#define REPLY_PAUSE         7
+#define REPLY_RESUME        8
+#define REPLY_ABORT         9
+#define REPLY_HELP          10
+
+static const char * const _g_zone_names[] = { "unknown", "BOT", "EOT", "EW", "data" };
+
+// Indexed by REPLY_xxx - 1
+static const char * const _g_commands[] = {
+    "status", "where", "speed", "stats", "odometer", "cartridge", "pause", "resume", "abort"
+};
+
+static uint8_t _g_line_len;
+static bool _g_resume_reverse;
+
+// The reply being sent and the part of it that comes next
+static uint8_t _g_reply;
+static uint8_t _g_reply_part;
+static uint8_t _g_reply_len;
+static uint8_t _g_reply_index;
+
+static bool monitor_status(sys_runstate_t *rs, uint8_t part)
+{
+    if (part == 0)
+        xprintf("Operation: %s%s\r\n", operation_name(_g_cfg.operation), rs->paused ? " (paused)" : "");
+    else if (part == 1)
+        xprintf("Lines: GO %u REV %u HSD %u WEN %u EEN %u SLD %u CIN %u USF %u\r\n",
+            OUTPUT_ASSERTED(GO), OUTPUT_ASSERTED(REV), OUTPUT_ASSERTED(HSD),
+            OUTPUT_ASSERTED(WEN), OUTPUT_ASSERTED(EEN),
+            INPUT_ASSERTED(SLD), INPUT_ASSERTED(CIN), INPUT_ASSERTED(USF));
+    else
+        return false;
+
+    return true;
+}
+
+static void monitor_where(sys_runstate_t *rs)
+{
+    int16_t position;
+    uint8_t gie;
+
+    // Multi-byte values the tach interrupt updates are read with it masked
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    position = rs->position;
+    INTCONbits.GIEH = gie;
+
+    xprintf("Zone: %s track: %u position: %d tach",
+        _g_zone_names[rs->tape_zone], rs->track, position);
+#if FEATURE_CARTRIDGE
+    cartridge_where(rs, position);
+#endif
+    xprintf("\r\n");
+}
+
+static void monitor_speed(sys_runstate_t *rs)
+{
+    uint16_t interval;
+    uint8_t gie;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    interval = rs->tach_interval;
+    INTCONbits.GIEH = gie;
+
+    if (!OUTPUT_ASSERTED(GO) || !interval)
+    {
+        xprintf("Speed: stopped\r\n");
+        return;
+    }
+
+    xprintf("Speed: %lu tach/s (%u cycles/tach)%s\r\n",
+        TIMER1_HZ / interval, interval, OUTPUT_ASSERTED(HSD) ? " high speed" : "");
+}
+
+static bool monitor_stats(sys_runstate_t *rs, uint8_t part)
+{
+    char buf[MAX_FDP];
+    uint32_t tach;
+    uint8_t gie;
+
+    if (part == 0)
+    {
+        gie = INTCONbits.GIEH;
+        INTCONbits.GIEH = 0;
+        tach = rs->tach_total;
+        INTCONbits.GIEH = gie;
+
+        xprintf("Uptime: %lu s traversals: %u tach: %lu\r\n",
+            timer_ms() / 1000, rs->traversals, tach);
+    }
+    else if (part == 1)
+    {
+        format_fixedpoint(buf, (int16_t)(rs->leg_ms / 100), U_1DP);
+        xprintf("Last leg: %s s", buf);
+#if FEATURE_HIGHSPEED
+        format_fixedpoint(buf, (int16_t)(rs->normal_leg_ms / 100), U_1DP);
+        xprintf(" normal speed leg: %s s", buf);
+#endif
+        xprintf("\r\n");
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static void monitor_pause(sys_runstate_t *rs)
+{
+    if (rs->paused)
+        return;
+
+    // The motion loops keep spinning on an unchanging zone while paused.
+    // drive_write_gate() and drive_go() refuse to open anything meanwhile.
+    _g_resume_reverse = OUTPUT_ASSERTED(REV);
+    rs->paused = OUTPUT_ASSERTED(GO) ? PAUSED_MOVING : PAUSED_IDLE;
+
+    drive_write_gate(false, false);
+    PORT_DEASSERT(D, GOmask);
+}
+
+static void monitor_resume(sys_runstate_t *rs)
+{
+    uint8_t paused = rs->paused;
+
+    if (!paused)
+        return;
+
+    rs->paused = 0;
+
+    if (paused == PAUSED_MOVING)
+        drive_go(true, _g_resume_reverse);
+}
+
+/*
+ * Acts on a command straight away; its reply is sent afterwards by
+ * monitor_poll(). A new command cuts short the reply to the last one.
+ */
+static void monitor_command(sys_runstate_t *rs, const char *line)
+{
+    uint8_t reply = REPLY_STATUS;
+
+    while (reply < REPLY_HELP && stricmp(line, _g_commands[reply - 1]))
+        reply++;
+
+#if !FEATURE_ODOMETER
+    if (reply == REPLY_ODOMETER)
+        reply = REPLY_HELP;
+#endif
+#if !FEATURE_CARTRIDGE
+    if (reply == REPLY_CARTRIDGE)
+        reply = REPLY_HELP;
+#endif
+
+    if (reply == REPLY_PAUSE)
+        monitor_pause(rs);
+    else if (reply == REPLY_RESUME)
+        monitor_resume(rs);
+    else if (reply == REPLY_ABORT)
+    {
+        // Resetting anyway, so the reply may block
+        EMERGENCY_STOP();
+        xprintf("\r\nAborted. Resetting...\r\n");
+        reset();
+    }
+
+    _g_reply = reply;
+    _g_reply_part = 0;
+}
+
+/*
+ * Renders one part of the reply, at most MONITOR_REPLY_MAX characters.
+ * Returns false when there is nothing left to send.
+ */
+static bool monitor_reply(sys_runstate_t *rs, uint8_t part)
+{
+    // Start on a fresh line, progress messages may be half way through one
+    if (part == 0)
+    {
+        xprintf("\r\n> %s\r\n", _g_reply < REPLY_HELP ? _g_commands[_g_reply - 1] : "?");
+        return true;
+    }
+
+    part--;
+
+    switch (_g_reply)
+    {
+        case REPLY_STATUS:
+            return monitor_status(rs, part);
+        case REPLY_STATS:
+            return monitor_stats(rs, part);
+#if FEATURE_ODOMETER
+        case REPLY_ODOMETER:
+            return odometer_report(part);
+#endif
+#if FEATURE_CARTRIDGE
+        case REPLY_CARTRIDGE:
+            return cartridge_report(rs, part);
+#endif
+        case REPLY_HELP:
+        {
+            if (part > 1)
+                return false;
+
+            xprintf(part ? "  pause resume abort\r\n" : "Commands: status where speed stats"
+#if FEATURE_ODOMETER
+                " odometer"
+#endif
+#if FEATURE_CARTRIDGE
+                " cartridge"
+#endif
+                "\r\n");
+            return true;
+        }
+        default:
+            break;
+    }
+
+    // The rest are a single line
+    if (part)
+        return false;
+
+    if (_g_reply == REPLY_WHERE)
+        monitor_where(rs);
+    else if (_g_reply == REPLY_SPEED)
+        monitor_speed(rs);
+    else if (_g_reply == REPLY_PAUSE)
+        xprintf("Paused\r\n");
+    else if (_g_reply == REPLY_RESUME)
+        xprintf("Resumed\r\n");
+
+    return true;
+}
+
+/*
+ * Sends the reply without ever waiting on the UART, as telemetry_poll()
+ * does: only bytes the UART can take now go out, and the next part is
+ * rendered once the last one has gone. At 9600 baud a part takes up to
+ * 70 ms to send, which the motion and write loops must not be held for.
+ *
+ * While the on chip pattern is being written no new part is rendered:
+ * its ring holds about 2 ms of cells at 60 kHz, less than formatting a
+ * part can take. Commands still act at once and the reply follows when
+ * the write leg ends.
+ */
+/* True while a reply is partly sent; telemetry frames wait for it */
+bool monitor_sending(void)
+{
+    return _g_reply_index < _g_reply_len;
+}
+
+static void monitor_send(sys_runstate_t *rs)
+{
+    char *reply = _g_arena.run.monitor_reply;
+
+    // A frame that has started keeps the UART until its last byte
+    if (telemetry_sending())
+        return;
+
+    while (_g_reply_index < _g_reply_len && !usart1_busy())
+        usart1_put(reply[_g_reply_index++]);
+
+    if (_g_reply_index < _g_reply_len || _g_reply == REPLY_NONE)
+        return;
+
+#if FEATURE_PATTERN
+    if (_g_pattern.active)
+        return;
+#endif
+
+    capture_start(reply, MONITOR_REPLY_MAX);
+    if (!monitor_reply(rs, _g_reply_part++))
+        _g_reply = REPLY_NONE;
+    _g_reply_len = capture_end();
+    _g_reply_index = 0;
+}
+
+/*
+ * Non-blocking line reader used while an operation runs. Only the
+ * characters already received are consumed, so motion and write gating
+ * are never held up waiting for input.
+ */
+void monitor_poll(sys_runstate_t *rs)
+{
+    char *line = _g_arena.run.monitor_line;
+
+    while (usart1_data_ready())
+    {
+        char c = usart1_get();
+
+        if (c == '\r' || c == '\n')
+        {
+            if (_g_line_len)
+            {
+                line[_g_line_len] = 0;
+                _g_line_len = 0;
+                monitor_command(rs, line);
+            }
+            continue;
+        }
+
+        if (c == '\b' || c == 0x7F)
+        {
+            if (_g_line_len)
+                _g_line_len--;
+            continue;
+        }
+
+        if (_g_line_len < MONITOR_LINE_MAX - 1)
+            line[_g_line_len++] = c;
+    }
+
+    monitor_send(rs);
+}
+
+#endif /* FEATURE_MONITOR */
@@ -0,0 +1,24 @@
+/*
+ * File:   monitor.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:38
+ */
+
+#ifndef __MONITOR_H__
+#define __MONITOR_H__
+
+#include "project.h"
+
+#define MONITOR_LINE_MAX    12
+#define MONITOR_REPLY_MAX   64
+
+#if FEATURE_MONITOR
+void monitor_poll(sys_runstate_t *rs);
+bool monitor_sending(void);
+#else
+#define monitor_poll(rs)                ((void)0)
+#define monitor_sending()               false
+#endif
+
+#endif /* __MONITOR_H__ */
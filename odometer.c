@@ -0,0 +1,193 @@
+/*
+ * File:   odometer.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:44
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "project.h"
+#include "config.h"
+#include "util.h"
+#include "xprintf.h"
+#include "iopins.h"
+#include "timers.h"
+#include "odometer.h"
+
+#if FEATURE_ODOMETER
+
+#define ODOMETER_IDLE       0xFF
+
+typedef char odometer_fits[(sizeof(odometer_t) <= EE_ODOMETER_SLOT_SIZE) ? 1 : -1];
+typedef char eeprom_layout_fits[(EE_SCRIPT_ADDR + EE_SCRIPT_SLOTS * EE_SCRIPT_SLOT_SIZE <= EE_SIZE &&
+    EE_ODOMETER_ADDR + EE_ODOMETER_SLOTS * EE_ODOMETER_SLOT_SIZE <= EE_SCRIPT_ADDR &&
+    EE_CONFIG_ADDR + EE_CONFIG_SIZE <= EE_ODOMETER_ADDR) ? 1 : -1];
+
+volatile uint32_t _g_motor_ms;
+
+static odometer_t _g_odo;           // Live counts
+static odometer_t _g_odo_image;     // Copy being written out
+static uint8_t _g_odo_slot;         // Slot the next record goes to
+static uint8_t _g_odo_index = ODOMETER_IDLE;
+static bool _g_odo_dirty;
+static uint32_t _g_odo_motor_ms;   // Motor time already in motor_s
+static uint32_t _g_odo_flush_ms;
+
+static uint8_t slot_addr(uint8_t slot)
+{
+    return EE_ODOMETER_ADDR + (slot * EE_ODOMETER_SLOT_SIZE);
+}
+
+void odometer_load(void)
+{
+    odometer_t record;
+    bool found = false;
+    uint8_t i;
+
+    memset(&_g_odo, 0, sizeof(_g_odo));
+    _g_odo_slot = 0;
+
+    for (i = 0; i < EE_ODOMETER_SLOTS; i++)
+    {
+        eeprom_read_data(slot_addr(i), (uint8_t *)&record, sizeof(record));
+
+        if (record.crc != crc16((const uint8_t *)&record, offsetof(odometer_t, crc)))
+            continue;
+
+        // Sequence numbers wrap, so the newer one is a positive difference
+        if (!found || (int16_t)(record.sequence - _g_odo.sequence) > 0)
+        {
+            memcpy(&_g_odo, &record, sizeof(record));
+            _g_odo_slot = (i + 1) % EE_ODOMETER_SLOTS;
+            found = true;
+        }
+    }
+}
+
+static void odometer_begin_write(void)
+{
+    // A record cut short is rewritten in the same slot with the same sequence
+    if (_g_odo_index == ODOMETER_IDLE)
+        _g_odo.sequence++;
+
+    memcpy(&_g_odo_image, &_g_odo, sizeof(_g_odo));
+    _g_odo_image.crc = crc16((const uint8_t *)&_g_odo_image, offsetof(odometer_t, crc));
+
+    _g_odo_index = 0;
+    _g_odo_dirty = false;
+    _g_odo_flush_ms = timer_ms();
+}
+
+static void odometer_end_write(void)
+{
+    _g_odo_index = ODOMETER_IDLE;
+    _g_odo_slot = (_g_odo_slot + 1) % EE_ODOMETER_SLOTS;
+}
+
+/*
+ * Called from check_keys(). Motor time comes from the tick's count, so
+ * it does not depend on how often this runs. A record is written one
+ * byte per call, and only when the previous byte has finished, so
+ * nothing waits on the EEPROM and interrupts are only masked for each
+ * unlock sequence. Bytes the slot already holds are not rewritten.
+ */
+void odometer_poll(void)
+{
+    uint32_t now = timer_ms();
+    uint32_t motor_ms;
+    bool giel = INTCONbits.GIEL;
+
+    INTCONbits.GIEL = 0;
+    motor_ms = _g_motor_ms;
+    INTCONbits.GIEL = giel;
+
+    while (motor_ms - _g_odo_motor_ms >= 1000)
+    {
+        _g_odo_motor_ms += 1000;
+        _g_odo.motor_s++;
+        _g_odo_dirty = true;
+    }
+
+    if (_g_odo_index != ODOMETER_IDLE)
+    {
+        uint8_t addr = slot_addr(_g_odo_slot) + _g_odo_index;
+        uint8_t byte = ((uint8_t *)&_g_odo_image)[_g_odo_index];
+        uint8_t stored;
+
+        if (EECON1bits.WR)
+            return;
+
+        eeprom_read_data(addr, &stored, 1);
+
+        if ((stored == byte || eeprom_write_byte(addr, byte)) &&
+                ++_g_odo_index == sizeof(_g_odo_image))
+            odometer_end_write();
+
+        return;
+    }
+
+    if (_g_odo_dirty && now - _g_odo_flush_ms >= ODOMETER_FLUSH_MS)
+        odometer_begin_write();
+}
+
+/* Writes out anything not yet saved and waits for it; used before a reset */
+void odometer_sync(void)
+{
+    if (_g_odo_index == ODOMETER_IDLE && !_g_odo_dirty)
+        return;
+
+    odometer_begin_write();
+    eeprom_write_data(slot_addr(_g_odo_slot), (uint8_t *)&_g_odo_image, sizeof(_g_odo_image));
+
+    while (EECON1bits.WR);
+
+    odometer_end_write();
+}
+
+/*
+ * One part of the report per call, so the monitor can send it a piece
+ * at a time; returns false past the last part. Each part fits the
+ * monitor's reply buffer.
+ */
+bool odometer_report(uint8_t part)
+{
+    if (part == 0)
+        xprintf("Motor time: %lu h %u min\r\n", _g_odo.motor_s / 3600, (uint16_t)((_g_odo.motor_s / 60) % 60));
+    else if (part == 1)
+        xprintf("Selects: %u resets: %u\r\nPasses by track:", _g_odo.selects, _g_odo.resets);
+    else if (part <= MAX_TRACK + 2)
+        xprintf(" %u:%u", part - 2, _g_odo.passes[part - 2]);
+    else if (part == MAX_TRACK + 3)
+        xprintf("\r\nRecord: %u%s\r\n", _g_odo.sequence, _g_odo_dirty ? " (changes not yet saved)" : "");
+    else
+        return false;
+
+    return true;
+}
+
+void odometer_count_pass(uint8_t track)
+{
+    if (track <= MAX_TRACK)
+    {
+        _g_odo.passes[track]++;
+        _g_odo_dirty = true;
+    }
+}
+
+void odometer_count_select(void)
+{
+    _g_odo.selects++;
+    _g_odo_dirty = true;
+}
+
+void odometer_count_reset(void)
+{
+    _g_odo.resets++;
+    _g_odo_dirty = true;
+}
+
+#endif /* FEATURE_ODOMETER */
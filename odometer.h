@@ -0,0 +1,53 @@
+/*
+ * File:   odometer.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:44
+ */
+
+#ifndef __ODOMETER_H__
+#define __ODOMETER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+#include "plan.h"
+
+#define ODOMETER_FLUSH_MS   600000UL    /* 10 minutes between periodic saves */
+
+/*
+ * Lifetime counters. Saved whole, in turn to each of the EEPROM slots
+ * with a rising sequence number, so a write cut short by a reset or
+ * power loss leaves the previous record intact.
+ */
+typedef struct {
+    uint16_t sequence;
+    uint16_t passes[MAX_TRACK + 1];
+    uint32_t motor_s;
+    uint16_t selects;
+    uint16_t resets;
+    uint16_t crc;
+} odometer_t;
+
+#if FEATURE_ODOMETER
+// Milliseconds with GO asserted, counted by the 1 ms tick
+extern volatile uint32_t _g_motor_ms;
+
+void odometer_load(void);
+void odometer_poll(void);
+void odometer_sync(void);
+bool odometer_report(uint8_t part);
+void odometer_count_pass(uint8_t track);
+void odometer_count_select(void);
+void odometer_count_reset(void);
+#else
+#define odometer_load()                 ((void)0)
+#define odometer_poll()                 ((void)0)
+#define odometer_sync()                 ((void)0)
+#define odometer_count_pass(track)      ((void)0)
+#define odometer_count_select()         ((void)0)
+#define odometer_count_reset()          ((void)0)
+#endif
+
+#endif /* __ODOMETER_H__ */
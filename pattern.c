@@ -0,0 +1,160 @@
+/*
+ * File:   pattern.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:48
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "project.h"
+#include "iopins.h"
+#include "timers.h"
+#include "pattern.h"
+
+#if FEATURE_PATTERN
+
+#define LFSR_SEED               0x7FFF
+
+static const char * const _g_pattern_names[] = {
+    "external", "all", "isolated", "prbs"
+};
+
+// QIC GCR 4/5: no more than two zeros in a row, within or between codes
+static const uint8_t _g_gcr[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+// 100 100 100 ... across three bytes
+static const uint8_t _g_isolated[3] = { 0x92, 0x49, 0x24 };
+
+volatile pattern_state_t _g_pattern;
+
+static uint8_t _g_pattern_type;
+static uint8_t _g_pattern_step;
+static uint16_t _g_lfsr;
+static uint16_t _g_gcr_bits;
+static uint8_t _g_gcr_count;
+
+const char *pattern_name(uint8_t pattern)
+{
+    return _g_pattern_names[pattern & PATTERN_MASK];
+}
+
+/* x^15 + x^14 + 1, four steps per nibble */
+static uint8_t lfsr_nibble(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < 4; i++)
+    {
+        uint16_t bit = ((_g_lfsr >> 14) ^ (_g_lfsr >> 13)) & 0x01;
+        _g_lfsr = ((_g_lfsr << 1) | bit) & 0x7FFF;
+    }
+
+    return _g_lfsr & 0x0F;
+}
+
+static uint8_t next_byte(void)
+{
+    switch (_g_pattern_type)
+    {
+        case PATTERN_ISOLATED:
+        {
+            uint8_t byte = _g_isolated[_g_pattern_step];
+
+            if (++_g_pattern_step == sizeof(_g_isolated))
+                _g_pattern_step = 0;
+
+            return byte;
+        }
+        case PATTERN_PRBS:
+        {
+            // Five bit codes packed MSB first into whole bytes
+            while (_g_gcr_count < 8)
+            {
+                _g_gcr_bits = (_g_gcr_bits << 5) | _g_gcr[lfsr_nibble()];
+                _g_gcr_count += 5;
+            }
+
+            _g_gcr_count -= 8;
+
+            return (uint8_t)(_g_gcr_bits >> _g_gcr_count);
+        }
+        default:
+        {
+            return 0xFF;
+        }
+    }
+}
+
+void pattern_start(uint8_t pattern, uint8_t khz)
+{
+    uint8_t i;
+
+    pattern_stop();
+
+    if (pattern == PATTERN_EXTERNAL || !timer0_frequency(khz))
+        return;
+
+    _g_pattern_type = pattern;
+    _g_pattern_step = 0;
+    _g_lfsr = LFSR_SEED;
+    _g_gcr_bits = 0;
+    _g_gcr_count = 0;
+
+    // The first byte goes straight out, the ring starts full behind it
+    _g_pattern.bits = next_byte();
+    _g_pattern.count = 8;
+
+    for (i = 0; i < PATTERN_RING_SIZE - 1; i++)
+        _g_pattern.ring[i] = next_byte();
+
+    _g_pattern.head = PATTERN_RING_SIZE - 1;
+    _g_pattern.tail = 0;
+    _g_pattern.underruns = 0;
+    _g_pattern.active = true;
+
+    LATC = 0x01;
+    WDMtris = 0;
+    WDPtris = 0;
+    timer0_start();
+}
+
+/* Refills the ring; one free slot is kept so head == tail only when empty */
+void pattern_poll(void)
+{
+    uint8_t next;
+
+    if (!_g_pattern.active)
+        return;
+
+    for (;;)
+    {
+        next = (_g_pattern.head + 1) & (PATTERN_RING_SIZE - 1);
+
+        if (next == _g_pattern.tail)
+            break;
+
+        _g_pattern.ring[_g_pattern.head] = next_byte();
+        _g_pattern.head = next;
+    }
+}
+
+void pattern_stop(void)
+{
+    if (!_g_pattern.active)
+        return;
+
+    timer0_stop();
+    _g_pattern.active = false;
+
+    WDMtris = 1;
+    WDPtris = 1;
+    LATC = 0x03;
+}
+
+#endif /* FEATURE_PATTERN */
@@ -0,0 +1,60 @@
+/*
+ * File:   pattern.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:48
+ */
+
+#ifndef __PATTERN_H__
+#define __PATTERN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+
+#define PATTERN_EXTERNAL        0   // Signal from the external generator
+#define PATTERN_ALL             1   // A transition in every bit cell
+#define PATTERN_ISOLATED        2   // 100 repeated, the longest gap GCR allows
+#define PATTERN_PRBS            3   // LFSR nibbles through the GCR 4/5 code
+
+#define PATTERN_BITS            2   // Per track in the configuration word
+#define PATTERN_MASK            0x03
+
+#define PATTERN_MIN_KHZ         25
+#define PATTERN_MAX_KHZ         60  // The bit shifting handler is slower than the plain tone
+
+#define PATTERN_RING_SIZE       16  // Power of two
+
+/*
+ * Shared with the timer0 interrupt, which sends one bit per interrupt
+ * NRZI style (a 1 toggles WDP/WDM) and takes the next byte from the
+ * ring after every eighth. pattern_poll() keeps the ring topped up.
+ */
+typedef struct {
+    uint8_t ring[PATTERN_RING_SIZE];
+    uint8_t head;           // Written by pattern_poll()
+    uint8_t tail;           // Written by the interrupt
+    uint8_t bits;
+    uint8_t count;
+    uint8_t underruns;
+    bool active;
+} pattern_state_t;
+
+extern volatile pattern_state_t _g_pattern;
+
+#define PATTERN_FOR_TRACK(patterns, track) \
+    ((uint8_t)(((patterns) >> ((track) * PATTERN_BITS)) & PATTERN_MASK))
+
+#if FEATURE_PATTERN
+const char *pattern_name(uint8_t pattern);
+void pattern_start(uint8_t pattern, uint8_t khz);
+void pattern_poll(void);
+void pattern_stop(void);
+#else
+#define pattern_start(pattern, khz)     ((void)0)
+#define pattern_poll()                  ((void)0)
+#define pattern_stop()                  ((void)0)
+#endif
+
+#endif /* __PATTERN_H__ */
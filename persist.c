@@ -0,0 +1,88 @@
+/*
+ * File:   persist.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:39
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "project.h"
+#include "config.h"
+#include "util.h"
+#include "persist.h"
+
+#if FEATURE_PERSIST
+
+static persistent persist_t _g_persist;
+
+void persist_save(const sys_runstate_t *rs)
+{
+    persist_t *ps = &_g_persist;
+
+    ps->magic = PERSIST_MAGIC;
+    ps->operation = _g_cfg.operation;
+    ps->tape_zone = rs->tape_zone;
+    ps->track = rs->track;
+    ps->position = rs->position;
+    ps->passes = rs->passes;
+    ps->normal_leg_ms = rs->normal_leg_ms;
+    ps->normal_leg_tach = rs->normal_leg_tach;
+    ps->cartridge = rs->cartridge;
+    ps->tape_tach = rs->tape_tach;
+    ps->hole_tach = rs->hole_tach;
+    ps->crc = crc16((const uint8_t *)ps, offsetof(persist_t, crc));
+}
+
+void persist_invalidate(void)
+{
+    _g_persist.magic = 0;
+}
+
+/*
+ * Restores the run state saved before a software reset. Only valid when
+ * the last reset was the 'reset' instruction and the block is intact.
+ * The drive's speed reference is kept whatever the operation; the tape
+ * position and progress only when it was saved by the same operation.
+ */
+bool persist_restore(sys_runstate_t *rs, uint8_t operation)
+{
+    persist_t *ps = &_g_persist;
+    bool software_reset = !RCONbits.RI;
+
+    RCONbits.RI = 1;
+
+    if (!software_reset || ps->magic != PERSIST_MAGIC ||
+            ps->crc != crc16((const uint8_t *)ps, offsetof(persist_t, crc)))
+    {
+        persist_invalidate();
+        return false;
+    }
+
+    rs->normal_leg_ms = ps->normal_leg_ms;
+    rs->normal_leg_tach = ps->normal_leg_tach;
+
+    if (ps->operation != operation)
+    {
+        persist_invalidate();
+        return false;
+    }
+
+    rs->tape_zone = ps->tape_zone;
+    rs->track = ps->track;
+    rs->position = ps->position;
+    rs->passes = ps->passes;
+    rs->cartridge = ps->cartridge;
+    rs->cartridge_measured = (ps->tape_tach != 0);
+    rs->tape_tach = ps->tape_tach;
+    rs->hole_tach = ps->hole_tach;
+
+    // Single use: a second reset without a fresh save starts cold
+    persist_invalidate();
+
+    return true;
+}
+
+#endif /* FEATURE_PERSIST */
@@ -0,0 +1,47 @@
+/*
+ * File:   persist.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:39
+ */
+
+#ifndef __PERSIST_H__
+#define __PERSIST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+
+#define PERSIST_MAGIC       0x5254
+
+/*
+ * Run state kept in RAM the C startup code does not clear. It survives
+ * reset() (the 'reset' instruction) but not a power cycle, which the
+ * CRC and RCON.RI check catch.
+ */
+typedef struct {
+    uint16_t magic;
+    uint8_t operation;
+    uint8_t tape_zone;
+    uint8_t track;
+    int16_t position;
+    uint16_t passes;
+    uint32_t normal_leg_ms;
+    uint16_t normal_leg_tach;
+    uint8_t cartridge;
+    uint16_t tape_tach;
+    uint16_t hole_tach;
+    uint16_t crc;
+} persist_t;
+
+#if FEATURE_PERSIST
+void persist_save(const sys_runstate_t *rs);
+void persist_invalidate(void);
+bool persist_restore(sys_runstate_t *rs, uint8_t operation);
+#else
+#define persist_save(rs)                ((void)0)
+#define persist_restore(rs, operation)  false
+#endif
+
+#endif /* __PERSIST_H__ */
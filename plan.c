@@ -0,0 +1,65 @@
+/*
+ * File:   plan.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:34
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+#include "plan.h"
+
+static int8_t take_track(uint16_t *pending, bool reverse)
+{
+    uint8_t track;
+
+    for (track = reverse ? 1 : 0; track <= MAX_TRACK; track += 2)
+    {
+        if (*pending & (1 << track))
+        {
+            *pending &= ~(1 << track);
+            return track;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Orders the tracks in 'mask' for the least tape travel. Every leg is a
+ * full traversal, so directions must alternate. At each end the next
+ * track needing that direction is taken, and an empty leg is only used
+ * when none is left. When the position is not known the tape is first
+ * run to BOT.
+ */
+void plan_tracks(track_plan_t *plan, uint16_t mask, uint8_t tape_zone)
+{
+    bool at_bot = (tape_zone == TAPE_ZONE_BOT);
+    uint16_t pending = mask & ALL_TRACKS;
+
+    plan->count = 0;
+    plan->start_at_bot = at_bot;
+
+    if (tape_zone != TAPE_ZONE_BOT && tape_zone != TAPE_ZONE_EOT)
+    {
+        plan->start_at_bot = false;
+        plan->legs[plan->count++] = PLAN_REPOSITION;
+        at_bot = true;
+    }
+
+    while (pending && plan->count < PLAN_MAX_LEGS)
+    {
+        int8_t track = take_track(&pending, !at_bot);
+
+        plan->legs[plan->count++] = track < 0 ? PLAN_REPOSITION : (uint8_t)track;
+        at_bot = !at_bot;
+    }
+}
+
+bool plan_leg_reverse(const track_plan_t *plan, uint8_t leg)
+{
+    // Legs alternate direction, starting forward from BOT
+    return plan->start_at_bot ? (leg & 0x01) : !(leg & 0x01);
+}
@@ -0,0 +1,38 @@
+/*
+ * File:   plan.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:34
+ */
+
+#ifndef __PLAN_H__
+#define __PLAN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_TRACK           8
+#define ALL_TRACKS          0x01FF
+
+// Empty end-to-end leg used only to reach the other end of the tape
+#define PLAN_REPOSITION     0xFF
+
+/*
+ * Worst case: only the five forward tracks, each preceded by an empty
+ * or initial reverse leg.
+ */
+#define PLAN_MAX_LEGS       10
+
+typedef struct {
+    bool start_at_bot;
+    uint8_t count;
+    uint8_t legs[PLAN_MAX_LEGS];
+} track_plan_t;
+
+/* Even tracks are recorded BOT to EOT, odd tracks EOT to BOT */
+#define TRACK_REVERSE(track)    ((track) & 0x01)
+
+void plan_tracks(track_plan_t *plan, uint16_t mask, uint8_t tape_zone);
+bool plan_leg_reverse(const track_plan_t *plan, uint8_t leg);
+
+#endif /* __PLAN_H__ */
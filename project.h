@@ -6,10 +6,112 @@
 #define _XTAL_FREQ 49152000 // Flogging it a bit. Limit is 40MHz
 #define UART_BAUD 9600
 
+/*
+ * Optional features. The PIC18F4320 has 8 KB of program memory and 512
+ * bytes of RAM, and everything together needs several times that, so a
+ * build carries the core exerciser plus whichever of these are set to 1
+ * (-DFEATURE_xxx=1). The MPLAB project has a named build for each group:
+ * PIC18F4320 is the core, and _service, _writetest, _motion, _monitor
+ * and _host add the features in their define-macros. FEATURE_ALL turns
+ * on every one not given explicitly, for host checks. 'make xc8-size'
+ * in tools/ links every named build with XC8 and fails any that does not
+ * fit; './fwsize.sh -f' and '-b' only estimate.
+ */
+#ifndef FEATURE_ALL
+#define FEATURE_ALL         0
+#endif
+
+#ifndef FEATURE_HIGHSPEED
+#define FEATURE_HIGHSPEED   FEATURE_ALL     // HSD rewinds and repositioning, 'highspeed'
+#endif
+#ifndef FEATURE_TUNE
+#define FEATURE_TUNE        FEATURE_ALL     // 'tune', 'resetpulse' and 'settle'
+#endif
+#ifndef FEATURE_TRACKS
+#define FEATURE_TRACKS      FEATURE_ALL     // 'tracks' to pick a set of tracks
+#endif
+#ifndef FEATURE_MEMORY
+#define FEATURE_MEMORY      FEATURE_ALL     // 'memory' arena layout report
+#endif
+#ifndef FEATURE_SCRIPT
+#define FEATURE_SCRIPT      FEATURE_ALL     // EEPROM sequence scripts
+#endif
+#ifndef FEATURE_RETENSION
+#define FEATURE_RETENSION   FEATURE_ALL
+#endif
+#ifndef FEATURE_ERASE
+#define FEATURE_ERASE       FEATURE_ALL
+#endif
+#ifndef FEATURE_RAMP
+#define FEATURE_RAMP        FEATURE_ALL
+#endif
+#ifndef FEATURE_SHUTTLE
+#define FEATURE_SHUTTLE     FEATURE_ALL
+#endif
+#ifndef FEATURE_SWEEP
+#define FEATURE_SWEEP       FEATURE_ALL
+#endif
+#ifndef FEATURE_PATTERN
+#define FEATURE_PATTERN     FEATURE_ALL     // On chip write test patterns
+#endif
+#ifndef FEATURE_MONITOR
+#define FEATURE_MONITOR     FEATURE_ALL     // Live commands while an operation runs
+#endif
+#ifndef FEATURE_PERSIST
+#define FEATURE_PERSIST     FEATURE_ALL     // Resume after a software reset
+#endif
+#ifndef FEATURE_ODOMETER
+#define FEATURE_ODOMETER    FEATURE_ALL     // Lifetime counters in EEPROM
+#endif
+#ifndef FEATURE_TELEMETRY
+#define FEATURE_TELEMETRY   FEATURE_ALL     // Binary status and tach frames
+#endif
+#ifndef FEATURE_CARTRIDGE
+#define FEATURE_CARTRIDGE   FEATURE_ALL     // Cartridge type detection
+#endif
+
+#define TAPE_ZONE_UNKNOWN  0
+#define TAPE_ZONE_BOT      1
+#define TAPE_ZONE_EOT      2
+#define TAPE_ZONE_EW       3
+#define TAPE_ZONE_DATA     4
+
+typedef struct {
+    volatile uint8_t tape_zone;
+    uint8_t track;
+    uint8_t traversals;
+    uint16_t passes;
+    bool resumed;
+    uint32_t leg_ms;
+    uint32_t normal_leg_ms;
+    uint16_t normal_leg_tach;
+    uint8_t paused;
+    bool write_protected;
+    volatile int16_t position;
+    volatile uint16_t tach_last;
+    volatile uint16_t tach_interval;
+    volatile uint32_t tach_total;
+    volatile int16_t ew_position;
+    volatile int16_t eot_position;
+    uint8_t cartridge;
+    bool cartridge_measured;
+    uint16_t tape_tach;
+    uint16_t hole_tach;
+} sys_runstate_t;
+
+#define PAUSED_IDLE        1
+#define PAUSED_MOVING      2
+
+extern sys_runstate_t _g_rs;
+extern volatile uint8_t _g_estop;
+
+void check_keys(void);
 void drive_reset(void);
 bool drive_select(bool selected);
 void drive_select_track(uint8_t track);
 bool drive_go(bool go, bool reverse);
+void drive_write_gate(bool write, bool erase);
+void drive_high_speed(bool high);
 
 #include <xc.h>
 
@@ -0,0 +1,510 @@
+/*
+ * File:   script.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:33
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "project.h"
+#include "config.h"
+#include "util.h"
+#include "xprintf.h"
+#include "timers.h"
+#include "plan.h"
+#include "script.h"
+
+#if FEATURE_SCRIPT
+
+typedef struct {
+    uint8_t start;
+    uint8_t remaining;
+} script_loop_t;
+
+typedef struct {
+    uint8_t base;
+    uint8_t len;
+    uint8_t pc;
+    uint8_t depth;
+    uint8_t gates;
+    uint8_t wait_zone;
+    bool wait_time;
+    bool zone_timeout;
+    uint32_t deadline;
+    uint32_t zone_deadline;
+    uint32_t last_ms;
+    script_loop_t loops[SCRIPT_MAX_LOOPS];
+} script_state_t;
+
+typedef struct {
+    uint8_t base;
+    uint8_t len;
+    uint8_t depth;
+} script_loader_t;
+
+static const char * const _g_zone_names[] = { "unknown", "bot", "eot", "ew", "data" };
+static const char * const _g_go_names[] = { "stop", "fwd", "rev" };
+
+static script_state_t _g_script;
+static script_loader_t _g_loader;
+
+volatile uint8_t _g_zone_seen;
+
+static uint8_t slot_base(uint8_t slot)
+{
+    return EE_SCRIPT_ADDR + (slot * EE_SCRIPT_SLOT_SIZE);
+}
+
+static int8_t lookup_name(const char * const *names, uint8_t count, const char *arg)
+{
+    uint8_t i;
+
+    if (!arg)
+        return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!stricmp(names[i], arg))
+            return i;
+    }
+
+    return -1;
+}
+
+/*
+ * Reads a decimal operand that must lie within min..max. Anything else,
+ * including a value too large for its opcode byte, is rejected rather
+ * than wrapped.
+ */
+static bool parse_operand(const char *arg, uint16_t min, uint16_t max, uint16_t *value)
+{
+    uint32_t result = 0;
+
+    if (!arg || !*arg)
+        return false;
+
+    for (; *arg; arg++)
+    {
+        if (*arg < '0' || *arg > '9')
+            return false;
+
+        result = (result * 10) + (*arg - '0');
+        if (result > max)
+            return false;
+    }
+
+    if (result < min)
+        return false;
+
+    *value = (uint16_t)result;
+    return true;
+}
+
+static const char *write_name(uint8_t gates)
+{
+    if (gates & SWR_EEN)
+        return "erase";
+    if (gates & SWR_WEN)
+        return "on";
+    return "off";
+}
+
+void script_load_begin(uint8_t slot)
+{
+    uint8_t empty = 0;
+
+    _g_loader.base = slot_base(slot);
+    _g_loader.len = 0;
+    _g_loader.depth = 0;
+
+    // The slot reads as empty until the length is written by script_load_end()
+    eeprom_write_data(_g_loader.base, &empty, 1);
+}
+
+int8_t script_load_line(char *line)
+{
+    uint8_t code[3];
+    uint8_t len = 2;
+    char *command;
+    char *arg;
+    int8_t index;
+    uint16_t value;
+
+    command = strtok(line, " ");
+    arg = strtok(NULL, " ");
+
+    if (!command)
+        return 0;
+
+    if (!stricmp(command, "end"))
+        return -1;
+
+    if (!stricmp(command, "select") && parse_operand(arg, 0, 1, &value))
+    {
+        code[0] = SOP_SELECT;
+        code[1] = (uint8_t)value;
+    }
+    else if (!stricmp(command, "track") && parse_operand(arg, 0, MAX_TRACK, &value))
+    {
+        code[0] = SOP_TRACK;
+        code[1] = (uint8_t)value;
+    }
+    else if (!stricmp(command, "go") && (index = lookup_name(_g_go_names, 3, arg)) >= 0)
+    {
+        code[0] = SOP_GO;
+        code[1] = index;
+    }
+    else if (!stricmp(command, "wait") && (index = lookup_name(_g_zone_names, 5, arg)) > 0)
+    {
+        code[0] = SOP_WAIT_ZONE;
+        code[1] = index;
+
+        // An optional timeout in seconds
+        arg = strtok(NULL, " ");
+        if (arg)
+        {
+            if (!parse_operand(arg, 1, 0xFF, &value))
+                goto invalid;
+
+            code[0] = SOP_WAIT_ZONE_FOR;
+            code[2] = (uint8_t)value;
+            len = 3;
+        }
+    }
+    else if (!stricmp(command, "delay") && parse_operand(arg, 1, 0xFFFF, &value))
+    {
+        code[0] = SOP_WAIT_MS;
+        code[1] = (uint8_t)value;
+        code[2] = (uint8_t)(value >> 8);
+        len = 3;
+    }
+    else if (!stricmp(command, "write") && arg)
+    {
+        code[0] = SOP_WRITE;
+
+        if (!stricmp(arg, "off"))
+            code[1] = 0;
+        else if (!stricmp(arg, "on"))
+            code[1] = SWR_WEN;
+        else if (!stricmp(arg, "erase"))
+            code[1] = SWR_WEN | SWR_EEN;
+        else
+            goto invalid;
+    }
+    else if (!stricmp(command, "loop") && parse_operand(arg, 1, 0xFF, &value))
+    {
+        if (_g_loader.depth == SCRIPT_MAX_LOOPS)
+        {
+            xprintf("Error: Loops nested too deep\r\n");
+            return 1;
+        }
+        _g_loader.depth++;
+        code[0] = SOP_LOOP;
+        code[1] = (uint8_t)value;
+    }
+    else if (!stricmp(command, "next"))
+    {
+        if (!_g_loader.depth)
+        {
+            xprintf("Error: 'next' without 'loop'\r\n");
+            return 1;
+        }
+        _g_loader.depth--;
+        code[0] = SOP_NEXT;
+        len = 1;
+    }
+    else if (!stricmp(command, "report"))
+    {
+        code[0] = SOP_REPORT;
+        len = 1;
+    }
+    else
+    {
+        goto invalid;
+    }
+
+    if (_g_loader.len + len > SCRIPT_MAX_LEN)
+    {
+        xprintf("Error: Script too long\r\n");
+        return 1;
+    }
+
+    eeprom_write_data(_g_loader.base + 1 + _g_loader.len, code, len);
+    _g_loader.len += len;
+
+    return 0;
+
+invalid:
+    xprintf("Error: Invalid script line\r\n");
+    return 1;
+}
+
+bool script_load_end(void)
+{
+    if (_g_loader.depth)
+    {
+        xprintf("Error: 'loop' without 'next'. Script discarded.\r\n");
+        return false;
+    }
+
+    eeprom_write_data(_g_loader.base, &_g_loader.len, 1);
+    xprintf("Script stored, %u bytes\r\n", _g_loader.len);
+
+    return true;
+}
+
+void script_list(uint8_t slot)
+{
+    uint8_t base = slot_base(slot);
+    uint8_t len;
+    uint8_t pc = 0;
+    uint8_t code[3];
+
+    eeprom_read_data(base, &len, 1);
+
+    if (!len || len > SCRIPT_MAX_LEN)
+    {
+        xprintf("Script %u is empty\r\n", slot);
+        return;
+    }
+
+    while (pc < len)
+    {
+        eeprom_read_data(base + 1 + pc, code, 3);
+        xprintf("%3u: ", pc);
+
+        switch (code[0])
+        {
+            case SOP_SELECT:
+                xprintf("select %u", code[1]);
+                break;
+            case SOP_TRACK:
+                xprintf("track %u", code[1]);
+                break;
+            case SOP_GO:
+                xprintf("go %s", _g_go_names[code[1] % 3]);
+                break;
+            case SOP_WAIT_ZONE:
+                xprintf("wait %s", _g_zone_names[code[1] % 5]);
+                break;
+            case SOP_WAIT_ZONE_FOR:
+                xprintf("wait %s %u", _g_zone_names[code[1] % 5], code[2]);
+                pc++;
+                break;
+            case SOP_WAIT_MS:
+                xprintf("delay %u", code[1] | (code[2] << 8));
+                pc++;
+                break;
+            case SOP_WRITE:
+                xprintf("write %s", write_name(code[1]));
+                break;
+            case SOP_LOOP:
+                xprintf("loop %u", code[1]);
+                break;
+            case SOP_NEXT:
+                xprintf("next");
+                pc--;
+                break;
+            case SOP_REPORT:
+                xprintf("report");
+                pc--;
+                break;
+            default:
+                xprintf("?? %02x", code[0]);
+                pc--;
+                break;
+        }
+
+        xprintf("\r\n");
+        pc += 2;
+    }
+}
+
+bool script_start(uint8_t slot)
+{
+    script_state_t *sc = &_g_script;
+
+    memset(sc, 0, sizeof(*sc));
+
+    if (slot >= EE_SCRIPT_SLOTS)
+    {
+        xprintf("Error: Invalid script slot\r\n");
+        return false;
+    }
+
+    sc->base = slot_base(slot) + 1;
+    eeprom_read_data(sc->base - 1, &sc->len, 1);
+
+    if (!sc->len || sc->len > SCRIPT_MAX_LEN)
+    {
+        xprintf("Error: Script %u is empty\r\n", slot);
+        return false;
+    }
+
+    return true;
+}
+
+void script_stop(void)
+{
+    drive_write_gate(false, false);
+    drive_go(false, false);
+}
+
+/*
+ * Runs at most one script instruction per call. Waits return straight
+ * away so the caller keeps servicing keys between steps. Returns false
+ * once the script has finished or failed.
+ */
+bool script_step(sys_runstate_t *rs)
+{
+    script_state_t *sc = &_g_script;
+    uint8_t code[3];
+    uint32_t now = timer_ms();
+
+    // Write gates only open inside the data zone, as in the write test
+    if (sc->gates && rs->tape_zone == TAPE_ZONE_DATA)
+        drive_write_gate(sc->gates & SWR_WEN, sc->gates & SWR_EEN);
+    else
+        drive_write_gate(false, false);
+
+    if (rs->paused)
+    {
+        // A pause holds a zone timeout where it was
+        sc->zone_deadline += now - sc->last_ms;
+        sc->last_ms = now;
+        return true;
+    }
+
+    sc->last_ms = now;
+
+    if (sc->wait_zone != TAPE_ZONE_UNKNOWN)
+    {
+        // The interrupt latches each zone entered, so one the tape passed
+        // through between two steps still ends the wait
+        if (!(_g_zone_seen & SCRIPT_ZONE_BIT(sc->wait_zone)) && rs->tape_zone != sc->wait_zone)
+        {
+            if (sc->zone_timeout && (int32_t)(now - sc->zone_deadline) >= 0)
+            {
+                xprintf("Error: Script wait for %s timed out at pc %u\r\n",
+                    _g_zone_names[sc->wait_zone % 5], sc->pc);
+                return false;
+            }
+            return true;
+        }
+        sc->wait_zone = TAPE_ZONE_UNKNOWN;
+    }
+
+    if (sc->wait_time)
+    {
+        if ((int32_t)(now - sc->deadline) < 0)
+            return true;
+        sc->wait_time = false;
+    }
+
+    if (sc->pc >= sc->len)
+        return false;
+
+    eeprom_read_data(sc->base + sc->pc, code, 3);
+    sc->pc += 2;
+
+    switch (code[0])
+    {
+        case SOP_SELECT:
+        {
+            if (!drive_select(code[1] ? true : false))
+                return false;
+            break;
+        }
+        case SOP_TRACK:
+        {
+            drive_select_track(code[1]);
+            break;
+        }
+        case SOP_GO:
+        {
+            if (!drive_go(code[1] != SGO_STOP, code[1] == SGO_REV))
+                return false;
+            break;
+        }
+        case SOP_WAIT_ZONE:
+        case SOP_WAIT_ZONE_FOR:
+        {
+            // One store, so the interrupt cannot be part way through it
+            _g_zone_seen = 0;
+            sc->wait_zone = code[1];
+            sc->zone_timeout = (code[0] == SOP_WAIT_ZONE_FOR);
+
+            if (sc->zone_timeout)
+            {
+                sc->zone_deadline = now + (code[2] * 1000UL);
+                sc->pc++;
+            }
+            break;
+        }
+        case SOP_WAIT_MS:
+        {
+            sc->deadline = now + (code[1] | (code[2] << 8));
+            sc->wait_time = true;
+            sc->pc++;
+            break;
+        }
+        case SOP_WRITE:
+        {
+            sc->gates = code[1];
+            break;
+        }
+        case SOP_LOOP:
+        {
+            // The loader checks nesting, but the slot may hold anything
+            if (sc->depth >= SCRIPT_MAX_LOOPS)
+            {
+                xprintf("Error: Script loops nested too deep at pc %u\r\n", sc->pc - 2);
+                return false;
+            }
+
+            sc->loops[sc->depth].start = sc->pc;
+            sc->loops[sc->depth].remaining = code[1];
+            sc->depth++;
+            break;
+        }
+        case SOP_NEXT:
+        {
+            script_loop_t *loop;
+
+            sc->pc--;
+
+            if (!sc->depth)
+            {
+                xprintf("Error: Script 'next' without 'loop' at pc %u\r\n", sc->pc - 1);
+                return false;
+            }
+
+            loop = &sc->loops[sc->depth - 1];
+
+            if (--loop->remaining)
+                sc->pc = loop->start;
+            else
+                sc->depth--;
+            break;
+        }
+        case SOP_REPORT:
+        {
+            sc->pc--;
+            xprintf("Script: pc %u zone %s track %u at %lu ms\r\n",
+                sc->pc, _g_zone_names[rs->tape_zone], rs->track, timer_ms());
+            break;
+        }
+        default:
+        {
+            xprintf("Error: Bad script opcode %02x\r\n", code[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* FEATURE_SCRIPT */
@@ -0,0 +1,59 @@
+/*
+ * File:   script.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:33
+ */
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+#include "config.h"
+
+/*
+ * Sequence scripts are stored as bytecode in EEPROM, one script per slot.
+ * A slot holds a length byte followed by the opcodes below.
+ */
+#define SOP_END             0x00
+#define SOP_SELECT          0x01    // + 0|1
+#define SOP_TRACK           0x02    // + track
+#define SOP_GO              0x03    // + SGO_xxx
+#define SOP_WAIT_ZONE       0x04    // + TAPE_ZONE_xxx
+#define SOP_WAIT_MS         0x05    // + ms, 16 bit little endian
+#define SOP_WRITE           0x06    // + SWR_xxx gate bits
+#define SOP_LOOP            0x07    // + count
+#define SOP_NEXT            0x08
+#define SOP_REPORT          0x09
+#define SOP_WAIT_ZONE_FOR   0x0A    // + TAPE_ZONE_xxx, timeout in seconds
+
+#define SGO_STOP            0
+#define SGO_FWD             1
+#define SGO_REV             2
+
+#define SWR_WEN             0x01
+#define SWR_EEN             0x02
+
+#define SCRIPT_MAX_LOOPS    2
+#define SCRIPT_MAX_LEN      (EE_SCRIPT_SLOT_SIZE - 1)
+
+/* Loading: compile one text line at a time into the slot */
+void script_load_begin(uint8_t slot);
+int8_t script_load_line(char *line);
+bool script_load_end(void);
+
+void script_list(uint8_t slot);
+
+bool script_start(uint8_t slot);
+bool script_step(sys_runstate_t *rs);
+void script_stop(void);
+
+// Zones entered since the last wait started, one bit per TAPE_ZONE_xxx,
+// set by the zone change interrupt
+#define SCRIPT_ZONE_BIT(zone)   ((uint8_t)(1 << (zone)))
+extern volatile uint8_t _g_zone_seen;
+
+#endif /* __SCRIPT_H__ */
@@ -0,0 +1,230 @@
+/*
+ * File:   telemetry.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:49
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+
+#include "project.h"
+#include "config.h"
+#include "util.h"
+#include "usart.h"
+#include "xprintf.h"
+#include "iopins.h"
+#include "timers.h"
+#include "pattern.h"
+#include "monitor.h"
+#include "telemetry.h"
+
+#if FEATURE_TELEMETRY
+
+typedef char telemetry_frame_size[(sizeof(telemetry_frame_t) == 16) ? 1 : -1];
+typedef char tach_frame_size[(sizeof(tach_frame_t) == 32) ? 1 : -1];
+
+volatile uint16_t _g_tach_ring[TACH_RING_SIZE];
+volatile uint8_t _g_tach_head;
+
+// One frame goes out at a time, whichever kind
+static union {
+    telemetry_frame_t status;
+    tach_frame_t tach;
+    uint8_t bytes[sizeof(tach_frame_t)];
+} _g_frame;
+static uint8_t _g_frame_size;
+static uint8_t _g_frame_index;
+
+static uint8_t _g_sequence;
+static uint16_t _g_drops;
+static uint8_t _g_select_errors;
+static uint32_t _g_next_ms;
+
+static uint8_t _g_tach_tail;
+static uint8_t _g_tach_sequence;
+static bool _g_tach_lost;
+
+bool telemetry_active(void)
+{
+    return _g_cfg.telemetry_ms != 0 || _g_cfg.tach_stream;
+}
+
+static void telemetry_build(void)
+{
+    telemetry_frame_t *frame = &_g_frame.status;
+    uint8_t flags = 0;
+    uint8_t gie;
+
+    if (OUTPUT_ASSERTED(REV))
+        flags |= TELEMETRY_REV;
+    if (OUTPUT_ASSERTED(GO))
+        flags |= TELEMETRY_GO;
+    if (OUTPUT_ASSERTED(WEN))
+        flags |= TELEMETRY_WEN;
+    if (OUTPUT_ASSERTED(EEN))
+        flags |= TELEMETRY_EEN;
+    if (OUTPUT_ASSERTED(HSD))
+        flags |= TELEMETRY_HSD;
+    if (INPUT_ASSERTED(SLD))
+        flags |= TELEMETRY_SELECTED;
+    if (_g_rs.paused)
+        flags |= TELEMETRY_PAUSED;
+    if (_g_estop)
+        flags |= TELEMETRY_ESTOP;
+
+    frame->sync[0] = TELEMETRY_SYNC0;
+    frame->sync[1] = TELEMETRY_SYNC1;
+    frame->sequence = _g_sequence++;
+    frame->zone = _g_rs.tape_zone;
+    frame->track = _g_rs.track;
+    frame->flags = flags;
+
+    // The tach interrupt updates these; both are read in one go
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    frame->tach_interval = _g_rs.tach_interval;
+    frame->position = _g_rs.position;
+    INTCONbits.GIEH = gie;
+
+    frame->drops = _g_drops;
+    frame->select_errors = _g_select_errors;
+#if FEATURE_PATTERN
+    frame->underruns = _g_pattern.underruns;
+#else
+    frame->underruns = 0;
+#endif
+    frame->crc = crc16((const uint8_t *)frame, offsetof(telemetry_frame_t, crc));
+
+    _g_frame_size = sizeof(telemetry_frame_t);
+    _g_frame_index = 0;
+}
+
+/*
+ * Moves a frame's worth of edges out of the ring once there are enough.
+ * Interrupts stay on so the edge timestamps keep their timing; if the
+ * interrupt laps the ring while the stamps are copied they are thrown
+ * away as lost.
+ */
+static bool tach_build(void)
+{
+    tach_frame_t *frame = &_g_frame.tach;
+    uint8_t head = _g_tach_head;
+    uint8_t i;
+
+    if ((uint8_t)(head - _g_tach_tail) > TACH_RING_SIZE)
+    {
+        _g_tach_tail = head - TACH_RING_SIZE;
+        _g_tach_lost = true;
+    }
+
+    if ((uint8_t)(head - _g_tach_tail) < TACH_FRAME_STAMPS)
+        return false;
+
+    for (i = 0; i < TACH_FRAME_STAMPS; i++)
+        frame->stamps[i] = _g_tach_ring[(uint8_t)(_g_tach_tail + i) & (TACH_RING_SIZE - 1)];
+
+    if ((uint8_t)(_g_tach_head - _g_tach_tail) > TACH_RING_SIZE)
+    {
+        _g_tach_lost = true;
+        return false;
+    }
+
+    _g_tach_tail += TACH_FRAME_STAMPS;
+
+    frame->sync[0] = TELEMETRY_SYNC0;
+    frame->sync[1] = TELEMETRY_SYNC1_TACH;
+    frame->sequence = _g_tach_sequence++;
+    frame->zone = _g_rs.tape_zone;
+    frame->track = _g_rs.track;
+    frame->flags = (OUTPUT_ASSERTED(REV) ? TELEMETRY_REV : 0) | (_g_tach_lost ? TELEMETRY_TACH_LOST : 0);
+    frame->crc = crc16((const uint8_t *)frame, offsetof(tach_frame_t, crc));
+
+    _g_tach_lost = false;
+    _g_frame_size = sizeof(tach_frame_t);
+    _g_frame_index = 0;
+
+    return true;
+}
+
+/*
+ * Called from check_keys(). Only puts bytes the UART can take right
+ * now, so a frame may go out over several calls. Tach frames go first
+ * when the UART comes free, as their edges cannot wait. A status frame
+ * that falls due while another frame is still going out is dropped and
+ * counted. No frame starts while a monitor reply is partly sent; the
+ * frame goes out once the reply is finished.
+ */
+void telemetry_poll(void)
+{
+    uint32_t now;
+
+    if (!telemetry_active() || monitor_sending())
+        return;
+
+    if (_g_frame_index >= _g_frame_size && _g_cfg.tach_stream)
+        tach_build();
+
+    now = timer_ms();
+
+    if (_g_cfg.telemetry_ms && (int32_t)(now - _g_next_ms) >= 0)
+    {
+        _g_next_ms = now + _g_cfg.telemetry_ms;
+
+        if (_g_frame_index < _g_frame_size)
+        {
+            if (_g_drops < 0xFFFF)
+                _g_drops++;
+        }
+        else
+        {
+            telemetry_build();
+        }
+    }
+
+    while (_g_frame_index < _g_frame_size && !usart1_busy())
+        usart1_put(_g_frame.bytes[_g_frame_index++]);
+}
+
+/* True while a frame is partly sent; text waits for it */
+bool telemetry_sending(void)
+{
+    return _g_frame_index < _g_frame_size;
+}
+
+/*
+ * Called by putch() before any text byte: sends the rest of the frame in
+ * progress first, so text only ever lands between frames. Waits at most
+ * one frame time, 32 bytes.
+ */
+void telemetry_finish(void)
+{
+    while (_g_frame_index < _g_frame_size)
+    {
+        while (usart1_busy());
+        usart1_put(_g_frame.bytes[_g_frame_index++]);
+    }
+}
+
+void telemetry_count_select_error(void)
+{
+    if (_g_select_errors < 0xFF)
+        _g_select_errors++;
+}
+
+/* Progress text for the terminal, left out while frames are being sent */
+void progress(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (telemetry_active())
+        return;
+
+    va_start(ap, fmt);
+    xvprintf(fmt, ap);
+    va_end(ap);
+}
+
+#endif /* FEATURE_TELEMETRY */
@@ -0,0 +1,93 @@
+/*
+ * File:   telemetry.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:49
+ */
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project.h"
+#include "xprintf.h"
+
+#define TELEMETRY_SYNC0         0xA5
+#define TELEMETRY_SYNC1         0x5A    // Status frame
+#define TELEMETRY_SYNC1_TACH    0x5B    // Tach edge frame
+
+// Flags byte
+#define TELEMETRY_REV           0x01
+#define TELEMETRY_GO            0x02
+#define TELEMETRY_WEN           0x04
+#define TELEMETRY_EEN           0x08
+#define TELEMETRY_HSD           0x10
+#define TELEMETRY_SELECTED      0x20
+#define TELEMETRY_PAUSED        0x40
+#define TELEMETRY_ESTOP         0x80
+
+// Tach frame flags, beside TELEMETRY_REV
+#define TELEMETRY_TACH_LOST     0x02    // Edges went missing before this frame
+
+#define TACH_RING_SIZE          16      // Power of two
+#define TACH_FRAME_STAMPS       12
+
+/*
+ * Fixed 16 byte frame, little endian, CRC-16/CCITT-FALSE over every byte
+ * before the CRC. A host resynchronises on the two sync bytes and a good
+ * CRC; the sequence number shows where frames were dropped.
+ */
+typedef struct {
+    uint8_t sync[2];
+    uint8_t sequence;
+    uint8_t zone;
+    uint8_t track;
+    uint8_t flags;
+    uint16_t tach_interval;     // Timer1 counts, 0.65 us each
+    int16_t position;           // Tach counts from BOT
+    uint16_t drops;             // Frames dropped because the UART was busy
+    uint8_t select_errors;
+    uint8_t underruns;          // On chip pattern ring underruns
+    uint16_t crc;
+} telemetry_frame_t;
+
+/*
+ * Tach edge frame, 32 bytes, same sync and CRC scheme. The Timer1 count
+ * at each tach edge, oldest first; the host takes differences modulo
+ * 65536, so an interval has to be under 42 ms to be measured. Edges are
+ * only sent in whole frames and a frame is never dropped for a busy
+ * UART: edges that overflow the ring are counted as lost instead and
+ * the next frame carries TELEMETRY_TACH_LOST.
+ */
+typedef struct {
+    uint8_t sync[2];
+    uint8_t sequence;
+    uint8_t zone;
+    uint8_t track;
+    uint8_t flags;
+    uint16_t stamps[TACH_FRAME_STAMPS];
+    uint16_t crc;
+} tach_frame_t;
+
+// Written by the tach interrupt, one store per edge
+extern volatile uint16_t _g_tach_ring[TACH_RING_SIZE];
+extern volatile uint8_t _g_tach_head;
+
+#if FEATURE_TELEMETRY
+bool telemetry_active(void);
+void telemetry_poll(void);
+bool telemetry_sending(void);
+void telemetry_finish(void);
+void telemetry_count_select_error(void);
+void progress(const char *fmt, ...);
+#else
+#define telemetry_poll()                ((void)0)
+#define telemetry_sending()             false
+#define telemetry_finish()              ((void)0)
+#define telemetry_count_select_error()  ((void)0)
+#define progress                        xprintf
+#endif
+
+#endif /* __TELEMETRY_H__ */
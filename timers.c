@@ -17,6 +17,15 @@
 //#define LED_BLINK               0xF0 /* 7.3267MHz */
 #define LED_BLINK                 0xD8
 
+// 12.288 MHz instruction clock / 16 prescale / 48 / 16 postscale = 1 kHz
+#define MS_PERIOD                 47
+
+// Cycles lost between the interrupt handler reading TMR0L and writing it back
+#define TONE_RELOAD_CYCLES        3
+
+volatile uint32_t _g_ms;
+volatile uint8_t _g_tone_reload = 0xFE;
+
 void timer0_init(void)
 {
     T0CONbits.T0PS0 = 0;
@@ -49,3 +58,69 @@ void timer0_reset(void)
     TMR0H = LED_BLINK;
     TMR0L = 0x00;
 }
+
+/*
+ * Sets the test tone for the next timer0_start(). The handler adds the
+ * reload to the count already elapsed, so its own latency does not
+ * stretch the half cycle.
+ */
+bool timer0_frequency(uint8_t khz)
+{
+    uint16_t half_cycles;
+
+    if (khz < TONE_MIN_KHZ || khz > TONE_MAX_KHZ)
+        return false;
+
+    half_cycles = (uint16_t)((_XTAL_FREQ / 4 / 2000UL + (khz / 2)) / khz);
+    _g_tone_reload = (uint8_t)(256 - half_cycles + TONE_RELOAD_CYCLES);
+
+    return true;
+}
+
+void timer1_init(void)
+{
+    TMR1H = 0;
+    TMR1L = 0;
+
+    PIE1bits.TMR1IE = 0;
+
+    // Free running at 1/8 of the instruction clock, used for timestamps:
+    // RD16, 1:8 prescale, internal clock, oscillator off, on
+    T1CON = 0xB1;
+}
+
+uint16_t timer1_read(void)
+{
+    uint16_t value;
+
+    // In 16 bit mode reading TMR1L latches TMR1H
+    value = TMR1L;
+    value |= (uint16_t)TMR1H << 8;
+
+    return value;
+}
+
+void timer2_init(void)
+{
+    PR2 = MS_PERIOD;
+    TMR2 = 0;
+
+    IPR1bits.TMR2IP = 0;
+    PIE1bits.TMR2IE = 1;
+
+    // 1:16 prescale, 1:16 postscale, on
+    T2CON = 0x7E;
+}
+
+uint32_t timer_ms(void)
+{
+    uint32_t ms;
+    bool giel = INTCONbits.GIEL;
+
+    // The millisecond count is updated by the low priority interrupt
+    INTCONbits.GIEL = 0;
+    ms = _g_ms;
+    INTCONbits.GIEL = giel;
+
+    return ms;
+}
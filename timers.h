@@ -8,9 +8,37 @@
 #ifndef __TIMERS_H__
 #define __TIMERS_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// Timer1 runs at the instruction clock / 8: 0.65 us per count, wrapping every 42.7 ms
+#define TIMER1_PRESCALE     8
+#define TIMER1_HZ           (_XTAL_FREQ / 4 / TIMER1_PRESCALE)
+
+// Timer2 counts at the instruction clock / 16 and raises the 1 ms tick
+#define TIMER2_PRESCALE     16
+#define TICK_CYCLES         (_XTAL_FREQ / 4 / 1000)
+
+// Test tone limits. Each half cycle is one timer0 interrupt, so the top
+// end is set by the interrupt handler time and the bottom by the 8 bit count.
+// A tone edge costs the handler about 50 instruction cycles with context
+// save and restore, and about 90 when a tach edge is served in the same
+// entry. At 60 kHz a half cycle is 102 cycles, which still covers the
+// combined case; at 100 kHz (61 cycles) the handler could not keep up.
+#define TONE_MIN_KHZ        25
+#define TONE_MAX_KHZ        60
+
 void timer0_init(void);
 void timer0_start(void);
 void timer0_stop(void);
 void timer0_reset(void);
+bool timer0_frequency(uint8_t khz);
+void timer1_init(void);
+uint16_t timer1_read(void);
+void timer2_init(void);
+uint32_t timer_ms(void);
+
+extern volatile uint32_t _g_ms;
+extern volatile uint8_t _g_tone_reload;
 
 #endif /* __TIMERS_H__ */
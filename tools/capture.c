@@ -0,0 +1,162 @@
+/*
+ * File:   capture.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:53
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "capture.h"
+
+/* Longest event: escape, CAPTURE_LONG and two argument words */
+#define CAPTURE_MAX_EVENT       8
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    put16(p, (uint16_t)value);
+    put16(p + 2, (uint16_t)(value >> 16));
+}
+
+int capture_read_header(int fd, capture_header_t *header)
+{
+    uint8_t raw[CAPTURE_HEADER_SIZE];
+
+    if (pread(fd, raw, sizeof(raw), 0) != sizeof(raw))
+        return -1;
+
+    if (memcmp(raw, CAPTURE_MAGIC, 4))
+        return -1;
+
+    header->version = get16(raw + 4);
+    header->flags = get16(raw + 6);
+    header->sample_hz = get16(raw + 8) | ((uint32_t)get16(raw + 10) << 16);
+
+    if (header->version != CAPTURE_VERSION || !header->sample_hz)
+        return -1;
+
+    return 0;
+}
+
+void capture_write_header(uint8_t *out, const capture_header_t *header)
+{
+    memcpy(out, CAPTURE_MAGIC, 4);
+    put16(out + 4, header->version);
+    put16(out + 6, header->flags);
+    put32(out + 8, header->sample_hz);
+    put32(out + 12, 0);
+}
+
+void capture_stream_init(capture_stream_t *stream, int fd, off_t start, off_t end)
+{
+    stream->fd = fd;
+    stream->offset = start;
+    stream->end = end;
+    stream->pos = 0;
+    stream->len = 0;
+}
+
+/* Keeps at least CAPTURE_MAX_EVENT bytes buffered unless the range ends first */
+static void refill(capture_stream_t *stream)
+{
+    size_t keep = stream->len - stream->pos;
+    off_t next = stream->offset + stream->len;
+    size_t want;
+    ssize_t n;
+
+    if (keep >= CAPTURE_MAX_EVENT || next >= stream->end)
+        return;
+
+    memmove(stream->buf, stream->buf + stream->pos, keep);
+    stream->offset += stream->pos;
+    stream->pos = 0;
+    stream->len = keep;
+
+    want = sizeof(stream->buf) - keep;
+    if ((off_t)want > stream->end - next)
+        want = (size_t)(stream->end - next);
+
+    do
+    {
+        n = pread(stream->fd, stream->buf + keep, want, next);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0)
+        stream->len += (size_t)n;
+}
+
+int capture_next(capture_stream_t *stream, uint32_t *value)
+{
+    const uint8_t *p;
+    size_t avail;
+    uint16_t word;
+
+    refill(stream);
+
+    avail = stream->len - stream->pos;
+    p = stream->buf + stream->pos;
+
+    if (avail < 2)
+        return avail ? CAPTURE_EV_ERROR : CAPTURE_EV_EOF;
+
+    word = get16(p);
+
+    if (word)
+    {
+        stream->pos += 2;
+        *value = word;
+        return CAPTURE_EV_INTERVAL;
+    }
+
+    if (avail < 4)
+        return CAPTURE_EV_ERROR;
+
+    switch (get16(p + 2))
+    {
+        case CAPTURE_TRACK:
+            if (avail < 6)
+                return CAPTURE_EV_ERROR;
+            *value = get16(p + 4);
+            stream->pos += 6;
+            return CAPTURE_EV_TRACK;
+
+        case CAPTURE_TACH:
+            stream->pos += 4;
+            return CAPTURE_EV_TACH;
+
+        case CAPTURE_LONG:
+            if (avail < 8)
+                return CAPTURE_EV_ERROR;
+            *value = get16(p + 4) | ((uint32_t)get16(p + 6) << 16);
+            stream->pos += 8;
+            return CAPTURE_EV_INTERVAL;
+
+        case CAPTURE_END:
+            stream->pos += 4;
+            return CAPTURE_EV_END;
+
+        default:
+            return CAPTURE_EV_ERROR;
+    }
+}
+
+/* File position of the next event */
+off_t capture_tell(const capture_stream_t *stream)
+{
+    return stream->offset + (off_t)stream->pos;
+}
@@ -0,0 +1,80 @@
+/*
+ * File:   capture.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:53
+ *
+ * Raw tape capture files (.tcap).
+ *
+ *   Header, 16 bytes, little endian:
+ *     0  char     magic[4]    "TCAP"
+ *     4  uint16   version     CAPTURE_VERSION
+ *     6  uint16   flags       reserved, 0
+ *     8  uint32   sample_hz   rate the intervals are counted at
+ *    12  uint32   reserved    0
+ *
+ *   Body: little endian 16 bit words. A non-zero word is the time from
+ *   one flux transition to the next in sample ticks. Zero escapes to a
+ *   code word, some followed by arguments:
+ *
+ *     0 CAPTURE_TRACK n        a track starts; every interval up to the
+ *                              next CAPTURE_END belongs to track n
+ *     0 CAPTURE_TACH           a tach pulse from the drive
+ *     0 CAPTURE_LONG lo hi     an interval too long for 16 bits
+ *     0 CAPTURE_END            the track ends
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define CAPTURE_MAGIC           "TCAP"
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_SIZE     16
+
+#define CAPTURE_TRACK           0x0001
+#define CAPTURE_TACH            0x0002
+#define CAPTURE_LONG            0x0003
+#define CAPTURE_END             0x0004
+
+// Events returned by capture_next()
+#define CAPTURE_EV_EOF          0
+#define CAPTURE_EV_INTERVAL     1
+#define CAPTURE_EV_TRACK        2
+#define CAPTURE_EV_TACH         3
+#define CAPTURE_EV_END          4
+#define CAPTURE_EV_ERROR        -1
+
+#define CAPTURE_BUFFER          65536
+
+typedef struct {
+    uint16_t version;
+    uint16_t flags;
+    uint32_t sample_hz;
+} capture_header_t;
+
+/*
+ * Reads events from a byte range of an open capture with pread(), so
+ * any number of streams can share one fd. Memory use is the fixed
+ * buffer whatever the size of the range.
+ */
+typedef struct {
+    int fd;
+    off_t offset;           /* file position of buf[0] */
+    off_t end;
+    size_t pos;             /* next byte in buf */
+    size_t len;
+    uint8_t buf[CAPTURE_BUFFER];
+} capture_stream_t;
+
+int capture_read_header(int fd, capture_header_t *header);
+void capture_write_header(uint8_t *out, const capture_header_t *header);
+void capture_stream_init(capture_stream_t *stream, int fd, off_t start, off_t end);
+int capture_next(capture_stream_t *stream, uint32_t *value);
+off_t capture_tell(const capture_stream_t *stream);
+
+#endif /* __CAPTURE_H__ */
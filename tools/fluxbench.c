@@ -0,0 +1,475 @@
+/*
+ * File:   fluxbench.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:06
+ *
+ * Runs every GCR decoder (gcr_methods[] in gcr.c) over a fixed set of
+ * synthetic flux scenarios and reports, per scenario and decoder:
+ *
+ *   - blocks recovered with a good CRC and the right contents
+ *   - the block error rate, and CRC-good blocks with the wrong contents
+ *   - decode throughput in MB/s of user data
+ *
+ * Scenarios are generated from fixed seeds, so the block counts only
+ * change when a decoder or the generator does. Compared against a
+ * baseline file (-b), fewer recovered blocks than the baseline is a
+ * regression and fails the run. Throughput depends on the machine, so
+ * a drop of more than THROUGHPUT_SLACK is only reported unless -s is
+ * given. -w writes the current results as the new baseline.
+ *
+ * With -i the decoders are run over a .tcap capture instead, and the
+ * blocks each finds with a good CRC are counted per track.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "gcr.h"
+#include "fluxsim.h"
+
+#define MIN_SECONDS         0.2     /* each decoder is timed over at least this long */
+#define THROUGHPUT_SLACK    0.25
+#define MAX_RESULTS         64
+
+typedef struct {
+    const char *name;
+    double drift;
+    double wow;
+    double jitter;
+    double shift;
+    double dropout_rate;
+} scenario_t;
+
+typedef struct {
+    char scenario[32];
+    char decoder[32];
+    uint32_t good;
+    uint32_t blocks;
+    double mb_per_s;
+} result_t;
+
+typedef struct {
+    uint32_t *intervals;
+    size_t count;
+    size_t room;
+} stream_t;
+
+typedef struct {
+    const fluxsim_t *sim;
+    uint8_t *seen;
+    uint32_t good;
+    uint32_t wrong;             /* good CRC, wrong contents */
+} tally_t;
+
+// Each fault on its own, then together
+static const scenario_t _g_scenarios[] = {
+    { "clean",      0,      0,      0,      0,      0 },
+    { "drift",      -0.15,  0,      0,      0,      0 },
+    { "wow",        0,      0.15,   0,      0,      0 },
+    { "jitter",     0,      0,      0.08,   0,      0 },
+    { "shift",      0,      0,      0,      0.30,   0 },
+    { "dropout",    0,      0,      0,      0,      0.10 },
+    { "combined",   -0.08,  0.05,   0.06,   0.10,   0.05 },
+};
+
+static result_t _g_results[MAX_RESULTS];
+static size_t _g_result_count;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int collect(void *ctx, int event, uint32_t value)
+{
+    stream_t *stream = ctx;
+
+    if (event != CAPTURE_EV_INTERVAL)
+        return 0;
+
+    if (stream->count == stream->room)
+    {
+        size_t room = stream->room ? stream->room * 2 : 1 << 20;
+        uint32_t *p = realloc(stream->intervals, room * sizeof(uint32_t));
+
+        if (!p)
+            return -1;
+
+        stream->intervals = p;
+        stream->room = room;
+    }
+
+    stream->intervals[stream->count++] = value;
+    return 0;
+}
+
+static void check_block(void *ctx, const gcr_block_t *block, bool crc_ok)
+{
+    tally_t *tally = ctx;
+    gcr_block_t expect;
+
+    if (!crc_ok || block->number >= tally->sim->blocks)
+        return;
+
+    fluxsim_fill(tally->sim, block->number, &expect);
+
+    if (block->track != expect.track || memcmp(block->data, expect.data, GCR_DATA_BYTES))
+    {
+        tally->wrong++;
+        return;
+    }
+
+    if (!tally->seen[block->number])
+    {
+        tally->seen[block->number] = 1;
+        tally->good++;
+    }
+}
+
+static void count_block(void *ctx, const gcr_block_t *block, bool crc_ok)
+{
+    (void)block;
+
+    if (crc_ok)
+        (*(uint64_t *)ctx)++;
+}
+
+static const result_t *find_baseline(const result_t *baseline, size_t count, const char *scenario, const char *decoder)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!strcmp(baseline[i].scenario, scenario) && !strcmp(baseline[i].decoder, decoder))
+            return &baseline[i];
+    }
+
+    return NULL;
+}
+
+static int load_baseline(const char *path, result_t *baseline)
+{
+    char line[256];
+    int count = 0;
+    FILE *fp = fopen(path, "r");
+
+    if (!fp)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp) && count < MAX_RESULTS)
+    {
+        result_t *r = &baseline[count];
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        if (sscanf(line, "%31s %31s %u %u %lf", r->scenario, r->decoder, &r->good, &r->blocks, &r->mb_per_s) == 5)
+            count++;
+    }
+
+    fclose(fp);
+
+    return count;
+}
+
+static int save_baseline(const char *path)
+{
+    size_t i;
+    FILE *fp = fopen(path, "w");
+
+    if (!fp)
+        return -1;
+
+    fprintf(fp, "# fluxbench baseline, rewrite with 'make bench-baseline'\n");
+    fprintf(fp, "# scenario decoder good blocks mb_per_s\n");
+
+    for (i = 0; i < _g_result_count; i++)
+    {
+        const result_t *r = &_g_results[i];
+        fprintf(fp, "%s %s %u %u %.1f\n", r->scenario, r->decoder, r->good, r->blocks, r->mb_per_s);
+    }
+
+    return fclose(fp);
+}
+
+static int run_scenarios(uint32_t blocks, const result_t *baseline, int baseline_count, bool strict)
+{
+    size_t s;
+    size_t m;
+    int failed = 0;
+
+    printf("%-10s %-10s %11s %7s %6s %8s %8s  %s\n",
+        "scenario", "decoder", "good/blocks", "err%", "wrong", "crc_err", "MB/s", "baseline");
+
+    for (s = 0; s < sizeof(_g_scenarios) / sizeof(_g_scenarios[0]); s++)
+    {
+        const scenario_t *sc = &_g_scenarios[s];
+        fluxsim_t sim;
+        stream_t stream;
+
+        fluxsim_defaults(&sim);
+        sim.blocks = blocks;
+        sim.seed = (uint32_t)s + 1;
+        sim.drift = sc->drift;
+        sim.wow = sc->wow;
+        sim.jitter = sc->jitter;
+        sim.shift = sc->shift;
+        sim.dropout_rate = sc->dropout_rate;
+
+        memset(&stream, 0, sizeof(stream));
+
+        if (fluxsim_run(&sim, collect, &stream) < 0)
+        {
+            perror("fluxbench: generating flux");
+            return -1;
+        }
+
+        for (m = 0; m < gcr_method_count && _g_result_count < MAX_RESULTS; m++)
+        {
+            result_t *r = &_g_results[_g_result_count++];
+            const result_t *base;
+            gcr_decoder_t decoder;
+            tally_t tally;
+            uint64_t crc_errors = 0;
+            double start;
+            double elapsed;
+            uint32_t runs = 0;
+            char verdict[64] = "-";
+            size_t i;
+
+            memset(&tally, 0, sizeof(tally));
+            tally.sim = &sim;
+            tally.seen = calloc(blocks, 1);
+
+            if (!tally.seen)
+                return -1;
+
+            start = now();
+
+            do
+            {
+                gcr_decoder_init(&decoder, &gcr_methods[m], fluxsim_cell_ticks(&sim), check_block, &tally);
+
+                for (i = 0; i < stream.count; i++)
+                    gcr_decode(&decoder, stream.intervals[i]);
+
+                // Every run decodes the same blocks, so the first run's counts stand
+                if (!runs)
+                    crc_errors = decoder.crc_errors;
+
+                runs++;
+                elapsed = now() - start;
+            } while (elapsed < MIN_SECONDS);
+
+            snprintf(r->scenario, sizeof(r->scenario), "%s", sc->name);
+            snprintf(r->decoder, sizeof(r->decoder), "%s", gcr_methods[m].name);
+            r->good = tally.good;
+            r->blocks = blocks;
+            r->mb_per_s = (double)blocks * GCR_DATA_BYTES * runs / elapsed / 1e6;
+
+            base = baseline_count > 0 ? find_baseline(baseline, (size_t)baseline_count, r->scenario, r->decoder) : NULL;
+
+            if (base && (r->good < base->good || r->blocks != base->blocks))
+            {
+                snprintf(verdict, sizeof(verdict), "REGRESSED, was %u", base->good);
+                failed++;
+            }
+            else if (base && r->mb_per_s < base->mb_per_s * (1 - THROUGHPUT_SLACK))
+            {
+                snprintf(verdict, sizeof(verdict), "%s, was %.1f MB/s", strict ? "SLOWER" : "slower", base->mb_per_s);
+
+                if (strict)
+                    failed++;
+            }
+            else if (base && r->good > base->good)
+            {
+                snprintf(verdict, sizeof(verdict), "better, was %u", base->good);
+            }
+            else if (base)
+            {
+                snprintf(verdict, sizeof(verdict), "ok");
+            }
+            else if (baseline_count >= 0)
+            {
+                snprintf(verdict, sizeof(verdict), "new");
+            }
+
+            printf("%-10s %-10s %5u/%-5u %7.2f %6u %8llu %8.1f  %s\n", r->scenario, r->decoder,
+                r->good, blocks, 100.0 * (blocks - r->good) / blocks, tally.wrong / runs,
+                (unsigned long long)crc_errors, r->mb_per_s, verdict);
+
+            free(tally.seen);
+        }
+
+        free(stream.intervals);
+    }
+
+    return failed;
+}
+
+/* Every decoder over every track of a real capture */
+static int run_capture(const char *path, uint32_t bit_hz)
+{
+    capture_header_t header;
+    static capture_stream_t stream;
+    gcr_decoder_t decoders[8];
+    uint64_t found[8];
+    uint32_t value;
+    size_t count = gcr_method_count < 8 ? gcr_method_count : 8;
+    size_t m;
+    int track = -1;
+    int event;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0 || capture_read_header(fd, &header) < 0)
+    {
+        fprintf(stderr, "fluxbench: %s: not a capture\n", path);
+        return -1;
+    }
+
+    capture_stream_init(&stream, fd, CAPTURE_HEADER_SIZE, lseek(fd, 0, SEEK_END));
+    printf("track,decoder,blocks,crc_errors,bad_codes,markers\n");
+
+    while ((event = capture_next(&stream, &value)) > CAPTURE_EV_EOF)
+    {
+        if (event == CAPTURE_EV_TRACK)
+        {
+            track = (int)value;
+
+            for (m = 0; m < count; m++)
+            {
+                found[m] = 0;
+                gcr_decoder_init(&decoders[m], &gcr_methods[m], (double)header.sample_hz / bit_hz,
+                    count_block, &found[m]);
+            }
+        }
+        else if (event == CAPTURE_EV_INTERVAL && track >= 0)
+        {
+            for (m = 0; m < count; m++)
+                gcr_decode(&decoders[m], value);
+        }
+        else if (event == CAPTURE_EV_END && track >= 0)
+        {
+            for (m = 0; m < count; m++)
+            {
+                printf("%d,%s,%llu,%llu,%llu,%llu\n", track, gcr_methods[m].name,
+                    (unsigned long long)found[m], (unsigned long long)decoders[m].crc_errors,
+                    (unsigned long long)decoders[m].bad_codes, (unsigned long long)decoders[m].markers);
+            }
+
+            track = -1;
+        }
+    }
+
+    close(fd);
+
+    return event == CAPTURE_EV_ERROR ? -1 : 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: fluxbench [-n blocks] [-b baseline] [-w] [-s]\n"
+        "       fluxbench -i capture.tcap [-c cells_per_s]\n"
+        "\t-n\tblocks per scenario, default 200\n"
+        "\t-b\tcompare with this baseline file\n"
+        "\t-w\twrite the results to the -b file instead of comparing\n"
+        "\t-s\tfail on a throughput drop too, not only on lost blocks\n"
+        "\t-i\tdecode a capture rather than the built in scenarios\n"
+        "\t-c\tcell rate for -i, default 900000\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static result_t baseline[MAX_RESULTS];
+    const char *baseline_path = NULL;
+    const char *capture = NULL;
+    uint32_t blocks = 200;
+    uint32_t bit_hz = 900000;
+    bool write = false;
+    bool strict = false;
+    int baseline_count = -1;
+    int failed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:wsi:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                blocks = (uint32_t)atol(optarg);
+                break;
+            case 'b':
+                baseline_path = optarg;
+                break;
+            case 'w':
+                write = true;
+                break;
+            case 's':
+                strict = true;
+                break;
+            case 'i':
+                capture = optarg;
+                break;
+            case 'c':
+                bit_hz = (uint32_t)atol(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind != argc || !blocks || blocks > 65536 || !bit_hz || (write && !baseline_path))
+        usage();
+
+    if (capture)
+        return run_capture(capture, bit_hz) < 0 ? 1 : 0;
+
+    if (baseline_path && !write)
+    {
+        baseline_count = load_baseline(baseline_path, baseline);
+
+        if (baseline_count < 0)
+        {
+            fprintf(stderr, "fluxbench: %s: %s\n", baseline_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    failed = run_scenarios(blocks, baseline, baseline_count, strict);
+
+    if (failed < 0)
+        return 1;
+
+    if (write)
+    {
+        if (save_baseline(baseline_path) != 0)
+        {
+            fprintf(stderr, "fluxbench: %s: %s\n", baseline_path, strerror(errno));
+            return 1;
+        }
+
+        fprintf(stderr, "fluxbench: baseline written to %s\n", baseline_path);
+    }
+    else if (failed)
+    {
+        fprintf(stderr, "fluxbench: %d regressions against %s\n", failed, baseline_path);
+    }
+
+    return failed ? 1 : 0;
+}
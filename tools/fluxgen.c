@@ -0,0 +1,152 @@
+/*
+ * File:   fluxgen.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:06
+ *
+ * Writes a synthetic track of GCR blocks as a .tcap capture, with the
+ * speed drift, wow, jitter, peak shift and dropouts asked for (see
+ * fluxsim.h). The output reads like a capture from the drive, so the
+ * other host tools take it as they would a real one.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "gcr.h"
+#include "fluxsim.h"
+
+static FILE *_g_out;
+
+static int put_word(uint16_t word)
+{
+    uint8_t bytes[2] = { (uint8_t)word, (uint8_t)(word >> 8) };
+
+    return fwrite(bytes, 1, 2, _g_out) == 2 ? 0 : -1;
+}
+
+static int write_event(void *ctx, int event, uint32_t value)
+{
+    (void)ctx;
+
+    if (event == CAPTURE_EV_TACH)
+        return (put_word(0) < 0 || put_word(CAPTURE_TACH) < 0) ? -1 : 0;
+
+    if (value <= 0xFFFF)
+        return put_word((uint16_t)value);
+
+    if (put_word(0) < 0 || put_word(CAPTURE_LONG) < 0 ||
+            put_word((uint16_t)value) < 0 || put_word((uint16_t)(value >> 16)) < 0)
+        return -1;
+
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: fluxgen [options] out.tcap\n"
+        "\t-n\tblocks, default 100\n"
+        "\t-t\ttrack, default 0\n"
+        "\t-s\tseed, default 1\n"
+        "\t-r\tsample rate in Hz, default 40000000\n"
+        "\t-b\tcells per second, default 900000\n"
+        "\t-d\tspeed drift over the track, %% (may be negative)\n"
+        "\t-w\twow, %% of speed\n"
+        "\t-f\twow frequency in Hz, default 2\n"
+        "\t-j\tjitter, rms %% of a cell\n"
+        "\t-x\tpeak shift, %% of a cell at most\n"
+        "\t-p\tdropout chance per block, %%\n"
+        "\t-l\tdropout length in cells, default 40\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    fluxsim_t sim;
+    capture_header_t header;
+    uint8_t head[CAPTURE_HEADER_SIZE];
+    int opt;
+
+    fluxsim_defaults(&sim);
+
+    while ((opt = getopt(argc, argv, "n:t:s:r:b:d:w:f:j:x:p:l:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                sim.blocks = (uint32_t)atol(optarg);
+                break;
+            case 't':
+                sim.track = (unsigned int)atoi(optarg);
+                break;
+            case 's':
+                sim.seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                sim.sample_hz = (uint32_t)atol(optarg);
+                break;
+            case 'b':
+                sim.bit_hz = (uint32_t)atol(optarg);
+                break;
+            case 'd':
+                sim.drift = atof(optarg) / 100;
+                break;
+            case 'w':
+                sim.wow = atof(optarg) / 100;
+                break;
+            case 'f':
+                sim.wow_hz = atof(optarg);
+                break;
+            case 'j':
+                sim.jitter = atof(optarg) / 100;
+                break;
+            case 'x':
+                sim.shift = atof(optarg) / 100;
+                break;
+            case 'p':
+                sim.dropout_rate = atof(optarg) / 100;
+                break;
+            case 'l':
+                sim.dropout_cells = (uint32_t)atol(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind != argc - 1 || !sim.sample_hz || !sim.bit_hz || sim.blocks > 65536 ||
+            sim.dropout_cells >= GCR_BLOCK_CELLS)
+        usage();
+
+    _g_out = fopen(argv[optind], "wb");
+    if (!_g_out)
+    {
+        fprintf(stderr, "fluxgen: %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.version = CAPTURE_VERSION;
+    header.sample_hz = sim.sample_hz;
+    capture_write_header(head, &header);
+
+    if (fwrite(head, 1, sizeof(head), _g_out) != sizeof(head) ||
+            put_word(0) < 0 || put_word(CAPTURE_TRACK) < 0 || put_word((uint16_t)sim.track) < 0 ||
+            fluxsim_run(&sim, write_event, NULL) < 0 ||
+            put_word(0) < 0 || put_word(CAPTURE_END) < 0 || fclose(_g_out) != 0)
+    {
+        fprintf(stderr, "fluxgen: %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * File:   fluxsim.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:06
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "capture.h"
+#include "gcr.h"
+#include "fluxsim.h"
+
+typedef struct {
+    const fluxsim_t *sim;
+    fluxsim_sink_fn sink;
+    void *ctx;
+    uint64_t rng;
+    double cell_ticks;
+
+    // The last transition is held back until the next one is known
+    bool have_current;
+    uint64_t previous_cell;
+    uint64_t current_cell;
+    double current_time;
+    int64_t emitted;            /* tick of the last transition sent */
+    uint64_t next_tach;
+} sim_state_t;
+
+void fluxsim_defaults(fluxsim_t *sim)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->sample_hz = 40000000;
+    sim->bit_hz = 900000;       /* QIC-24 at 90 ips */
+    sim->blocks = 100;
+    sim->seed = 1;
+    sim->wow_hz = 2.0;
+    sim->dropout_cells = 40;
+}
+
+double fluxsim_cell_ticks(const fluxsim_t *sim)
+{
+    return (double)sim->sample_hz / sim->bit_hz;
+}
+
+/* xorshift64*, so a seed gives the same stream on any host */
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+static double uniform(uint64_t *state)
+{
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(uint64_t *state)
+{
+    double u = uniform(state);
+    double v = uniform(state);
+
+    return sqrt(-2 * log(u + 1e-300)) * cos(2 * M_PI * v);
+}
+
+/* The contents a decoder should find in block 'number' */
+void fluxsim_fill(const fluxsim_t *sim, uint16_t number, gcr_block_t *block)
+{
+    uint64_t state = ((uint64_t)sim->seed << 32) ^ ((uint64_t)sim->track << 16) ^ number ^ 0x9E3779B97F4A7C15ull;
+    size_t i;
+
+    block->track = (uint8_t)sim->track;
+    block->control = 0;
+    block->number = number;
+
+    for (i = 0; i < GCR_DATA_BYTES; i++)
+        block->data[i] = (uint8_t)(next_random(&state) >> 56);
+}
+
+/* Sends the held transition, now that its neighbours are known */
+static int emit(sim_state_t *st, uint64_t next_cell)
+{
+    const fluxsim_t *sim = st->sim;
+    double t = st->current_time;
+    int64_t tick;
+    int result;
+
+    if (sim->shift > 0 && st->previous_cell < st->current_cell)
+    {
+        double before = (double)(st->current_cell - st->previous_cell);
+        double after = (double)(next_cell - st->current_cell);
+
+        t += sim->shift * st->cell_ticks * (after - before) / (after + before);
+    }
+
+    if (sim->jitter > 0)
+        t += gaussian(&st->rng) * sim->jitter * st->cell_ticks;
+
+    while (st->next_tach <= st->current_cell)
+    {
+        result = st->sink(st->ctx, CAPTURE_EV_TACH, 0);
+        if (result < 0)
+            return result;
+
+        st->next_tach += FLUXSIM_TACH_CELLS;
+    }
+
+    tick = llround(t);
+
+    // Noise can not put a transition before the one it follows
+    if (tick <= st->emitted)
+        tick = st->emitted + 1;
+
+    result = st->sink(st->ctx, CAPTURE_EV_INTERVAL, (uint32_t)(tick - st->emitted));
+    st->emitted = tick;
+
+    return result;
+}
+
+int fluxsim_run(const fluxsim_t *sim, fluxsim_sink_fn sink, void *ctx)
+{
+    static uint8_t cells[GCR_BLOCK_CELLS];
+    sim_state_t st;
+    gcr_block_t block;
+    uint64_t total = (uint64_t)sim->blocks * GCR_BLOCK_CELLS;
+    uint64_t cell = 0;
+    double time = 0;
+    uint32_t b;
+
+    memset(&st, 0, sizeof(st));
+    st.sim = sim;
+    st.sink = sink;
+    st.ctx = ctx;
+    st.rng = ((uint64_t)sim->seed << 1) | 1;
+    st.cell_ticks = fluxsim_cell_ticks(sim);
+    st.next_tach = FLUXSIM_TACH_CELLS;
+
+    for (b = 0; b < sim->blocks; b++)
+    {
+        size_t n;
+        size_t i;
+        size_t drop_from = GCR_BLOCK_CELLS;
+        size_t drop_to = GCR_BLOCK_CELLS;
+
+        fluxsim_fill(sim, (uint16_t)b, &block);
+        n = gcr_encode(&block, cells);
+
+        if (sim->dropout_rate > 0 && uniform(&st.rng) < sim->dropout_rate)
+        {
+            drop_from = (size_t)(uniform(&st.rng) * (n - sim->dropout_cells));
+            drop_to = drop_from + sim->dropout_cells;
+        }
+
+        for (i = 0; i < n; i++, cell++)
+        {
+            double speed = 1 + sim->drift * cell / total;
+
+            if (sim->wow > 0)
+                speed += sim->wow * sin(2 * M_PI * sim->wow_hz * time / sim->sample_hz);
+
+            time += st.cell_ticks / speed;
+
+            if (!cells[i] || (i >= drop_from && i < drop_to))
+                continue;
+
+            if (st.have_current && emit(&st, cell) < 0)
+                return -1;
+
+            st.previous_cell = st.have_current ? st.current_cell : cell;
+            st.current_cell = cell;
+            st.current_time = time;
+            st.have_current = true;
+        }
+    }
+
+    if (st.have_current && emit(&st, st.current_cell + 1) < 0)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * File:   fluxsim.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:06
+ *
+ * Synthetic flux for a track of GCR blocks (see gcr.h), with the faults
+ * real tape adds. The same parameters and seed always give the same
+ * intervals, so decoders can be compared and tuned on equal terms.
+ *
+ *   drift      speed change from the first block to the last
+ *   wow        sinusoidal speed variation at wow_hz
+ *   jitter     gaussian timing noise on each transition
+ *   shift      peak shift: a transition moves away from a close
+ *              neighbour, most when one gap is a cell and the other
+ *              is three
+ *   dropouts   a run of transitions lost, at most one per block
+ *
+ * Fractions are of speed, or of a cell for jitter and shift.
+ */
+
+#ifndef __FLUXSIM_H__
+#define __FLUXSIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gcr.h"
+
+#define FLUXSIM_TACH_CELLS      8192    /* tape length per tach pulse */
+
+typedef struct {
+    uint32_t sample_hz;
+    uint32_t bit_hz;            /* cells per second at nominal speed */
+    unsigned int track;
+    uint32_t blocks;
+    uint32_t seed;
+    double drift;
+    double wow;
+    double wow_hz;
+    double jitter;
+    double shift;
+    double dropout_rate;        /* chance per block */
+    uint32_t dropout_cells;
+} fluxsim_t;
+
+// Gets CAPTURE_EV_INTERVAL and CAPTURE_EV_TACH events in tape order
+typedef int (*fluxsim_sink_fn)(void *ctx, int event, uint32_t value);
+
+void fluxsim_defaults(fluxsim_t *sim);
+double fluxsim_cell_ticks(const fluxsim_t *sim);
+void fluxsim_fill(const fluxsim_t *sim, uint16_t number, gcr_block_t *block);
+int fluxsim_run(const fluxsim_t *sim, fluxsim_sink_fn sink, void *ctx);
+
+#endif /* __FLUXSIM_H__ */
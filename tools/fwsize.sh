@@ -0,0 +1,396 @@
+#!/bin/sh
+#
+# Firmware size report against the PIC18F4320 budget: 8 KB of program
+# memory and 512 bytes of data memory. Run from tools/ ('make size').
+#
+# XC8 is not needed. Every firmware source is built twice with the host
+# compiler against pic/xc.h: once at -Os for the code and constant data
+# sizes, and once at -O0 with debug information for the RAM
+# model. The RAM model follows XC8's compiled stack: each function owns
+# its parameters and autos, and only functions on one call path are live
+# together. Sizes use the PIC18 widths (int 16 bits, pointers 16 bits,
+# structures unpadded). main() and both interrupt handlers are separate
+# roots; the low priority handler can be interrupted by the high one, so
+# all three paths add up.
+#
+# Program memory is estimated as code * CODE_FACTOR / 100 plus the
+# constant data (tables and strings), which is stored byte for byte.
+# XC8 leaves out functions that are never called, so the objects are
+# linked with unused sections collected and only what is left counts.
+# CODE_FACTOR is calibrated on the original firmware, which fitted the
+# part with XC8's printf (roughly 1 KB) linked in: 90 is the largest
+# factor that still lets it fit, so the estimate errs on the large side.
+# Library routines (memcpy, strtok, ...) are not counted, so LIB_RESERVE
+# is set aside for them. When an XC8 build is available its memory
+# summary is the authority; this report is for catching growth.
+#
+# FWFLAGS passes extra definitions, e.g. FWFLAGS=-DFEATURE_SWEEP=1 to
+# price a feature. -f prices every FEATURE_xxx in project.h on its own
+# against the build as configured. -b estimates each named build in
+# nbproject/configurations.xml; xc8size.sh links the same builds with
+# XC8. Exits non-zero when either estimate is over budget.
+
+CC=${CC:-cc}
+FLASH_BUDGET=${FLASH_BUDGET:-8192}
+RAM_BUDGET=${RAM_BUDGET:-512}
+RAM_RESERVE=${RAM_RESERVE:-16}        # XC8 temporaries and interrupt context saves
+CODE_FACTOR=${CODE_FACTOR:-90}        # PIC18 bytes per 100 bytes of i386 code
+LIB_RESERVE=${LIB_RESERVE:-512}       # XC8 library routines
+SRC=${SRC:-..}
+VERBOSE=0
+FEATURES=0
+BUILDS=0
+
+while getopts "vfb" opt
+do
+    case $opt in
+        v) VERBOSE=1 ;;
+        f) FEATURES=1 ;;
+        b) BUILDS=1 ;;
+        *) echo "usage: $0 [-v] [-f | -b]" >&2; exit 2 ;;
+    esac
+done
+
+# Program and data memory estimates for one set of flags
+totals()
+{
+    FWFLAGS="$1" "$0" | awk '
+        /^Program memory:/  { flash = $3 }
+        /^Data memory:/     { ram = $3 }
+        END { print flash + 0, ram + 0 }'
+}
+
+if [ $FEATURES = 1 ]
+then
+    set -- $(totals "$FWFLAGS")
+    printf "%-20s %6s %6s\n" "feature" "flash" "ram"
+    printf "%-20s %6d %6d\n" "(as configured)" $1 $2
+    base_flash=$1
+    base_ram=$2
+
+    for feature in $(sed -n 's/^#ifndef \(FEATURE_[A-Z_]*\).*/\1/p' "$SRC/project.h")
+    do
+        [ $feature = FEATURE_ALL ] && continue
+        set -- $(totals "$FWFLAGS -D$feature=1")
+        printf "%-20s %+6d %+6d\n" $feature $(($1 - base_flash)) $(($2 - base_ram))
+    done
+
+    set -- $(totals "$FWFLAGS -DFEATURE_ALL=1")
+    printf "%-20s %6d %6d\n" "FEATURE_ALL" $1 $2
+    exit 0
+fi
+
+if [ $BUILDS = 1 ]
+then
+    over=0
+    printf "%-24s %6s %6s  (estimate)\n" "build" "flash" "ram"
+    awk '
+        /<conf name=/ { split($0, a, "\""); conf = a[2] }
+        /key="define-macros"/ && conf != "" {
+            split($0, a, "\"")
+            print conf, a[4]
+            conf = ""
+        }' "$SRC/nbproject/configurations.xml" > "${TMPDIR:-/tmp}/fwsize.$$"
+
+    while read -r name macros
+    do
+        defines=$(echo "$macros" | tr ';' '\n' | sed -n 's/^./-D&/p')
+        set -- $(totals "$FWFLAGS $defines")
+        printf "%-24s %6d %6d\n" "$name" $1 $2
+        [ $1 -gt $FLASH_BUDGET ] || [ $2 -gt $RAM_BUDGET ] && over=1
+    done < "${TMPDIR:-/tmp}/fwsize.$$"
+
+    rm -f "${TMPDIR:-/tmp}/fwsize.$$"
+    exit $over
+fi
+
+TMP=$(mktemp -d) || exit 2
+trap 'rm -rf "$TMP"' EXIT
+
+CFLAGS="-m32 -ffreestanding -fno-pic -fno-common -fno-asynchronous-unwind-tables \
+    -Wno-unknown-pragmas -Ipic -isystem pic/libc $FWFLAGS"
+
+for src in "$SRC"/*.c
+do
+    base=$(basename "$src" .c)
+
+    $CC $CFLAGS -Os -ffunction-sections -fdata-sections -c "$src" -o "$TMP/$base.os" || exit 2
+    $CC $CFLAGS -O0 -g -fcallgraph-info -dumpdir "$TMP/" -c "$src" -o "$TMP/$base.o" || exit 2
+
+    # Section sizes: code, and constant tables and strings
+    echo "M $base" >> "$TMP/model"
+    size -A "$TMP/$base.os" | awk -v module="$base" '
+        $1 ~ /^\.(text|rodata)/ { printf "X %s %s %d\n", module, $1, $2 }' >> "$TMP/model"
+
+    # Call edges between functions
+    awk '/^edge:/ {
+        split($0, f, "\"")
+        printf "E %s %s\n", f[2], f[4] }' "$TMP/$base.ci" >> "$TMP/model"
+
+    # Frames and statics from the debug information
+    readelf --debug-dump=info "$TMP/$base.o" | awk -v file="$src" -v module="$base" '
+        function value(line) { sub(/.*: /, "", line); return line }
+        function ref(line) { sub(/.*<0x/, "", line); sub(/>.*/, "", line); return line }
+
+        function size(off,    t, n, total, c) {
+            if (off == "")
+                return 0
+            t = tag[off]
+            if (t == "typedef")
+                return (name[off] ~ /^u?int32_t$/) ? 4 : size(type[off])
+            if (t == "const_type" || t == "volatile_type")
+                return size(type[off])
+            if (t == "pointer_type")
+                return 2
+            if (t == "enumeration_type")
+                return 2
+            if (t == "base_type")
+            {
+                if (name[off] == "int" || name[off] == "unsigned int")
+                    return 2
+                return bytes[off]
+            }
+            if (t == "array_type")
+            {
+                n = 1
+                for (c = first[off]; c != ""; c = next_sibling[c])
+                    if (tag[c] == "subrange_type")
+                        n *= (count[c] != "") ? count[c] : upper[c] + 1
+                return n * size(type[off])
+            }
+            if (t == "structure_type" || t == "union_type")
+            {
+                total = 0
+                for (c = first[off]; c != ""; c = next_sibling[c])
+                {
+                    if (tag[c] != "member")
+                        continue
+                    if (bitfield[c])
+                        return bytes[off]
+                    n = size(type[c])
+                    if (t == "structure_type")
+                        total += n
+                    else if (n > total)
+                        total = n
+                }
+                return total
+            }
+            return bytes[off]
+        }
+
+        function is_const(off) {
+            while (off != "")
+            {
+                if (tag[off] == "const_type")
+                    return 1
+                if (tag[off] != "typedef" && tag[off] != "array_type" && tag[off] != "volatile_type")
+                    return 0
+                off = type[off]
+            }
+            return 0
+        }
+
+        function key(off) {
+            return external[off] ? name[off] : file ":" name[off]
+        }
+
+        /^ <[0-9]+><[0-9a-f]+>: Abbrev Number: 0/ { next }
+
+        /^ <[0-9]+><[0-9a-f]+>:/ {
+            split($1, p, /[<>]/)
+            depth = p[2]; cur = p[4]
+            t = $0; sub(/.*\(DW_TAG_/, "", t); sub(/\).*/, "", t)
+            tag[cur] = t
+            order[++count_dies] = cur
+            level[cur] = depth
+            parent[cur] = (depth > 0) ? open[depth - 1] : ""
+            if (last[depth] != "" && parent[last[depth]] == parent[cur])
+                next_sibling[last[depth]] = cur
+            else if (parent[cur] != "" && first[parent[cur]] == "")
+                first[parent[cur]] = cur
+            open[depth] = cur
+            last[depth] = cur
+            delete last[depth + 1]
+            next
+        }
+        /DW_AT_name /           { name[cur] = value($0) }
+        /DW_AT_byte_size /      { bytes[cur] = value($0) + 0 }
+        /DW_AT_bit_size /       { bitfield[cur] = 1 }
+        /DW_AT_type /           { type[cur] = ref($0) }
+        /DW_AT_upper_bound /    { upper[cur] = value($0) + 0 }
+        /DW_AT_count /          { count[cur] = value($0) + 0 }
+        /DW_AT_location /       { if ($0 ~ /DW_OP_addr/) fixed[cur] = 1 }
+        /DW_AT_declaration /    { declaration[cur] = 1 }
+        /DW_AT_external /       { external[cur] = 1 }
+        /DW_AT_low_pc /         { code[cur] = 1 }
+        /DW_AT_specification/   { spec[cur] = ref($0) }
+
+        END {
+            for (i = 1; i <= count_dies; i++)
+            {
+                off = order[i]
+
+                if (tag[off] == "subprogram" && code[off])
+                {
+                    func = off
+                    frame[func] = 0
+                    continue
+                }
+
+                if (tag[off] != "variable" && tag[off] != "formal_parameter")
+                    continue
+                if (declaration[off])
+                    continue
+
+                if (fixed[off])
+                {
+                    s = (spec[off] != "") ? spec[off] : off
+                    if (type[off] == "")
+                        type[off] = type[s]
+                    if (name[off] == "")
+                        name[off] = name[s]
+                    if (!is_const(type[off]))
+                        printf "S %s:%s %d\n", module, name[off], size(type[off])
+                    continue
+                }
+
+                # An auto or parameter of the innermost enclosing function
+                for (up = parent[off]; up != "" && tag[up] != "subprogram"; up = parent[up])
+                    ;
+                if (up != "" && code[up])
+                    frame[up] += size(type[off])
+            }
+
+            for (f in frame)
+                printf "F %s %d\n", key(f), frame[f]
+        }' >> "$TMP/model"
+done
+
+# Sections nothing reachable from main() or the interrupt handlers uses
+$CC -m32 -nostdlib -static -no-pie -Wl,--gc-sections -Wl,--print-gc-sections \
+    -Wl,-e,main -Wl,-u,interrupt_handler_high -Wl,-u,interrupt_handler_low \
+    -Wl,--unresolved-symbols=ignore-all "$TMP"/*.os -o "$TMP/fw.elf" 2>&1 |
+    sed -n "s/.*removing unused section '\([^']*\)' in file '.*\/\([^/]*\)\.os'.*/G \2 \1/p" >> "$TMP/model"
+
+awk -v verbose=$VERBOSE -v flash_budget=$FLASH_BUDGET -v ram_budget=$RAM_BUDGET \
+    -v ram_reserve=$RAM_RESERVE -v code_factor=$CODE_FACTOR -v lib_reserve=$LIB_RESERVE '
+    function deepest(f,    i, n, d, best, callee) {
+        if (f in memo)
+            return memo[f]
+        if (f in visiting)
+        {
+            recursion = recursion " " f
+            return 0
+        }
+        visiting[f] = 1
+        best = 0
+        n = calls[f]
+        for (i = 1; i <= n; i++)
+        {
+            callee = callee_of[f, i]
+            d = deepest(callee)
+            if (d > best)
+            {
+                best = d
+                via[f] = callee
+            }
+        }
+        delete visiting[f]
+        memo[f] = frame[f] + best
+        return memo[f]
+    }
+
+    function path(f,    s) {
+        s = f
+        while (f in via)
+        {
+            f = via[f]
+            s = s " > " f
+        }
+        return s
+    }
+
+    $1 == "M" { modules[++module_count] = $2 }
+    $1 == "X" { section[$2, $3] = $4 }
+    $1 == "G" { unused[$2, $3] = 1 }
+    $1 == "E" && !(($2, $3) in seen) {
+        seen[$2, $3] = 1
+        callee_of[$2, ++calls[$2]] = $3
+    }
+    $1 == "F" { frame[$2] = $3 }
+    $1 == "S" {
+        split($2, part, ":")
+        statics[part[1]] += $3
+        static_total += $3
+        static_size[$2] = $3
+    }
+
+    END {
+        for (k in section)
+        {
+            if (k in unused)
+                continue
+            split(k, part, SUBSEP)
+            if (part[2] ~ /^\.text/)
+            {
+                code[part[1]] += section[k]
+                code_total += section[k]
+            }
+            else
+            {
+                rodata[part[1]] += section[k]
+                rodata_total += section[k]
+            }
+        }
+
+        printf "%-12s %6s %6s %6s\n", "module", "code", "const", "ram"
+        for (i = 1; i <= module_count; i++)
+        {
+            m = modules[i]
+            printf "%-12s %6d %6d %6d\n", m, code[m], rodata[m], statics[m]
+        }
+        printf "%-12s %6d %6d %6d\n\n", "total", code_total, rodata_total, static_total
+
+        if (verbose)
+        {
+            print "Statics:"
+            for (s in static_size)
+                printf "  %4d %s\n", static_size[s], s | "sort -rn"
+            close("sort -rn")
+            print ""
+        }
+
+        n = split("main interrupt_handler_high interrupt_handler_low", roots, " ")
+        stack_total = 0
+        print "Compiled stack, deepest path per root:"
+        for (i = 1; i <= n; i++)
+        {
+            d = deepest(roots[i])
+            stack_total += d
+            printf "  %4d %s\n", d, verbose ? path(roots[i]) : roots[i]
+        }
+        if (recursion != "")
+            printf "  recursion, not counted past:%s\n", recursion
+        print ""
+
+        flash = int(code_total * code_factor / 100) + rodata_total + lib_reserve
+        ram = static_total + stack_total + ram_reserve
+
+        printf "Program memory: %5d of %5d bytes (code %d x %d%%, const %d, library %d)\n",
+            flash, flash_budget, code_total, code_factor, rodata_total, lib_reserve
+        printf "Data memory:    %5d of %5d bytes (statics %d, stack %d, reserve %d)\n",
+            ram, ram_budget, static_total, stack_total, ram_reserve
+
+        over = 0
+        if (flash > flash_budget)
+        {
+            printf "Error: program memory over budget by %d bytes\n", flash - flash_budget
+            over = 1
+        }
+        if (ram > ram_budget)
+        {
+            printf "Error: data memory over budget by %d bytes\n", ram - ram_budget
+            over = 1
+        }
+        exit over
+    }' "$TMP/model"
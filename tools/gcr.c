@@ -0,0 +1,226 @@
+/*
+ * File:   gcr.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:06
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "gcr.h"
+
+#define MAX_RUN                 3       /* cells from one transition to the next */
+#define CELL_LIMIT              0.25    /* the estimate stays this close to nominal */
+
+// Same table as the firmware's on chip pattern
+static const uint8_t _g_gcr[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+static int8_t _g_nibble[32];
+
+// Timing recovery is the only difference between decoders
+const gcr_method_t gcr_methods[] = {
+    { "fixed", 0.0 },           /* nominal cell, never adjusted */
+    { "pll", 0.05 },            /* follows drift, rides over jitter */
+    { "pll-fast", 0.25 },       /* follows wow closely, jitter gets through */
+};
+
+const size_t gcr_method_count = sizeof(gcr_methods) / sizeof(gcr_methods[0]);
+
+uint16_t gcr_crc(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+static size_t put_code(uint8_t *cells, size_t n, uint8_t code)
+{
+    int i;
+
+    for (i = 4; i >= 0; i--)
+        cells[n++] = (code >> i) & 0x01;
+
+    return n;
+}
+
+/* One cell per byte, 1 for a transition; GCR_BLOCK_CELLS of them */
+size_t gcr_encode(const gcr_block_t *block, uint8_t *cells)
+{
+    uint8_t bytes[GCR_BLOCK_BYTES];
+    uint16_t crc;
+    size_t n = 0;
+    size_t i;
+
+    memcpy(bytes, block->data, GCR_DATA_BYTES);
+    bytes[GCR_DATA_BYTES] = block->track;
+    bytes[GCR_DATA_BYTES + 1] = block->control;
+    bytes[GCR_DATA_BYTES + 2] = (uint8_t)(block->number >> 8);
+    bytes[GCR_DATA_BYTES + 3] = (uint8_t)block->number;
+
+    crc = gcr_crc(bytes, GCR_BLOCK_BYTES - 2);
+    bytes[GCR_BLOCK_BYTES - 2] = (uint8_t)(crc >> 8);
+    bytes[GCR_BLOCK_BYTES - 1] = (uint8_t)crc;
+
+    for (i = 0; i < GCR_PREAMBLE_CODES; i++)
+        n = put_code(cells, n, 0x1F);
+
+    n = put_code(cells, n, 0x1F);
+    n = put_code(cells, n, 0x07);
+
+    for (i = 0; i < GCR_BLOCK_BYTES; i++)
+    {
+        n = put_code(cells, n, _g_gcr[bytes[i] >> 4]);
+        n = put_code(cells, n, _g_gcr[bytes[i] & 0x0F]);
+    }
+
+    for (i = 0; i < GCR_POSTAMBLE_CODES; i++)
+        n = put_code(cells, n, 0x1F);
+
+    return n;
+}
+
+void gcr_decoder_init(gcr_decoder_t *decoder, const gcr_method_t *method, double cell_ticks,
+    gcr_block_fn found, void *ctx)
+{
+    int i;
+
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->method = method;
+    decoder->nominal = cell_ticks;
+    decoder->cell = cell_ticks;
+    decoder->found = found;
+    decoder->ctx = ctx;
+
+    memset(_g_nibble, -1, sizeof(_g_nibble));
+
+    for (i = 0; i < 16; i++)
+        _g_nibble[_g_gcr[i]] = (int8_t)i;
+}
+
+static void block_done(gcr_decoder_t *decoder)
+{
+    gcr_block_t block;
+    const uint8_t *bytes = decoder->bytes;
+    bool ok = gcr_crc(bytes, GCR_BLOCK_BYTES - 2) ==
+        (uint16_t)((bytes[GCR_BLOCK_BYTES - 2] << 8) | bytes[GCR_BLOCK_BYTES - 1]);
+
+    memcpy(block.data, bytes, GCR_DATA_BYTES);
+    block.track = bytes[GCR_DATA_BYTES];
+    block.control = bytes[GCR_DATA_BYTES + 1];
+    block.number = (uint16_t)((bytes[GCR_DATA_BYTES + 2] << 8) | bytes[GCR_DATA_BYTES + 3]);
+
+    if (!ok)
+        decoder->crc_errors++;
+
+    decoder->found(decoder->ctx, &block, ok);
+    decoder->in_block = false;
+}
+
+static void abandon(gcr_decoder_t *decoder)
+{
+    decoder->bad_codes++;
+    decoder->in_block = false;
+}
+
+static void put_cell(gcr_decoder_t *decoder, uint8_t bit)
+{
+    int8_t nibble;
+
+    decoder->window = (uint16_t)((decoder->window << 1) | bit);
+
+    if (!decoder->in_block)
+    {
+        if ((decoder->window & 0x7FFF) == GCR_MARKER)
+        {
+            decoder->in_block = true;
+            decoder->markers++;
+            decoder->code = 0;
+            decoder->code_bits = 0;
+            decoder->have_high = false;
+            decoder->count = 0;
+        }
+
+        return;
+    }
+
+    decoder->code = (uint8_t)((decoder->code << 1) | bit);
+
+    if (++decoder->code_bits < 5)
+        return;
+
+    nibble = _g_nibble[decoder->code & 0x1F];
+    decoder->code = 0;
+    decoder->code_bits = 0;
+
+    if (nibble < 0)
+    {
+        abandon(decoder);
+        return;
+    }
+
+    if (!decoder->have_high)
+    {
+        decoder->high = (uint8_t)nibble;
+        decoder->have_high = true;
+        return;
+    }
+
+    decoder->bytes[decoder->count++] = (uint8_t)((decoder->high << 4) | nibble);
+    decoder->have_high = false;
+
+    if (decoder->count == GCR_BLOCK_BYTES)
+        block_done(decoder);
+}
+
+void gcr_decode(gcr_decoder_t *decoder, uint32_t ticks)
+{
+    long n = lround(ticks / decoder->cell);
+
+    if (n < 1)
+        n = 1;
+
+    if (n <= MAX_RUN)
+    {
+        if (decoder->method->gain > 0)
+        {
+            double lo = decoder->nominal * (1 - CELL_LIMIT);
+            double hi = decoder->nominal * (1 + CELL_LIMIT);
+
+            decoder->cell += decoder->method->gain * ((double)ticks / n - decoder->cell);
+
+            if (decoder->cell < lo)
+                decoder->cell = lo;
+            else if (decoder->cell > hi)
+                decoder->cell = hi;
+        }
+    }
+    else
+    {
+        // No code allows it: a dropout, or the clock has slipped
+        if (decoder->in_block)
+            abandon(decoder);
+
+        if (n > 16)
+            n = 16;
+    }
+
+    while (--n)
+        put_cell(decoder, 0);
+
+    put_cell(decoder, 1);
+}
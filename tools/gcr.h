@@ -0,0 +1,87 @@
+/*
+ * File:   gcr.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:06
+ *
+ * QIC-24 style GCR 4/5 blocks, and decoders that recover them from flux
+ * intervals.
+ *
+ * A block on tape, one cell per bit, NRZI (a 1 is a flux transition):
+ *
+ *   preamble     GCR_PREAMBLE_CODES of 11111
+ *   marker       11111 00111, neither half a data code
+ *   data         512 bytes
+ *   address      track, control, block number (16 bits, big endian)
+ *   CRC          CRC-16/CCITT-FALSE over data and address, big endian
+ *   postamble    GCR_POSTAMBLE_CODES of 11111
+ *
+ * Bytes go high nibble first, each nibble as one five bit code, so no
+ * more than two cells in a row are without a transition.
+ *
+ * Decoders are fed one interval at a time and differ only in how they
+ * turn an interval into a cell count; the decoders[] table in gcr.c
+ * lists them by name for the benchmark.
+ */
+
+#ifndef __GCR_H__
+#define __GCR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define GCR_DATA_BYTES          512
+#define GCR_BLOCK_BYTES         (GCR_DATA_BYTES + 4 + 2)
+#define GCR_PREAMBLE_CODES      20
+#define GCR_POSTAMBLE_CODES     10
+#define GCR_MARKER              0x7FE7      /* last preamble code, then 11111 00111 */
+#define GCR_BLOCK_CELLS         ((GCR_PREAMBLE_CODES + 2 + GCR_BLOCK_BYTES * 2 + GCR_POSTAMBLE_CODES) * 5)
+
+typedef struct {
+    uint8_t track;
+    uint8_t control;
+    uint16_t number;
+    uint8_t data[GCR_DATA_BYTES];
+} gcr_block_t;
+
+typedef void (*gcr_block_fn)(void *ctx, const gcr_block_t *block, bool crc_ok);
+
+typedef struct {
+    const char *name;
+    double gain;                /* how fast the cell estimate follows, 0 holds it */
+} gcr_method_t;
+
+typedef struct {
+    const gcr_method_t *method;
+    double nominal;             /* sample ticks per cell */
+    double cell;                /* current estimate */
+    gcr_block_fn found;
+    void *ctx;
+
+    uint16_t window;            /* last cells, newest in bit 0 */
+    bool in_block;
+    uint8_t code;
+    uint8_t code_bits;
+    uint8_t high;               /* first nibble of the byte being built */
+    bool have_high;
+    uint8_t bytes[GCR_BLOCK_BYTES];
+    size_t count;
+
+    // Counters
+    uint64_t markers;
+    uint64_t bad_codes;         /* blocks abandoned on a code that is not GCR */
+    uint64_t crc_errors;
+} gcr_decoder_t;
+
+extern const gcr_method_t gcr_methods[];
+extern const size_t gcr_method_count;
+
+size_t gcr_encode(const gcr_block_t *block, uint8_t *cells);
+uint16_t gcr_crc(const uint8_t *data, size_t len);
+
+void gcr_decoder_init(gcr_decoder_t *decoder, const gcr_method_t *method, double cell_ticks,
+    gcr_block_fn found, void *ctx);
+void gcr_decode(gcr_decoder_t *decoder, uint32_t ticks);
+
+#endif /* __GCR_H__ */
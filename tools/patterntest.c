@@ -0,0 +1,137 @@
+/*
+ * File:   patterntest.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:33
+ *
+ * Host check of the on chip write patterns. pattern.c and the timer0
+ * interrupt handler from main.c are built for the host against the
+ * register file in pic/; the handler is called once per bit cell, with
+ * pattern_poll() topping the ring up between calls as the run loop does,
+ * and every toggle of the write lines is read back as a 1.
+ *
+ * Every pattern must keep to the GCR limit of two cells in a row without
+ * a transition, across byte boundaries and the ring wrapping, and must
+ * not underrun. The PRBS must also be exactly the GCR 4/5 coded LFSR
+ * nibbles, in order, from the first cell.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pic/xc.h"
+#include "../project.h"
+#include "../timers.h"
+#include "../pattern.h"
+
+#define CELLS           (2 * 32767L * 5)    /* two whole LFSR periods of codes */
+#define POLL_EVERY      4                   /* interrupts between ring refills */
+#define MAX_ZEROS       2
+
+void interrupt_handler_high(void);
+
+// Same code and LFSR as the firmware, written out independently
+static const uint8_t _g_gcr[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+static uint16_t _g_lfsr;
+static uint8_t _g_code;
+static int _g_code_bits;
+
+static int expected_prbs_cell(void)
+{
+    int i;
+
+    if (!_g_code_bits)
+    {
+        for (i = 0; i < 4; i++)
+            _g_lfsr = ((_g_lfsr << 1) | (((_g_lfsr >> 14) ^ (_g_lfsr >> 13)) & 0x01)) & 0x7FFF;
+
+        _g_code = _g_gcr[_g_lfsr & 0x0F];
+        _g_code_bits = 5;
+    }
+
+    return (_g_code >> --_g_code_bits) & 0x01;
+}
+
+// One timer0 interrupt; a 1 is a toggle of the write lines
+static int next_cell(void)
+{
+    uint8_t before = LATC;
+
+    INTCONbits.INT0IF = 0;
+    PIR1bits.RCIF = 0;
+    INTCONbits.TMR0IF = 1;
+    interrupt_handler_high();
+
+    return ((LATC ^ before) & 0x03) == 0x03;
+}
+
+static int check_pattern(uint8_t pattern)
+{
+    long cell;
+    long mismatch = -1;
+    int zeros = 0;
+    int longest = 0;
+    int ones = 0;
+
+    _g_lfsr = 0x7FFF;
+    _g_code_bits = 0;
+
+    pattern_start(pattern, PATTERN_MAX_KHZ);
+
+    if (!_g_pattern.active)
+    {
+        printf("%s: did not start\n", pattern_name(pattern));
+        return 1;
+    }
+
+    for (cell = 0; cell < CELLS; cell++)
+    {
+        int bit = next_cell();
+
+        if (bit)
+        {
+            ones++;
+            zeros = 0;
+        }
+        else if (++zeros > longest)
+        {
+            longest = zeros;
+        }
+
+        if (pattern == PATTERN_PRBS && expected_prbs_cell() != bit && mismatch < 0)
+            mismatch = cell;
+
+        if (!(cell % POLL_EVERY))
+            pattern_poll();
+    }
+
+    pattern_stop();
+
+    printf("%-9s longest gap %d cells, %u underruns", pattern_name(pattern), longest, _g_pattern.underruns);
+    if (mismatch >= 0)
+        printf(", differs from the coded LFSR at cell %ld", mismatch);
+    printf("\n");
+
+    return longest > MAX_ZEROS || !ones || _g_pattern.underruns || mismatch >= 0;
+}
+
+int main(void)
+{
+    int failures = 0;
+
+    timer0_init();
+
+    failures += check_pattern(PATTERN_ALL);
+    failures += check_pattern(PATTERN_ISOLATED);
+    failures += check_pattern(PATTERN_PRBS);
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+/*
+ * File:   ctype.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:24
+ */
+
+#ifndef __HOST_CTYPE_H__
+#define __HOST_CTYPE_H__
+
+/* XC8 library routines the firmware calls, for the size build only */
+
+int toupper(int c);
+int tolower(int c);
+
+#endif /* __HOST_CTYPE_H__ */
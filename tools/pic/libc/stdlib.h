@@ -0,0 +1,19 @@
+/*
+ * File:   stdlib.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:24
+ */
+
+#ifndef __HOST_STDLIB_H__
+#define __HOST_STDLIB_H__
+
+/* XC8 library routines the firmware calls, for the size build only */
+
+#include <stddef.h>
+
+int abs(int value);
+int atoi(const char *s);
+long atol(const char *s);
+
+#endif /* __HOST_STDLIB_H__ */
@@ -0,0 +1,26 @@
+/*
+ * File:   string.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:24
+ */
+
+#ifndef __HOST_STRING_H__
+#define __HOST_STRING_H__
+
+/*
+ * Declarations of the XC8 library string routines the firmware calls,
+ * for the freestanding 32 bit size build. Nothing here is linked.
+ */
+
+#include <stddef.h>
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+void *memset(void *dst, int c, size_t n);
+size_t strlen(const char *s);
+int strcmp(const char *a, const char *b);
+char *strncpy(char *dst, const char *src, size_t n);
+char *strtok(char *s, const char *delim);
+
+#endif /* __HOST_STRING_H__ */
@@ -0,0 +1,40 @@
+/*
+ * File:   pic.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:25
+ */
+
+#include <stdint.h>
+#include <strings.h>
+
+#include "xc.h"
+
+/*
+ * The register file gets a page of its own, so a host check can
+ * write-protect it and see every store the firmware makes.
+ */
+volatile uint8_t _g_sfr[SFR_PAGE] __attribute__((aligned(SFR_PAGE)));
+
+void __delay_ms(unsigned long ms)
+{
+    (void)ms;
+}
+
+void __delay_us(unsigned long us)
+{
+    (void)us;
+}
+
+void CLRWDT(void)
+{
+}
+
+void NOP(void)
+{
+}
+
+int stricmp(const char *a, const char *b)
+{
+    return strcasecmp(a, b);
+}
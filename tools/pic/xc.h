@@ -0,0 +1,633 @@
+/*
+ * File:   xc.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:24
+ */
+
+#ifndef __HOST_XC_H__
+#define __HOST_XC_H__
+
+/*
+ * Host stand-in for the XC8 <xc.h>, so firmware sources compile with the
+ * host compiler for size reports and host checks. The special function
+ * registers of the PIC18F4320 live in one array, _g_sfr, indexed from
+ * 0xF80 like the access bank, so a register and its bit union alias the
+ * same byte as they do on the chip. Only the registers the firmware uses
+ * are described.
+ */
+
+#include <stdint.h>
+
+#define __18F4320               1
+
+#define interrupt
+#define high_priority
+#define low_priority
+#define persistent
+#define __persistent
+#define asm(x)                  ((void)0)
+
+#define SFR_BASE                0xF80
+#define SFR_PAGE                4096
+#define SFR(addr)               (_g_sfr[(addr) - SFR_BASE])
+
+extern volatile uint8_t _g_sfr[];
+
+void __delay_ms(unsigned long ms);
+void __delay_us(unsigned long us);
+void CLRWDT(void);
+void NOP(void);
+int stricmp(const char *a, const char *b);
+
+typedef union {
+    struct {
+        uint8_t RA0:1;
+        uint8_t RA1:1;
+        uint8_t RA2:1;
+        uint8_t RA3:1;
+        uint8_t RA4:1;
+        uint8_t RA5:1;
+        uint8_t RA6:1;
+        uint8_t RA7:1;
+    };
+} PORTAbits_t;
+#define PORTAbits (*(volatile PORTAbits_t *)&SFR(0xF80))
+#define PORTA SFR(0xF80)
+
+typedef union {
+    struct {
+        uint8_t RB0:1;
+        uint8_t RB1:1;
+        uint8_t RB2:1;
+        uint8_t RB3:1;
+        uint8_t RB4:1;
+        uint8_t RB5:1;
+        uint8_t RB6:1;
+        uint8_t RB7:1;
+    };
+} PORTBbits_t;
+#define PORTBbits (*(volatile PORTBbits_t *)&SFR(0xF81))
+#define PORTB SFR(0xF81)
+
+typedef union {
+    struct {
+        uint8_t RC0:1;
+        uint8_t RC1:1;
+        uint8_t RC2:1;
+        uint8_t RC3:1;
+        uint8_t RC4:1;
+        uint8_t RC5:1;
+        uint8_t RC6:1;
+        uint8_t RC7:1;
+    };
+} PORTCbits_t;
+#define PORTCbits (*(volatile PORTCbits_t *)&SFR(0xF82))
+#define PORTC SFR(0xF82)
+
+typedef union {
+    struct {
+        uint8_t RD0:1;
+        uint8_t RD1:1;
+        uint8_t RD2:1;
+        uint8_t RD3:1;
+        uint8_t RD4:1;
+        uint8_t RD5:1;
+        uint8_t RD6:1;
+        uint8_t RD7:1;
+    };
+} PORTDbits_t;
+#define PORTDbits (*(volatile PORTDbits_t *)&SFR(0xF83))
+#define PORTD SFR(0xF83)
+
+typedef union {
+    struct {
+        uint8_t LATA0:1;
+        uint8_t LATA1:1;
+        uint8_t LATA2:1;
+        uint8_t LATA3:1;
+        uint8_t LATA4:1;
+        uint8_t LATA5:1;
+        uint8_t LATA6:1;
+        uint8_t LATA7:1;
+    };
+} LATAbits_t;
+#define LATAbits (*(volatile LATAbits_t *)&SFR(0xF89))
+#define LATA SFR(0xF89)
+
+typedef union {
+    struct {
+        uint8_t LATB0:1;
+        uint8_t LATB1:1;
+        uint8_t LATB2:1;
+        uint8_t LATB3:1;
+        uint8_t LATB4:1;
+        uint8_t LATB5:1;
+        uint8_t LATB6:1;
+        uint8_t LATB7:1;
+    };
+} LATBbits_t;
+#define LATBbits (*(volatile LATBbits_t *)&SFR(0xF8A))
+#define LATB SFR(0xF8A)
+
+typedef union {
+    struct {
+        uint8_t LATC0:1;
+        uint8_t LATC1:1;
+        uint8_t LATC2:1;
+        uint8_t LATC3:1;
+        uint8_t LATC4:1;
+        uint8_t LATC5:1;
+        uint8_t LATC6:1;
+        uint8_t LATC7:1;
+    };
+} LATCbits_t;
+#define LATCbits (*(volatile LATCbits_t *)&SFR(0xF8B))
+#define LATC SFR(0xF8B)
+
+typedef union {
+    struct {
+        uint8_t LATD0:1;
+        uint8_t LATD1:1;
+        uint8_t LATD2:1;
+        uint8_t LATD3:1;
+        uint8_t LATD4:1;
+        uint8_t LATD5:1;
+        uint8_t LATD6:1;
+        uint8_t LATD7:1;
+    };
+} LATDbits_t;
+#define LATDbits (*(volatile LATDbits_t *)&SFR(0xF8C))
+#define LATD SFR(0xF8C)
+
+typedef union {
+    struct {
+        uint8_t TRISA0:1;
+        uint8_t TRISA1:1;
+        uint8_t TRISA2:1;
+        uint8_t TRISA3:1;
+        uint8_t TRISA4:1;
+        uint8_t TRISA5:1;
+        uint8_t TRISA6:1;
+        uint8_t TRISA7:1;
+    };
+} TRISAbits_t;
+#define TRISAbits (*(volatile TRISAbits_t *)&SFR(0xF92))
+#define TRISA SFR(0xF92)
+
+typedef union {
+    struct {
+        uint8_t TRISB0:1;
+        uint8_t TRISB1:1;
+        uint8_t TRISB2:1;
+        uint8_t TRISB3:1;
+        uint8_t TRISB4:1;
+        uint8_t TRISB5:1;
+        uint8_t TRISB6:1;
+        uint8_t TRISB7:1;
+    };
+} TRISBbits_t;
+#define TRISBbits (*(volatile TRISBbits_t *)&SFR(0xF93))
+#define TRISB SFR(0xF93)
+
+typedef union {
+    struct {
+        uint8_t TRISC0:1;
+        uint8_t TRISC1:1;
+        uint8_t TRISC2:1;
+        uint8_t TRISC3:1;
+        uint8_t TRISC4:1;
+        uint8_t TRISC5:1;
+        uint8_t TRISC6:1;
+        uint8_t TRISC7:1;
+    };
+} TRISCbits_t;
+#define TRISCbits (*(volatile TRISCbits_t *)&SFR(0xF94))
+#define TRISC SFR(0xF94)
+
+typedef union {
+    struct {
+        uint8_t TRISD0:1;
+        uint8_t TRISD1:1;
+        uint8_t TRISD2:1;
+        uint8_t TRISD3:1;
+        uint8_t TRISD4:1;
+        uint8_t TRISD5:1;
+        uint8_t TRISD6:1;
+        uint8_t TRISD7:1;
+    };
+} TRISDbits_t;
+#define TRISDbits (*(volatile TRISDbits_t *)&SFR(0xF95))
+#define TRISD SFR(0xF95)
+
+typedef union {
+    struct {
+        uint8_t TMR1IE:1;
+        uint8_t TMR2IE:1;
+        uint8_t CCP1IE:1;
+        uint8_t SSPIE:1;
+        uint8_t TXIE:1;
+        uint8_t RCIE:1;
+        uint8_t ADIE:1;
+        uint8_t PSPIE:1;
+    };
+} PIE1bits_t;
+#define PIE1bits (*(volatile PIE1bits_t *)&SFR(0xF9D))
+#define PIE1 SFR(0xF9D)
+
+typedef union {
+    struct {
+        uint8_t TMR1IF:1;
+        uint8_t TMR2IF:1;
+        uint8_t CCP1IF:1;
+        uint8_t SSPIF:1;
+        uint8_t TXIF:1;
+        uint8_t RCIF:1;
+        uint8_t ADIF:1;
+        uint8_t PSPIF:1;
+    };
+} PIR1bits_t;
+#define PIR1bits (*(volatile PIR1bits_t *)&SFR(0xF9E))
+#define PIR1 SFR(0xF9E)
+
+typedef union {
+    struct {
+        uint8_t TMR1IP:1;
+        uint8_t TMR2IP:1;
+        uint8_t CCP1IP:1;
+        uint8_t SSPIP:1;
+        uint8_t TXIP:1;
+        uint8_t RCIP:1;
+        uint8_t ADIP:1;
+        uint8_t PSPIP:1;
+    };
+} IPR1bits_t;
+#define IPR1bits (*(volatile IPR1bits_t *)&SFR(0xF9F))
+#define IPR1 SFR(0xF9F)
+
+typedef union {
+    struct {
+        uint8_t CCP2IE:1;
+        uint8_t TMR3IE:1;
+        uint8_t LVDIE:1;
+        uint8_t BCLIE:1;
+        uint8_t EEIE:1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t OSCFIE:1;
+    };
+} PIE2bits_t;
+#define PIE2bits (*(volatile PIE2bits_t *)&SFR(0xFA0))
+#define PIE2 SFR(0xFA0)
+
+typedef union {
+    struct {
+        uint8_t CCP2IF:1;
+        uint8_t TMR3IF:1;
+        uint8_t LVDIF:1;
+        uint8_t BCLIF:1;
+        uint8_t EEIF:1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t OSCFIF:1;
+    };
+} PIR2bits_t;
+#define PIR2bits (*(volatile PIR2bits_t *)&SFR(0xFA1))
+#define PIR2 SFR(0xFA1)
+
+typedef union {
+    struct {
+        uint8_t CCP2IP:1;
+        uint8_t TMR3IP:1;
+        uint8_t LVDIP:1;
+        uint8_t BCLIP:1;
+        uint8_t EEIP:1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t OSCFIP:1;
+    };
+} IPR2bits_t;
+#define IPR2bits (*(volatile IPR2bits_t *)&SFR(0xFA2))
+#define IPR2 SFR(0xFA2)
+
+typedef union {
+    struct {
+        uint8_t RD:1;
+        uint8_t WR:1;
+        uint8_t WREN:1;
+        uint8_t WRERR:1;
+        uint8_t FREE:1;
+        uint8_t :1;
+        uint8_t CFGS:1;
+        uint8_t EEPGD:1;
+    };
+} EECON1bits_t;
+#define EECON1bits (*(volatile EECON1bits_t *)&SFR(0xFA6))
+#define EECON1 SFR(0xFA6)
+
+#define EECON2 SFR(0xFA7)
+
+#define EEDATA SFR(0xFA8)
+
+#define EEADR SFR(0xFA9)
+
+typedef union {
+    struct {
+        uint8_t RX9D:1;
+        uint8_t OERR:1;
+        uint8_t FERR:1;
+        uint8_t ADDEN:1;
+        uint8_t CREN:1;
+        uint8_t SREN:1;
+        uint8_t RX9:1;
+        uint8_t SPEN:1;
+    };
+} RCSTAbits_t;
+#define RCSTAbits (*(volatile RCSTAbits_t *)&SFR(0xFAB))
+#define RCSTA SFR(0xFAB)
+
+typedef union {
+    struct {
+        uint8_t TX9D:1;
+        uint8_t TRMT:1;
+        uint8_t BRGH:1;
+        uint8_t :1;
+        uint8_t SYNC:1;
+        uint8_t TXEN:1;
+        uint8_t TX9:1;
+        uint8_t CSRC:1;
+    };
+} TXSTAbits_t;
+#define TXSTAbits (*(volatile TXSTAbits_t *)&SFR(0xFAC))
+#define TXSTA SFR(0xFAC)
+
+#define TXREG SFR(0xFAD)
+
+#define RCREG SFR(0xFAE)
+
+#define SPBRG SFR(0xFAF)
+
+typedef union {
+    struct {
+        uint8_t TMR3ON:1;
+        uint8_t TMR3CS:1;
+        uint8_t T3SYNC:1;
+        uint8_t T3CCP1:1;
+        uint8_t T3CKPS0:1;
+        uint8_t T3CKPS1:1;
+        uint8_t T3CCP2:1;
+        uint8_t RD16:1;
+    };
+} T3CONbits_t;
+#define T3CONbits (*(volatile T3CONbits_t *)&SFR(0xFB1))
+#define T3CON SFR(0xFB1)
+
+#define TMR3L SFR(0xFB2)
+
+#define TMR3H SFR(0xFB3)
+
+typedef union {
+    struct {
+        uint8_t CCP2M0:1;
+        uint8_t CCP2M1:1;
+        uint8_t CCP2M2:1;
+        uint8_t CCP2M3:1;
+        uint8_t DC2B0:1;
+        uint8_t DC2B1:1;
+        uint8_t :1;
+        uint8_t :1;
+    };
+} CCP2CONbits_t;
+#define CCP2CONbits (*(volatile CCP2CONbits_t *)&SFR(0xFBA))
+#define CCP2CON SFR(0xFBA)
+
+#define CCPR2L SFR(0xFBB)
+
+#define CCPR2H SFR(0xFBC)
+
+typedef union {
+    struct {
+        uint8_t CCP1M0:1;
+        uint8_t CCP1M1:1;
+        uint8_t CCP1M2:1;
+        uint8_t CCP1M3:1;
+        uint8_t DC1B0:1;
+        uint8_t DC1B1:1;
+        uint8_t P1M0:1;
+        uint8_t P1M1:1;
+    };
+} CCP1CONbits_t;
+#define CCP1CONbits (*(volatile CCP1CONbits_t *)&SFR(0xFBD))
+#define CCP1CON SFR(0xFBD)
+
+#define CCPR1L SFR(0xFBE)
+
+#define CCPR1H SFR(0xFBF)
+
+typedef union {
+    struct {
+        uint8_t PCFG0:1;
+        uint8_t PCFG1:1;
+        uint8_t PCFG2:1;
+        uint8_t PCFG3:1;
+        uint8_t VCFG0:1;
+        uint8_t VCFG1:1;
+        uint8_t :1;
+        uint8_t :1;
+    };
+} ADCON1bits_t;
+#define ADCON1bits (*(volatile ADCON1bits_t *)&SFR(0xFC1))
+#define ADCON1 SFR(0xFC1)
+
+typedef union {
+    struct {
+        uint8_t SSPM0:1;
+        uint8_t SSPM1:1;
+        uint8_t SSPM2:1;
+        uint8_t SSPM3:1;
+        uint8_t CKP:1;
+        uint8_t SSPEN:1;
+        uint8_t SSPOV:1;
+        uint8_t WCOL:1;
+    };
+} SSPCON1bits_t;
+#define SSPCON1bits (*(volatile SSPCON1bits_t *)&SFR(0xFC6))
+#define SSPCON1 SFR(0xFC6)
+
+typedef union {
+    struct {
+        uint8_t BF:1;
+        uint8_t UA:1;
+        uint8_t R_W:1;
+        uint8_t S:1;
+        uint8_t P:1;
+        uint8_t D_A:1;
+        uint8_t CKE:1;
+        uint8_t SMP:1;
+    };
+} SSPSTATbits_t;
+#define SSPSTATbits (*(volatile SSPSTATbits_t *)&SFR(0xFC7))
+#define SSPSTAT SFR(0xFC7)
+
+#define SSPBUF SFR(0xFC9)
+
+typedef union {
+    struct {
+        uint8_t T2CKPS0:1;
+        uint8_t T2CKPS1:1;
+        uint8_t TMR2ON:1;
+        uint8_t TOUTPS0:1;
+        uint8_t TOUTPS1:1;
+        uint8_t TOUTPS2:1;
+        uint8_t TOUTPS3:1;
+        uint8_t :1;
+    };
+} T2CONbits_t;
+#define T2CONbits (*(volatile T2CONbits_t *)&SFR(0xFCA))
+#define T2CON SFR(0xFCA)
+
+#define PR2 SFR(0xFCB)
+
+#define TMR2 SFR(0xFCC)
+
+typedef union {
+    struct {
+        uint8_t TMR1ON:1;
+        uint8_t TMR1CS:1;
+        uint8_t T1SYNC:1;
+        uint8_t T1OSCEN:1;
+        uint8_t T1CKPS0:1;
+        uint8_t T1CKPS1:1;
+        uint8_t T1RUN:1;
+        uint8_t RD16:1;
+    };
+} T1CONbits_t;
+#define T1CONbits (*(volatile T1CONbits_t *)&SFR(0xFCD))
+#define T1CON SFR(0xFCD)
+
+#define TMR1L SFR(0xFCE)
+
+#define TMR1H SFR(0xFCF)
+
+typedef union {
+    struct {
+        uint8_t BOR:1;
+        uint8_t POR:1;
+        uint8_t PD:1;
+        uint8_t TO:1;
+        uint8_t RI:1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t IPEN:1;
+    };
+} RCONbits_t;
+#define RCONbits (*(volatile RCONbits_t *)&SFR(0xFD0))
+#define RCON SFR(0xFD0)
+
+typedef union {
+    struct {
+        uint8_t T0PS0:1;
+        uint8_t T0PS1:1;
+        uint8_t T0PS2:1;
+        uint8_t PSA:1;
+        uint8_t T0SE:1;
+        uint8_t T0CS:1;
+        uint8_t T08BIT:1;
+        uint8_t TMR0ON:1;
+    };
+    struct {
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t T0PS3:1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+    };
+} T0CONbits_t;
+#define T0CONbits (*(volatile T0CONbits_t *)&SFR(0xFD5))
+#define T0CON SFR(0xFD5)
+
+#define TMR0L SFR(0xFD6)
+
+#define TMR0H SFR(0xFD7)
+
+#define WREG SFR(0xFE8)
+
+typedef union {
+    struct {
+        uint8_t INT1IF:1;
+        uint8_t INT2IF:1;
+        uint8_t :1;
+        uint8_t INT1IE:1;
+        uint8_t INT2IE:1;
+        uint8_t :1;
+        uint8_t INT1IP:1;
+        uint8_t INT2IP:1;
+    };
+} INTCON3bits_t;
+#define INTCON3bits (*(volatile INTCON3bits_t *)&SFR(0xFF0))
+#define INTCON3 SFR(0xFF0)
+
+typedef union {
+    struct {
+        uint8_t RBIP:1;
+        uint8_t :1;
+        uint8_t TMR0IP:1;
+        uint8_t :1;
+        uint8_t INTEDG2:1;
+        uint8_t INTEDG1:1;
+        uint8_t INTEDG0:1;
+        uint8_t RBPU:1;
+    };
+} INTCON2bits_t;
+#define INTCON2bits (*(volatile INTCON2bits_t *)&SFR(0xFF1))
+#define INTCON2 SFR(0xFF1)
+
+typedef union {
+    struct {
+        uint8_t RBIF:1;
+        uint8_t INT0IF:1;
+        uint8_t TMR0IF:1;
+        uint8_t RBIE:1;
+        uint8_t INT0IE:1;
+        uint8_t TMR0IE:1;
+        uint8_t PEIE_GIEL:1;
+        uint8_t GIE_GIEH:1;
+    };
+    struct {
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t PEIE:1;
+        uint8_t GIE:1;
+    };
+    struct {
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t :1;
+        uint8_t GIEL:1;
+        uint8_t GIEH:1;
+    };
+    struct {
+        uint8_t :1;
+        uint8_t INT0F:1;
+        uint8_t T0IF:1;
+        uint8_t :1;
+        uint8_t INT0E:1;
+        uint8_t T0IE:1;
+        uint8_t :1;
+        uint8_t :1;
+    };
+} INTCONbits_t;
+#define INTCONbits (*(volatile INTCONbits_t *)&SFR(0xFF2))
+#define INTCON SFR(0xFF2)
+
+#endif /* __HOST_XC_H__ */
@@ -0,0 +1,780 @@
+/*
+ * File:   tapediff.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:58
+ *
+ * Aligned comparison of two captures of the same cartridge, to follow
+ * media degradation between periodic re-captures.
+ *
+ * Both captures are first put on a common scale of tape position using
+ * their tach pulses: a transition's position is the tach window it falls
+ * in plus how far through the window it is, and its interval is divided
+ * by that window's length. This takes out the start offset of the tach
+ * counter, the overall speed difference between the two drives and
+ * any speed drift the tach shows.
+ *
+ * Coarse alignment cross-correlates the transition density of the two
+ * tracks (BINS_PER_TACH bins per tach window) with an FFT, which gives
+ * the offset between them to a fraction of a window. Then for each tach
+ * window of the first capture the matching stretch of the second is
+ * found by sliding the interval sequences past each other and taking
+ * the lag with the least squared difference; that kernel is SSE/AVX.
+ * Windows where the density or the remaining timing difference is over
+ * threshold are merged into regions and reported.
+ *
+ * Accepts .tcap and .tcx captures in any combination.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <complex.h>
+#include <unistd.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "capture.h"
+#include "tcx.h"
+
+#define MAX_TRACKS          64      /* per capture file */
+#define BINS_PER_TACH       8       /* coarse alignment resolution */
+#define MIN_OVERLAP         2       /* of the shorter track, as 1/n, for a coarse match */
+
+typedef struct {
+    const char *path;
+    uint32_t sample_hz;
+
+    // As captured
+    uint32_t *ticks;
+    size_t count;
+    size_t room;
+    uint64_t *tach_time;            /* sample ticks from track start to each pulse */
+    uint32_t tach_count;
+    uint32_t tach_room;
+    uint64_t now;
+
+    // On the tach scale
+    double *pos;                    /* tach windows from the first pulse */
+    float *interval;                /* fraction of the local tach window */
+    double tach_period;             /* median, in seconds */
+} track_data_t;
+
+typedef struct {
+    double first;
+    double last;
+    uint32_t windows;
+    double density;                 /* largest change, as a fraction */
+    double timing;                  /* largest rms difference, fraction of mean interval */
+} region_t;
+
+static double _g_density_limit = 0.05;
+static double _g_timing_limit = 0.10;
+static size_t _g_radius = 32;
+static bool _g_windows;
+
+static capture_stream_t _g_stream;
+
+/* Loading */
+
+static bool is_tcx(const char *path)
+{
+    char magic[4] = { 0 };
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    if (read(fd, magic, sizeof(magic)) != (ssize_t)sizeof(magic))
+        magic[0] = 0;
+
+    close(fd);
+
+    return memcmp(magic, TCX_MAGIC, 4) == 0;
+}
+
+static int add_event(track_data_t *data, int event, uint32_t value)
+{
+    if (event == CAPTURE_EV_INTERVAL)
+    {
+        if (data->count == data->room)
+        {
+            size_t room = data->room ? data->room * 2 : 65536;
+            uint32_t *p = realloc(data->ticks, room * sizeof(uint32_t));
+
+            if (!p)
+                return -1;
+
+            data->ticks = p;
+            data->room = room;
+        }
+
+        data->ticks[data->count++] = value;
+        data->now += value;
+    }
+    else if (event == CAPTURE_EV_TACH)
+    {
+        if (data->tach_count == data->tach_room)
+        {
+            uint32_t room = data->tach_room ? data->tach_room * 2 : 4096;
+            uint64_t *p = realloc(data->tach_time, room * sizeof(uint64_t));
+
+            if (!p)
+                return -1;
+
+            data->tach_time = p;
+            data->tach_room = room;
+        }
+
+        data->tach_time[data->tach_count++] = data->now;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int load_tcx(track_data_t *data, unsigned int track)
+{
+    tcx_file_t file;
+    tcx_cursor_t cursor;
+    const tcx_track_t *entry;
+    const tcx_chunk_t *chunks;
+    uint32_t value;
+    uint32_t c;
+    int event;
+    int result = 0;
+
+    if (tcx_open(&file, data->path) < 0)
+        return -1;
+
+    data->sample_hz = file.header->sample_hz;
+    entry = tcx_find_track(&file, track);
+    chunks = entry ? tcx_chunks(&file, entry) : NULL;
+
+    if (!chunks)
+        result = -1;
+
+    for (c = 0; !result && c < entry->chunk_count; c++)
+    {
+        if (tcx_cursor_init(&cursor, &file, &chunks[c]) < 0)
+            result = -1;
+
+        while (!result && (event = tcx_cursor_next(&cursor, &value)) != CAPTURE_EV_EOF)
+            result = add_event(data, event, value);
+    }
+
+    tcx_close(&file);
+
+    return result;
+}
+
+static int load_tcap(track_data_t *data, unsigned int track)
+{
+    capture_header_t header;
+    uint32_t value;
+    bool in_track = false;
+    int result = -1;
+    int event;
+    int fd;
+
+    fd = open(data->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    if (capture_read_header(fd, &header) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    data->sample_hz = header.sample_hz;
+    capture_stream_init(&_g_stream, fd, CAPTURE_HEADER_SIZE, lseek(fd, 0, SEEK_END));
+
+    while ((event = capture_next(&_g_stream, &value)) > CAPTURE_EV_EOF)
+    {
+        if (event == CAPTURE_EV_TRACK)
+        {
+            in_track = (value == track);
+        }
+        else if (in_track && event == CAPTURE_EV_END)
+        {
+            result = 0;
+            break;
+        }
+        else if (in_track && add_event(data, event, value) < 0)
+        {
+            break;
+        }
+    }
+
+    close(fd);
+
+    return result;
+}
+
+static int list_tracks(const char *path, unsigned int *tracks)
+{
+    int count = 0;
+
+    if (is_tcx(path))
+    {
+        tcx_file_t file;
+        uint32_t i;
+
+        if (tcx_open(&file, path) < 0)
+            return -1;
+
+        for (i = 0; i < file.header->track_count && count < MAX_TRACKS; i++)
+            tracks[count++] = file.tracks[i].track;
+
+        tcx_close(&file);
+    }
+    else
+    {
+        capture_header_t header;
+        uint32_t value;
+        int event;
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0 || capture_read_header(fd, &header) < 0)
+            return -1;
+
+        capture_stream_init(&_g_stream, fd, CAPTURE_HEADER_SIZE, lseek(fd, 0, SEEK_END));
+
+        while ((event = capture_next(&_g_stream, &value)) > CAPTURE_EV_EOF)
+        {
+            if (event == CAPTURE_EV_TRACK && count < MAX_TRACKS)
+                tracks[count++] = value;
+        }
+
+        close(fd);
+
+        if (event == CAPTURE_EV_ERROR)
+            return -1;
+    }
+
+    return count;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Puts every transition on the tach scale */
+static int normalise(track_data_t *data)
+{
+    uint64_t *periods;
+    uint64_t end = 0;
+    uint32_t k = 0;
+    size_t i;
+
+    if (data->tach_count < 2 || !data->count || !data->sample_hz)
+        return -1;
+
+    data->pos = malloc(data->count * sizeof(double));
+    data->interval = malloc(data->count * sizeof(float));
+    periods = malloc((data->tach_count - 1) * sizeof(uint64_t));
+
+    if (!data->pos || !data->interval || !periods)
+    {
+        free(periods);
+        return -1;
+    }
+
+    for (k = 0; k + 1 < data->tach_count; k++)
+        periods[k] = data->tach_time[k + 1] - data->tach_time[k];
+
+    qsort(periods, data->tach_count - 1, sizeof(uint64_t), compare_u64);
+    data->tach_period = (double)periods[(data->tach_count - 1) / 2] / data->sample_hz;
+    free(periods);
+
+    // Before the first pulse and after the last, the nearest window's length stands in
+    for (i = 0, k = 0; i < data->count; i++)
+    {
+        double start;
+        double period;
+
+        end += data->ticks[i];
+
+        while (k + 2 < data->tach_count && end >= data->tach_time[k + 1])
+            k++;
+
+        start = (double)data->tach_time[k];
+        period = (double)(data->tach_time[k + 1] - data->tach_time[k]);
+
+        data->pos[i] = k + ((double)end - start) / period;
+        data->interval[i] = (float)(data->ticks[i] / period);
+    }
+
+    return 0;
+}
+
+static void release(track_data_t *data)
+{
+    free(data->ticks);
+    free(data->tach_time);
+    free(data->pos);
+    free(data->interval);
+}
+
+static int load(track_data_t *data, const char *path, unsigned int track)
+{
+    int result;
+
+    memset(data, 0, sizeof(*data));
+    data->path = path;
+
+    result = is_tcx(path) ? load_tcx(data, track) : load_tcap(data, track);
+
+    if (!result)
+        result = normalise(data);
+
+    return result;
+}
+
+/* Coarse alignment */
+
+static void fft(double complex *x, size_t n, bool inverse)
+{
+    size_t i;
+    size_t j;
+    size_t len;
+
+    for (i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+
+        j ^= bit;
+
+        if (i < j)
+        {
+            double complex t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1)
+    {
+        double angle = (inverse ? 2 : -2) * M_PI / len;
+        double complex step = cexp(I * angle);
+
+        for (i = 0; i < n; i += len)
+        {
+            double complex w = 1;
+
+            for (j = 0; j < len / 2; j++)
+            {
+                double complex u = x[i + j];
+                double complex v = x[i + j + len / 2] * w;
+
+                x[i + j] = u + v;
+                x[i + j + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+}
+
+/* Transition count per bin, mean removed, into x[0..bins) */
+static size_t density(const track_data_t *data, double origin, double complex *x)
+{
+    size_t bins = (size_t)((data->pos[data->count - 1] - origin) * BINS_PER_TACH) + 1;
+    double mean = (double)data->count / bins;
+    size_t i;
+
+    for (i = 0; i < data->count; i++)
+        x[(size_t)((data->pos[i] - origin) * BINS_PER_TACH)] += 1;
+
+    for (i = 0; i < bins; i++)
+        x[i] -= mean;
+
+    return bins;
+}
+
+/*
+ * Offset of b from a in tach windows (b position = a position + offset),
+ * or NAN if the tracks do not overlap enough to say.
+ */
+static double coarse_offset(const track_data_t *a, const track_data_t *b, double *score)
+{
+    double origin_a = floor(a->pos[0]);
+    double origin_b = floor(b->pos[0]);
+    size_t len_a = (size_t)((a->pos[a->count - 1] - origin_a) * BINS_PER_TACH) + 1;
+    size_t len_b = (size_t)((b->pos[b->count - 1] - origin_b) * BINS_PER_TACH) + 1;
+    size_t shorter = len_a < len_b ? len_a : len_b;
+    size_t n = 1;
+    double complex *fa;
+    double complex *fb;
+    double energy_a = 0;
+    double energy_b = 0;
+    double best = -INFINITY;
+    double offset = NAN;
+    ptrdiff_t best_lag = 0;
+    ptrdiff_t lag;
+    size_t i;
+
+    while (n < len_a + len_b)
+        n <<= 1;
+
+    fa = calloc(n, sizeof(double complex));
+    fb = calloc(n, sizeof(double complex));
+
+    if (!fa || !fb)
+    {
+        free(fa);
+        free(fb);
+        return NAN;
+    }
+
+    density(a, origin_a, fa);
+    density(b, origin_b, fb);
+
+    for (i = 0; i < n; i++)
+    {
+        energy_a += creal(fa[i]) * creal(fa[i]);
+        energy_b += creal(fb[i]) * creal(fb[i]);
+    }
+
+    fft(fa, n, false);
+    fft(fb, n, false);
+
+    for (i = 0; i < n; i++)
+        fa[i] = conj(fa[i]) * fb[i];
+
+    fft(fa, n, true);
+
+    // Correlation at lag L pairs a[x] with b[x + L]; negative lags wrap to the top
+    for (lag = -(ptrdiff_t)len_a + 1; lag < (ptrdiff_t)len_b; lag++)
+    {
+        ptrdiff_t lo = lag < 0 ? -lag : 0;
+        ptrdiff_t hi = (ptrdiff_t)len_b - lag < (ptrdiff_t)len_a ? (ptrdiff_t)len_b - lag : (ptrdiff_t)len_a;
+        double value;
+
+        if ((size_t)(hi - lo) * MIN_OVERLAP < shorter)
+            continue;
+
+        value = creal(fa[(size_t)(lag + (ptrdiff_t)n) & (n - 1)]);
+
+        if (value > best)
+        {
+            best = value;
+            best_lag = lag;
+        }
+    }
+
+    if (best > -INFINITY)
+    {
+        double fraction = 0;
+        double left = creal(fa[(size_t)(best_lag - 1 + (ptrdiff_t)n) & (n - 1)]);
+        double right = creal(fa[(size_t)(best_lag + 1 + (ptrdiff_t)n) & (n - 1)]);
+        double curve = left - 2 * best + right;
+
+        // Parabola through the peak and its neighbours for the fraction of a bin
+        if (curve < 0)
+            fraction = 0.5 * (left - right) / curve;
+
+        offset = origin_b - origin_a + (best_lag + fraction) / BINS_PER_TACH;
+        *score = (energy_a > 0 && energy_b > 0) ? best / (n * sqrt(energy_a * energy_b)) : 0;
+    }
+
+    free(fa);
+    free(fb);
+
+    return offset;
+}
+
+/* Fine alignment */
+
+static float sum_squares(const float *a, const float *b, size_t n)
+{
+    float sum = 0;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    __m256 acc = _mm256_setzero_ps();
+    __m128 half;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(d, d));
+    }
+
+    half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#elif defined(__SSE__)
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+    }
+
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#endif
+
+    for (; i < n; i++)
+    {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+
+    return sum;
+}
+
+/* First transition at or after pos */
+static size_t lower_bound(const track_data_t *data, double pos)
+{
+    size_t lo = 0;
+    size_t hi = data->count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (data->pos[mid] < pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/*
+ * Lag into b, within _g_radius transitions of the tach estimate, where
+ * the n intervals of a at i best match. Returns the rms difference.
+ */
+static double fine_match(const track_data_t *a, size_t i, size_t n, const track_data_t *b, size_t j)
+{
+    size_t lo = j > _g_radius ? j - _g_radius : 0;
+    size_t hi = j + _g_radius;
+    float best = INFINITY;
+
+    if (hi + n > b->count)
+        hi = b->count >= n ? b->count - n : 0;
+
+    for (j = lo; j <= hi && j + n <= b->count; j++)
+    {
+        float sum = sum_squares(a->interval + i, b->interval + j, n);
+
+        if (sum < best)
+            best = sum;
+    }
+
+    return sqrtf(best / n);
+}
+
+static void report_region(const region_t *region, unsigned int track, double offset)
+{
+    printf("%u,%.2f,%.2f,%.2f,%u,%+.1f,%.1f\n", track, region->first, region->last + 1,
+        region->first + offset, region->windows, region->density * 100, region->timing * 100);
+}
+
+static int diff_track(const char *path_a, const char *path_b, unsigned int track)
+{
+    track_data_t a;
+    track_data_t b;
+    region_t region;
+    double offset;
+    double score = 0;
+    uint32_t compared = 0;
+    uint32_t regions = 0;
+    bool open_region = false;
+    size_t i;
+    int k;
+
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+
+    if (load(&a, path_a, track) < 0 || load(&b, path_b, track) < 0)
+    {
+        fprintf(stderr, "tapediff: track %u: not in both captures, or fewer than two tach pulses\n", track);
+        release(&a);
+        release(&b);
+        return -1;
+    }
+
+    offset = coarse_offset(&a, &b, &score);
+
+    if (isnan(offset))
+    {
+        fprintf(stderr, "tapediff: track %u: captures do not overlap\n", track);
+        release(&a);
+        release(&b);
+        return -1;
+    }
+
+    fprintf(stderr, "tapediff: track %u: %u/%u tach, speed %.4f (b/a), offset %+.3f tach, correlation %.2f\n",
+        track, a.tach_count, b.tach_count, a.tach_period / b.tach_period, offset, score);
+
+    for (k = (int)ceil(a.pos[0]), i = lower_bound(&a, k); k + 1 <= a.pos[a.count - 1]; k++)
+    {
+        size_t end = i;
+        size_t j;
+        size_t j_end;
+        double change;
+        double timing;
+        double mean = 0;
+
+        while (end < a.count && a.pos[end] < k + 1)
+            mean += a.interval[end++];
+
+        // Only windows that lie wholly inside b
+        if (k + offset < b.pos[0] || k + 1 + offset > b.pos[b.count - 1] || end == i)
+        {
+            i = end;
+            continue;
+        }
+
+        j = lower_bound(&b, k + offset);
+        j_end = lower_bound(&b, k + 1 + offset);
+
+        change = ((double)(j_end - j) - (double)(end - i)) / (end - i);
+        timing = fine_match(&a, i, end - i, &b, j) / (mean / (end - i));
+        compared++;
+
+        if (_g_windows)
+            printf("%u,%d,%.2f,%zu,%zu,%+.1f,%.1f\n", track, k, k + offset, end - i, j_end - j,
+                change * 100, timing * 100);
+
+        if (fabs(change) > _g_density_limit || timing > _g_timing_limit)
+        {
+            if (!open_region)
+            {
+                memset(&region, 0, sizeof(region));
+                region.first = k;
+                open_region = true;
+                regions++;
+            }
+
+            region.last = k;
+            region.windows++;
+
+            if (fabs(change) > fabs(region.density))
+                region.density = change;
+
+            if (timing > region.timing)
+                region.timing = timing;
+        }
+        else if (open_region)
+        {
+            if (!_g_windows)
+                report_region(&region, track, offset);
+
+            open_region = false;
+        }
+
+        i = end;
+    }
+
+    if (open_region && !_g_windows)
+        report_region(&region, track, offset);
+
+    fprintf(stderr, "tapediff: track %u: %u windows compared, %u changed regions\n", track, compared, regions);
+
+    release(&a);
+    release(&b);
+
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: tapediff [-t track] [-d density%%] [-s timing%%] [-r radius] [-w] a.tcap b.tcap\n"
+        "\t-t\ttrack to compare, default every track of the first capture\n"
+        "\t-d\tflag a change in transitions per tach window over this, default 5\n"
+        "\t-s\tflag an rms interval difference over this share of the mean, default 10\n"
+        "\t-r\tfine search either side of the tach estimate, in transitions, default 32\n"
+        "\t-w\tlist every tach window rather than the changed regions\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int tracks[MAX_TRACKS];
+    int track_count = 0;
+    int failed = 0;
+    int opt;
+    int t;
+
+    while ((opt = getopt(argc, argv, "t:d:s:r:w")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                tracks[0] = (unsigned int)atoi(optarg);
+                track_count = 1;
+                break;
+            case 'd':
+                _g_density_limit = atof(optarg) / 100;
+                break;
+            case 's':
+                _g_timing_limit = atof(optarg) / 100;
+                break;
+            case 'r':
+                _g_radius = (size_t)atol(optarg);
+                break;
+            case 'w':
+                _g_windows = true;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind != argc - 2)
+        usage();
+
+    if (!track_count)
+    {
+        track_count = list_tracks(argv[optind], tracks);
+
+        if (track_count < 0)
+        {
+            fprintf(stderr, "tapediff: %s: not a capture\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    if (_g_windows)
+        printf("track,tach_a,tach_b,transitions_a,transitions_b,density_pct,timing_pct\n");
+    else
+        printf("track,tach_a_from,tach_a_to,tach_b_from,windows,density_pct,timing_pct\n");
+
+    for (t = 0; t < track_count; t++)
+    {
+        if (diff_track(argv[optind], argv[optind + 1], tracks[t]) < 0)
+            failed++;
+    }
+
+    return failed ? 1 : 0;
+}
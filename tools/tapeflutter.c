@@ -0,0 +1,593 @@
+/*
+ * File:   tapeflutter.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:02
+ *
+ * Wow and flutter from the tach edge frames the controller sends with
+ * 'tachstream 1'. Each input is the raw byte stream of one drive, for
+ * instance read from its tapemux socket; text, status frames and line
+ * noise between the frames are skipped.
+ *
+ * Edge timestamps are differenced into intervals and cut into runs at
+ * speed: a run ends at a lost edge, a missing frame, a reversal, or an
+ * interval more than STEADY_TOLERANCE from the run's median, which drops
+ * the motor ramps. The speed deviation over each run (mean interval over
+ * interval, less one) is treated as sampled once per tach edge.
+ *
+ * Per drive and direction that deviation is averaged into a power
+ * spectrum (Welch: Hann windowed blocks, half overlapped). From it come
+ * the unweighted wow and flutter, the weighted rms through a 4 Hz
+ * band-pass that approximates the IEC 60386 curve, and the strongest
+ * periodic components with their period in tach edges, which is what
+ * ties a component to the capstan or a reel. Every figure is an rms
+ * percentage of speed.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <complex.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#define SYNC0               0xA5
+#define SYNC1_STATUS        0x5A
+#define SYNC1_TACH          0x5B
+#define STATUS_SIZE         16
+#define TACH_SIZE           32
+#define TACH_STAMPS         12
+#define FLAG_REV            0x01
+#define FLAG_LOST           0x02
+
+#define TIMER1_HZ           1536000 /* 49.152 MHz / 4 / prescale 8 */
+#define STEADY_TOLERANCE    0.2     /* of the run median, beyond which an interval ends a run */
+#define STEADY_TRIM         16      /* edges dropped from each end of a run */
+#define MEDIAN_EDGES        64      /* intervals the run median is taken over */
+#define WEIGHT_HZ           4.0
+#define WEIGHT_Q            0.6
+#define WOW_FLUTTER_HZ      6.0     /* wow below, flutter above */
+#define PEAK_PROMINENCE     8.0     /* a component stands this far above the median bin */
+#define MAX_PEAKS           16
+
+typedef struct {
+    uint64_t edges;
+    uint64_t runs;
+    double interval_sum;            /* Timer1 counts, over analysed edges */
+    uint64_t blocks;
+    double *power;                  /* per bin, summed over blocks */
+} direction_t;
+
+typedef struct {
+    const char *name;
+    direction_t dir[2];             /* forward, reverse */
+    uint64_t frames;
+    uint64_t bad;                   /* sync found but CRC wrong */
+    uint64_t lost;                  /* breaks from lost edges or frames */
+
+    // Edges of the run being gathered
+    uint32_t *run;
+    size_t run_count;
+    size_t run_room;
+    int run_dir;
+    bool have_last;
+    uint16_t last_stamp;
+    uint8_t last_sequence;
+} drive_t;
+
+static size_t _g_block = 1024;
+static int _g_peaks = 3;
+static uint32_t _g_timer_hz = TIMER1_HZ;
+
+static double *_g_window;
+static double _g_window_power;
+static double complex *_g_fft;
+
+static uint16_t crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc;
+}
+
+static void fft(double complex *x, size_t n)
+{
+    size_t i;
+    size_t j;
+    size_t len;
+
+    for (i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+
+        j ^= bit;
+
+        if (i < j)
+        {
+            double complex t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1)
+    {
+        double complex step = cexp(-2 * M_PI * I / len);
+
+        for (i = 0; i < n; i += len)
+        {
+            double complex w = 1;
+
+            for (j = 0; j < len / 2; j++)
+            {
+                double complex u = x[i + j];
+                double complex v = x[i + j + len / 2] * w;
+
+                x[i + j] = u + v;
+                x[i + j + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* One block of intervals into the direction's spectrum */
+static void add_block(direction_t *dir, const uint32_t *interval)
+{
+    double mean = 0;
+    double dev_mean = 0;
+    size_t half = _g_block / 2;
+    size_t i;
+
+    for (i = 0; i < _g_block; i++)
+        mean += interval[i];
+
+    mean /= _g_block;
+
+    for (i = 0; i < _g_block; i++)
+    {
+        _g_fft[i] = mean / interval[i] - 1;
+        dev_mean += creal(_g_fft[i]);
+    }
+
+    dev_mean /= _g_block;
+
+    for (i = 0; i < _g_block; i++)
+        _g_fft[i] = (_g_fft[i] - dev_mean) * _g_window[i];
+
+    fft(_g_fft, _g_block);
+
+    // One sided, scaled so the bins sum to the variance
+    for (i = 1; i <= half; i++)
+    {
+        double p = creal(_g_fft[i]) * creal(_g_fft[i]) + cimag(_g_fft[i]) * cimag(_g_fft[i]);
+        dir->power[i] += (i == half ? 1 : 2) * p / (_g_block * _g_window_power);
+    }
+
+    dir->blocks++;
+}
+
+/* Splits a run into steady stretches and feeds them in blocks */
+static void end_run(drive_t *drive)
+{
+    direction_t *dir = &drive->dir[drive->run_dir];
+    uint32_t sorted[MEDIAN_EDGES];
+    size_t start = 0;
+
+    while (start < drive->run_count)
+    {
+        size_t take = drive->run_count - start < MEDIAN_EDGES ? drive->run_count - start : MEDIAN_EDGES;
+        size_t end;
+        double median;
+
+        // The median of the first edges sets the speed for the stretch
+        memcpy(sorted, drive->run + start, take * sizeof(uint32_t));
+        qsort(sorted, take, sizeof(uint32_t), compare_u32);
+        median = sorted[take / 2];
+
+        if (fabs(drive->run[start] / median - 1) > STEADY_TOLERANCE)
+        {
+            start++;
+            continue;
+        }
+
+        for (end = start; end < drive->run_count; end++)
+        {
+            if (fabs(drive->run[end] / median - 1) > STEADY_TOLERANCE)
+                break;
+        }
+
+        if (end - start >= _g_block + 2 * STEADY_TRIM)
+        {
+            size_t first = start + STEADY_TRIM;
+            size_t last = end - STEADY_TRIM;
+            size_t i;
+
+            for (i = first; i < last; i++)
+                dir->interval_sum += drive->run[i];
+
+            dir->edges += last - first;
+            dir->runs++;
+
+            for (i = first; i + _g_block <= last; i += _g_block / 2)
+                add_block(dir, drive->run + i);
+        }
+
+        start = end;
+    }
+
+    drive->run_count = 0;
+}
+
+static int add_interval(drive_t *drive, uint32_t interval)
+{
+    if (drive->run_count == drive->run_room)
+    {
+        size_t room = drive->run_room ? drive->run_room * 2 : 65536;
+        uint32_t *p = realloc(drive->run, room * sizeof(uint32_t));
+
+        if (!p)
+            return -1;
+
+        drive->run = p;
+        drive->run_room = room;
+    }
+
+    drive->run[drive->run_count++] = interval;
+    return 0;
+}
+
+static int tach_frame(drive_t *drive, const uint8_t *frame)
+{
+    int dir = (frame[5] & FLAG_REV) ? 1 : 0;
+    int i;
+
+    // Anything that breaks the chain of edges ends the run
+    if (!drive->have_last || (frame[5] & FLAG_LOST) || frame[2] != (uint8_t)(drive->last_sequence + 1) ||
+            dir != drive->run_dir)
+    {
+        if (drive->have_last && (frame[5] & FLAG_LOST || frame[2] != (uint8_t)(drive->last_sequence + 1)))
+            drive->lost++;
+
+        end_run(drive);
+        drive->run_dir = dir;
+        drive->have_last = false;
+    }
+
+    for (i = 0; i < TACH_STAMPS; i++)
+    {
+        uint16_t stamp = (uint16_t)(frame[6 + i * 2] | (frame[7 + i * 2] << 8));
+
+        if (drive->have_last && add_interval(drive, (uint16_t)(stamp - drive->last_stamp)) < 0)
+            return -1;
+
+        drive->last_stamp = stamp;
+        drive->have_last = true;
+    }
+
+    drive->last_sequence = frame[2];
+    drive->frames++;
+
+    return 0;
+}
+
+static int read_drive(drive_t *drive, const char *path)
+{
+    uint8_t buf[65536];
+    size_t len = 0;
+    size_t pos = 0;
+    size_t n;
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp)
+        return -1;
+
+    for (;;)
+    {
+        n = fread(buf + len, 1, sizeof(buf) - len, fp);
+        len += n;
+
+        while (pos + 2 <= len)
+        {
+            size_t size;
+
+            if (buf[pos] != SYNC0 || (buf[pos + 1] != SYNC1_STATUS && buf[pos + 1] != SYNC1_TACH))
+            {
+                pos++;
+                continue;
+            }
+
+            size = buf[pos + 1] == SYNC1_TACH ? TACH_SIZE : STATUS_SIZE;
+
+            if (pos + size > len)
+                break;
+
+            if (crc16(buf + pos, size - 2) != (buf[pos + size - 2] | (buf[pos + size - 1] << 8)))
+            {
+                drive->bad++;
+                pos++;
+                continue;
+            }
+
+            if (size == TACH_SIZE && tach_frame(drive, buf + pos) < 0)
+            {
+                fclose(fp);
+                return -1;
+            }
+
+            pos += size;
+        }
+
+        if (!n)
+            break;
+
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+        pos = 0;
+    }
+
+    fclose(fp);
+    end_run(drive);
+
+    return 0;
+}
+
+static double weight(double f)
+{
+    double x = f / WEIGHT_HZ - WEIGHT_HZ / f;
+
+    return 1 / (1 + WEIGHT_Q * WEIGHT_Q * x * x);   /* squared, for power */
+}
+
+static void report(const drive_t *drive, int d)
+{
+    const direction_t *dir = &drive->dir[d];
+    size_t half = _g_block / 2;
+    double hz;
+    double bin_hz;
+    double total = 0;
+    double wow = 0;
+    double flutter = 0;
+    double weighted = 0;
+    double median;
+    double *sorted;
+    size_t peaks[MAX_PEAKS];
+    int found = 0;
+    size_t i;
+    int p;
+
+    if (!dir->blocks)
+    {
+        printf("%s,%s,%llu,,,,,,", drive->name, d ? "rev" : "fwd", (unsigned long long)dir->edges);
+
+        for (p = 0; p < _g_peaks; p++)
+            printf(",,,");
+
+        printf("\n");
+        return;
+    }
+
+    // Edges are the samples, so the sample rate is the mean tach rate
+    hz = _g_timer_hz / (dir->interval_sum / dir->edges);
+    bin_hz = hz / _g_block;
+
+    for (i = 1; i <= half; i++)
+    {
+        double p_i = dir->power[i] / dir->blocks;
+        double f = i * bin_hz;
+
+        total += p_i;
+        weighted += p_i * weight(f);
+
+        if (f < WOW_FLUTTER_HZ)
+            wow += p_i;
+        else
+            flutter += p_i;
+    }
+
+    // Components: local maxima well above the noise floor, strongest first
+    sorted = malloc(half * sizeof(double));
+    if (sorted)
+    {
+        memcpy(sorted, dir->power + 1, half * sizeof(double));
+
+        for (i = 1; i < half; i++)
+        {
+            double v = sorted[i];
+            size_t j = i;
+
+            for (; j > 0 && sorted[j - 1] > v; j--)
+                sorted[j] = sorted[j - 1];
+
+            sorted[j] = v;
+        }
+
+        median = sorted[half / 2];
+        free(sorted);
+    }
+    else
+    {
+        median = 0;
+    }
+
+    while (found < _g_peaks)
+    {
+        size_t best = 0;
+
+        for (i = 2; i < half; i++)
+        {
+            bool near = false;
+
+            if (dir->power[i] < dir->power[i - 1] || dir->power[i] < dir->power[i + 1])
+                continue;
+
+            if (dir->power[i] < PEAK_PROMINENCE * median)
+                continue;
+
+            for (p = 0; p < found; p++)
+            {
+                if ((i > peaks[p] ? i - peaks[p] : peaks[p] - i) <= 2)
+                    near = true;
+            }
+
+            if (!near && (!best || dir->power[i] > dir->power[best]))
+                best = i;
+        }
+
+        if (!best)
+            break;
+
+        peaks[found++] = best;
+    }
+
+    printf("%s,%s,%llu,%llu,%.2f,%.4f,%.4f,%.4f,%.4f", drive->name, d ? "rev" : "fwd",
+        (unsigned long long)dir->edges, (unsigned long long)dir->runs, hz,
+        sqrt(total) * 100, sqrt(weighted) * 100, sqrt(wow) * 100, sqrt(flutter) * 100);
+
+    for (p = 0; p < _g_peaks; p++)
+    {
+        if (p < found)
+        {
+            size_t k = peaks[p];
+            double a = dir->power[k - 1];
+            double b = dir->power[k];
+            double c = dir->power[k + 1];
+            double curve = a - 2 * b + c;
+            double offset = curve < 0 ? 0.5 * (a - c) / curve : 0;
+            double f = (k + offset) * bin_hz;
+
+            // The Hann main lobe spreads a tone over three bins
+            printf(",%.2f,%.1f,%.4f", f, hz / f, sqrt((a + b + c) / dir->blocks) * 100);
+        }
+        else
+        {
+            printf(",,,");
+        }
+    }
+
+    printf("\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: tapeflutter [-n block] [-k peaks] [-c timer_hz] drive.bin...\n"
+        "\t-n\tedges per FFT block, a power of two, default 1024\n"
+        "\t-k\tperiodic components listed per drive and direction, default 3\n"
+        "\t-c\ttimestamp clock, default %u Hz\n"
+        "Each file is the raw serial output of one drive with 'tachstream 1'.\n",
+        TIMER1_HZ);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    int opt;
+    int i;
+    int p;
+    size_t n;
+
+    while ((opt = getopt(argc, argv, "n:k:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                _g_block = (size_t)atol(optarg);
+                break;
+            case 'k':
+                _g_peaks = atoi(optarg);
+                break;
+            case 'c':
+                _g_timer_hz = (uint32_t)atol(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind >= argc || _g_block < 16 || (_g_block & (_g_block - 1)) ||
+            _g_peaks < 0 || _g_peaks > MAX_PEAKS || !_g_timer_hz)
+        usage();
+
+    _g_window = malloc(_g_block * sizeof(double));
+    _g_fft = malloc(_g_block * sizeof(double complex));
+
+    if (!_g_window || !_g_fft)
+    {
+        perror("tapeflutter: malloc");
+        return 1;
+    }
+
+    for (n = 0; n < _g_block; n++)
+    {
+        _g_window[n] = 0.5 - 0.5 * cos(2 * M_PI * n / _g_block);
+        _g_window_power += _g_window[n] * _g_window[n];
+    }
+
+    printf("drive,direction,edges,runs,tach_hz,total_pct,wrms_pct,wow_pct,flutter_pct");
+
+    for (p = 1; p <= _g_peaks; p++)
+        printf(",peak%d_hz,peak%d_tach,peak%d_pct", p, p, p);
+
+    printf("\n");
+
+    for (i = optind; i < argc; i++)
+    {
+        drive_t drive;
+        char path[4096];
+
+        memset(&drive, 0, sizeof(drive));
+        snprintf(path, sizeof(path), "%s", argv[i]);
+        drive.name = basename(path);
+        drive.dir[0].power = calloc(_g_block / 2 + 1, sizeof(double));
+        drive.dir[1].power = calloc(_g_block / 2 + 1, sizeof(double));
+
+        if (!drive.dir[0].power || !drive.dir[1].power || read_drive(&drive, argv[i]) < 0)
+        {
+            fprintf(stderr, "tapeflutter: %s: %s\n", argv[i], strerror(errno));
+            failed++;
+        }
+        else
+        {
+            report(&drive, 0);
+            report(&drive, 1);
+
+            fprintf(stderr, "tapeflutter: %s: %llu frames, %llu bad, %llu breaks\n", drive.name,
+                (unsigned long long)drive.frames, (unsigned long long)drive.bad,
+                (unsigned long long)drive.lost);
+        }
+
+        free(drive.dir[0].power);
+        free(drive.dir[1].power);
+        free(drive.run);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,612 @@
+/*
+ * File:   tapemux.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:50
+ *
+ * Host side multiplexer for a rack of tape exerciser controllers.
+ *
+ * Every serial device named on the command line gets:
+ *
+ *   <rundir>/<name>.pty   symlink to a pseudo terminal for a terminal program
+ *   <rundir>/<name>.sock  Unix stream socket for automation clients
+ *   <logdir>/<name>.log   everything the device sent, each line timestamped
+ *
+ * Anything typed on the PTY or written by a socket client goes to the
+ * device; everything the device sends goes to the PTY, every client and
+ * the log. One thread drives it all from a single epoll set. Nothing
+ * blocks: output that cannot be written yet waits in a per endpoint ring
+ * and is dropped (and counted) if that ring fills, so one stalled client
+ * never holds up a device or another client. Clients coming and going
+ * are reported on stderr, with what each one had dropped.
+ *
+ * Any path that takes termios settings works as a device, so a pair of
+ * pseudo terminals (socat -d -d pty,raw pty,raw) stands in for hardware.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define MAX_DEVICES         64
+#define MAX_CLIENTS         8       /* per device */
+#define RING_SIZE           65536   /* per endpoint, power of two */
+#define READ_CHUNK          4096
+#define MAX_EVENTS          64
+
+#define EP_DEVICE           0
+#define EP_PTY              1
+#define EP_LISTEN           2
+#define EP_CLIENT           3
+
+typedef struct {
+    uint8_t data[RING_SIZE];
+    size_t head;            /* next byte out */
+    size_t len;
+    unsigned long dropped;
+} ring_t;
+
+struct device;
+
+typedef struct {
+    int type;
+    int fd;
+    struct device *dev;
+    ring_t *out;            /* bytes waiting to be written to fd */
+    bool want_out;          /* EPOLLOUT currently requested */
+} endpoint_t;
+
+typedef struct device {
+    char name[64];
+    char path[PATH_MAX];
+    char pty_link[PATH_MAX];
+    char sock_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    endpoint_t device;
+    endpoint_t pty;
+    endpoint_t listen;
+    endpoint_t clients[MAX_CLIENTS];
+    int pty_slave;          /* held open so the master never sees EIO */
+    FILE *log;
+    bool line_start;
+    unsigned long long rx_bytes;
+} device_t;
+
+static device_t _g_devices[MAX_DEVICES];
+static int _g_device_count;
+static int _g_epoll;
+static volatile sig_atomic_t _g_quit;
+
+static void fatal(const char *what, const char *name)
+{
+    fprintf(stderr, "tapemux: %s%s%s: %s\n", what, name ? " " : "", name ? name : "", strerror(errno));
+    exit(1);
+}
+
+static speed_t baud_to_speed(long baud)
+{
+    switch (baud)
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 921600:    return B921600;
+        default:        return 0;
+    }
+}
+
+static void set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        fatal("fcntl", NULL);
+}
+
+static void set_raw(int fd, speed_t speed)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) < 0)
+        return;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    if (speed)
+    {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+static ring_t *ring_new(void)
+{
+    ring_t *ring = calloc(1, sizeof(*ring));
+
+    if (!ring)
+        fatal("calloc", NULL);
+
+    return ring;
+}
+
+/* Queues what fits and counts the rest as dropped */
+static void ring_put(ring_t *ring, const uint8_t *data, size_t len)
+{
+    size_t room = RING_SIZE - ring->len;
+    size_t tail;
+
+    if (len > room)
+    {
+        ring->dropped += len - room;
+        len = room;
+    }
+
+    tail = (ring->head + ring->len) & (RING_SIZE - 1);
+
+    while (len)
+    {
+        size_t chunk = RING_SIZE - tail;
+
+        if (chunk > len)
+            chunk = len;
+
+        memcpy(&ring->data[tail], data, chunk);
+        ring->len += chunk;
+        data += chunk;
+        len -= chunk;
+        tail = (tail + chunk) & (RING_SIZE - 1);
+    }
+}
+
+static void ep_watch(endpoint_t *ep, bool add)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | (ep->want_out ? EPOLLOUT : 0);
+    ev.data.ptr = ep;
+
+    if (epoll_ctl(_g_epoll, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, ep->fd, &ev) < 0)
+        fatal("epoll_ctl", ep->dev->name);
+}
+
+static void ep_close(endpoint_t *ep)
+{
+    if (ep->fd < 0)
+        return;
+
+    epoll_ctl(_g_epoll, EPOLL_CTL_DEL, ep->fd, NULL);
+    close(ep->fd);
+    ep->fd = -1;
+
+    if (ep->out)
+    {
+        ep->out->head = 0;
+        ep->out->len = 0;
+    }
+
+    ep->want_out = false;
+}
+
+/* Closes a client and reports it, with anything it could not keep up with */
+static void client_close(endpoint_t *ep, const char *why)
+{
+    device_t *dev = ep->dev;
+
+    fprintf(stderr, "tapemux: %s: client %d disconnected (%s), %lu bytes dropped\n",
+        dev->name, (int)(ep - dev->clients), why, ep->out->dropped);
+    ep_close(ep);
+}
+
+/* Writes as much of the ring as the fd takes now; asks for EPOLLOUT for the rest */
+static void ep_flush(endpoint_t *ep)
+{
+    ring_t *ring = ep->out;
+    bool want;
+
+    while (ring->len)
+    {
+        size_t chunk = RING_SIZE - ring->head;
+        ssize_t n;
+
+        if (chunk > ring->len)
+            chunk = ring->len;
+
+        n = write(ep->fd, &ring->data[ring->head], chunk);
+
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                break;
+
+            // A client that went away is closed; a device error is fatal
+            if (ep->type == EP_CLIENT)
+            {
+                client_close(ep, strerror(errno));
+                return;
+            }
+
+            if (ep->type == EP_PTY && errno == EIO)
+            {
+                ring->len = 0;
+                break;
+            }
+
+            fatal("write", ep->dev->name);
+        }
+
+        ring->head = (ring->head + n) & (RING_SIZE - 1);
+        ring->len -= n;
+    }
+
+    if (!ring->len)
+        ring->head = 0;
+
+    want = ring->len != 0;
+
+    if (want != ep->want_out)
+    {
+        ep->want_out = want;
+        ep_watch(ep, false);
+    }
+}
+
+static void ep_send(endpoint_t *ep, const uint8_t *data, size_t len)
+{
+    if (ep->fd < 0)
+        return;
+
+    ring_put(ep->out, data, len);
+    ep_flush(ep);
+}
+
+static void log_output(device_t *dev, const uint8_t *data, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (dev->line_start)
+        {
+            struct timeval tv;
+            struct tm tm;
+            char stamp[32];
+
+            gettimeofday(&tv, NULL);
+            localtime_r(&tv.tv_sec, &tm);
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+            fprintf(dev->log, "%s.%03ld ", stamp, (long)(tv.tv_usec / 1000));
+            dev->line_start = false;
+        }
+
+        // The controller ends lines with \r\n; \r alone is dropped from the log
+        if (data[i] == '\r')
+            continue;
+
+        fputc(data[i], dev->log);
+
+        if (data[i] == '\n')
+            dev->line_start = true;
+    }
+
+    fflush(dev->log);
+}
+
+static void device_input(device_t *dev)
+{
+    uint8_t buf[READ_CHUNK];
+    ssize_t n;
+    int i;
+
+    // Read until drained so a busy port cannot starve the others for long
+    while ((n = read(dev->device.fd, buf, sizeof(buf))) > 0)
+    {
+        dev->rx_bytes += n;
+
+        ep_send(&dev->pty, buf, n);
+
+        for (i = 0; i < MAX_CLIENTS; i++)
+            ep_send(&dev->clients[i], buf, n);
+
+        log_output(dev, buf, n);
+    }
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        fprintf(stderr, "tapemux: %s: device closed\n", dev->name);
+        ep_close(&dev->device);
+    }
+}
+
+/* PTY and client input both go straight to the device */
+static void to_device(endpoint_t *ep)
+{
+    uint8_t buf[READ_CHUNK];
+    ssize_t n;
+
+    while ((n = read(ep->fd, buf, sizeof(buf))) > 0)
+        ep_send(&ep->dev->device, buf, n);
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR && errno != EIO))
+    {
+        if (ep->type == EP_CLIENT)
+            client_close(ep, n == 0 ? "closed" : strerror(errno));
+    }
+}
+
+static void accept_client(device_t *dev)
+{
+    int fd;
+    int i;
+
+    while ((fd = accept4(dev->listen.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        for (i = 0; i < MAX_CLIENTS; i++)
+        {
+            if (dev->clients[i].fd < 0)
+                break;
+        }
+
+        if (i == MAX_CLIENTS)
+        {
+            fprintf(stderr, "tapemux: %s: too many clients\n", dev->name);
+            close(fd);
+            continue;
+        }
+
+        dev->clients[i].fd = fd;
+        dev->clients[i].want_out = false;
+        dev->clients[i].out->dropped = 0;
+        ep_watch(&dev->clients[i], true);
+
+        fprintf(stderr, "tapemux: %s: client %d connected\n", dev->name, i);
+    }
+}
+
+static void endpoint_init(endpoint_t *ep, device_t *dev, int type, int fd)
+{
+    ep->type = type;
+    ep->fd = fd;
+    ep->dev = dev;
+    ep->out = ring_new();
+    ep->want_out = false;
+}
+
+static void device_open(device_t *dev, const char *path, speed_t speed, const char *rundir, const char *logdir)
+{
+    char tmp[PATH_MAX];
+    char log_path[PATH_MAX];
+    struct sockaddr_un addr;
+    const char *name;
+    int fd;
+    int i;
+
+    snprintf(dev->path, sizeof(dev->path), "%s", path);
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    name = basename(tmp);
+    snprintf(dev->name, sizeof(dev->name), "%s", name);
+    dev->line_start = true;
+
+    // Serial device
+    fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        fatal("open", path);
+
+    set_raw(fd, speed);
+    endpoint_init(&dev->device, dev, EP_DEVICE, fd);
+
+    // PTY for a terminal program
+    fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0)
+        fatal("posix_openpt", dev->name);
+
+    dev->pty_slave = open(ptsname(fd), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (dev->pty_slave < 0)
+        fatal("open", ptsname(fd));
+
+    set_raw(dev->pty_slave, 0);
+    set_nonblock(fd);
+    endpoint_init(&dev->pty, dev, EP_PTY, fd);
+
+    snprintf(dev->pty_link, sizeof(dev->pty_link), "%s/%s.pty", rundir, name);
+    unlink(dev->pty_link);
+    if (symlink(ptsname(fd), dev->pty_link) < 0)
+        fatal("symlink", dev->pty_link);
+
+    // Socket for automation clients
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        fatal("socket", dev->name);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ((size_t)snprintf(dev->sock_path, sizeof(dev->sock_path), "%s/%s.sock", rundir, name) >= sizeof(dev->sock_path))
+    {
+        errno = ENAMETOOLONG;
+        fatal("socket path", dev->name);
+    }
+
+    memcpy(addr.sun_path, dev->sock_path, sizeof(addr.sun_path));
+    unlink(dev->sock_path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, MAX_CLIENTS) < 0)
+        fatal("bind", dev->sock_path);
+
+    endpoint_init(&dev->listen, dev, EP_LISTEN, fd);
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+        endpoint_init(&dev->clients[i], dev, EP_CLIENT, -1);
+
+    // Log
+    snprintf(log_path, sizeof(log_path), "%s/%s.log", logdir, name);
+    dev->log = fopen(log_path, "a");
+    if (!dev->log)
+        fatal("fopen", log_path);
+
+    ep_watch(&dev->device, true);
+    ep_watch(&dev->pty, true);
+    ep_watch(&dev->listen, true);
+
+    printf("%s: pty %s socket %s log %s\n", dev->name, dev->pty_link, dev->sock_path, log_path);
+}
+
+static void device_close(device_t *dev)
+{
+    int i;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (dev->clients[i].fd >= 0)
+            client_close(&dev->clients[i], "shutting down");
+    }
+
+    ep_close(&dev->listen);
+    ep_close(&dev->pty);
+    ep_close(&dev->device);
+    close(dev->pty_slave);
+
+    unlink(dev->sock_path);
+    unlink(dev->pty_link);
+
+    fprintf(stderr, "tapemux: %s: %llu bytes in, %lu dropped to the pty\n",
+        dev->name, dev->rx_bytes, dev->pty.out->dropped);
+
+    fclose(dev->log);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    _g_quit = 1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: tapemux [-b baud] [-r rundir] [-l logdir] device...\n"
+        "\t-b\tserial speed, default 9600\n"
+        "\t-r\twhere the .pty links and .sock sockets go, default .\n"
+        "\t-l\twhere the .log files go, default .\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct sigaction sa;
+    const char *rundir = ".";
+    const char *logdir = ".";
+    speed_t speed = B9600;
+    int opt;
+    int i;
+
+    while ((opt = getopt(argc, argv, "b:r:l:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                speed = baud_to_speed(atol(optarg));
+                if (!speed)
+                {
+                    fprintf(stderr, "tapemux: unsupported baud rate %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'r':
+                rundir = optarg;
+                break;
+            case 'l':
+                logdir = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind == argc || argc - optind > MAX_DEVICES)
+        usage();
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    _g_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (_g_epoll < 0)
+        fatal("epoll_create1", NULL);
+
+    for (i = optind; i < argc; i++)
+        device_open(&_g_devices[_g_device_count++], argv[i], speed, rundir, logdir);
+
+    fflush(stdout);
+
+    while (!_g_quit)
+    {
+        int n = epoll_wait(_g_epoll, events, MAX_EVENTS, -1);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            fatal("epoll_wait", NULL);
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            endpoint_t *ep = events[i].data.ptr;
+
+            if (ep->fd < 0)
+                continue;
+
+            if (events[i].events & EPOLLOUT)
+                ep_flush(ep);
+
+            if (ep->fd < 0 || !(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                continue;
+
+            switch (ep->type)
+            {
+                case EP_DEVICE:
+                    device_input(ep->dev);
+                    break;
+                case EP_LISTEN:
+                    accept_client(ep->dev);
+                    break;
+                default:
+                    to_device(ep);
+                    break;
+            }
+        }
+    }
+
+    for (i = 0; i < _g_device_count; i++)
+        device_close(&_g_devices[i]);
+
+    return 0;
+}
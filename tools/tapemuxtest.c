@@ -0,0 +1,224 @@
+/*
+ * File:   tapemuxtest.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 14:10
+ *
+ * Host check of tapemux. A pseudo terminal pair from openpty() stands in
+ * for the controller: tapemux is started on the slave and the check
+ * plays the device on the master. It must:
+ *  - relay device output to the PTY and to every attached client,
+ *  - relay PTY and client input to the device,
+ *  - keep relaying to the clients still attached after one detaches,
+ *    and report the detach on stderr,
+ *  - take a client that attaches later,
+ *  - exit cleanly on SIGTERM.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define TIMEOUT_MS      2000
+
+static int _g_failures;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("%s: FAILED\n", what);
+        _g_failures++;
+    }
+}
+
+/* Reads until 'expect' has arrived in full or the timeout passes */
+static bool receive(int fd, const char *expect)
+{
+    char buf[256];
+    size_t want = strlen(expect);
+    size_t got = 0;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    while (got < want && poll(&pfd, 1, TIMEOUT_MS) > 0)
+    {
+        ssize_t n = read(fd, buf + got, sizeof(buf) - 1 - got);
+
+        if (n <= 0)
+            break;
+        got += n;
+    }
+
+    buf[got] = '\0';
+    return got == want && !memcmp(buf, expect, want);
+}
+
+static bool send_all(int fd, const char *text)
+{
+    return write(fd, text, strlen(text)) == (ssize_t)strlen(text);
+}
+
+static int client_attach(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    return fd;
+}
+
+/* Waits for 'text' on tapemux's stderr after anything already matched */
+static bool reported(int fd, const char *text)
+{
+    static char log[4096];
+    static size_t len;
+    static size_t seen;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    char *found;
+
+    while (!(found = strstr(log + seen, text)) && len < sizeof(log) - 1 && poll(&pfd, 1, TIMEOUT_MS) > 0)
+    {
+        ssize_t n = read(fd, log + len, sizeof(log) - 1 - len);
+
+        if (n <= 0)
+            break;
+        len += n;
+        log[len] = '\0';
+    }
+
+    if (!found)
+        return false;
+
+    seen = (found - log) + strlen(text);
+    return true;
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/tapemuxtestXXXXXX";
+    char slave_name[64];
+    char sock_path[128];
+    char pty_path[128];
+    char name[64];
+    struct termios tio;
+    int errpipe[2];
+    int master, slave;
+    int pty, a, b;
+    int status;
+    pid_t pid;
+    int i;
+
+    if (!mkdtemp(dir) || openpty(&master, &slave, slave_name, NULL, NULL) < 0 || pipe(errpipe) < 0)
+    {
+        perror("tapemuxtest");
+        return EXIT_FAILURE;
+    }
+
+    // Raw on the device side too, so bytes arrive as they were sent
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    pid = fork();
+    if (pid == 0)
+    {
+        dup2(errpipe[1], STDERR_FILENO);
+        close(errpipe[0]);
+        close(master);
+        execl("./tapemux", "tapemux", "-r", dir, "-l", dir, slave_name, (char *)NULL);
+        perror("./tapemux");
+        _exit(127);
+    }
+
+    close(errpipe[1]);
+    close(slave);
+
+    snprintf(name, sizeof(name), "%s", strrchr(slave_name, '/') + 1);
+    snprintf(sock_path, sizeof(sock_path), "%s/%s.sock", dir, name);
+    snprintf(pty_path, sizeof(pty_path), "%s/%s.pty", dir, name);
+
+    // tapemux prints its endpoints once they are all in place
+    for (i = 0; i < TIMEOUT_MS / 10 && access(sock_path, F_OK); i++)
+        usleep(10000);
+    usleep(50000);
+
+    pty = open(pty_path, O_RDWR | O_NOCTTY);
+    if (pty < 0)
+    {
+        perror(pty_path);
+        kill(pid, SIGTERM);
+        return EXIT_FAILURE;
+    }
+
+    a = client_attach(sock_path);
+    check(reported(errpipe[0], "client 0 connected"), "client 0 attach reported");
+
+    // Device to the PTY and the client
+    check(send_all(master, "Ready\r\n"), "device write");
+    check(receive(pty, "Ready\r\n"), "device to pty");
+    check(receive(a, "Ready\r\n"), "device to client 0");
+
+    // PTY and client to the device
+    check(send_all(pty, "show\r"), "pty write");
+    check(receive(master, "show\r"), "pty to device");
+    check(send_all(a, "run\r"), "client write");
+    check(receive(master, "run\r"), "client to device");
+
+    // A second client attaches, the first detaches
+    b = client_attach(sock_path);
+    check(reported(errpipe[0], "client 1 connected"), "client 1 attach reported");
+    close(a);
+    check(reported(errpipe[0], "client 0 disconnected (closed)"), "client 0 detach reported");
+
+    check(send_all(master, "Done\r\n"), "device write after detach");
+    check(receive(pty, "Done\r\n"), "device to pty after detach");
+    check(receive(b, "Done\r\n"), "device to client 1 after detach");
+
+    // A client attaching now takes the free slot and is served
+    a = client_attach(sock_path);
+    check(reported(errpipe[0], "client 0 connected"), "client 0 reattach reported");
+    check(send_all(a, "abort\r"), "reattached client write");
+    check(receive(master, "abort\r"), "reattached client to device");
+
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "clean exit on SIGTERM");
+    check(reported(errpipe[0], "disconnected (shutting down)"), "clients reported at shutdown");
+
+    close(a);
+    close(b);
+    close(pty);
+    close(master);
+
+    unlink(sock_path);
+    unlink(pty_path);
+    snprintf(pty_path, sizeof(pty_path), "%s/%s.log", dir, name);
+    unlink(pty_path);
+    rmdir(dir);
+
+    printf("%s\n", _g_failures ? "FAILED" : "passed");
+
+    return _g_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,685 @@
+/*
+ * File:   tapescan.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:53
+ *
+ * Batch analysis of a directory of .tcap captures into one CSV.
+ *
+ * Work is split per track. A worker first indexes a file (one sequential
+ * pass to find where each track starts and ends), then pushes a task per
+ * track onto its own deque. Workers take from the bottom of their own
+ * deque and steal from the top of others', so one long cartridge is
+ * spread over every core rather than tying one up.
+ *
+ * Memory stays bounded whatever the size of the capture set: the reader
+ * thread keeps only a fixed number of files open, every worker owns one
+ * fixed read buffer and histogram, and result rows go straight to the
+ * CSV as each track finishes.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "capture.h"
+
+#define DEQUE_SIZE          1024    /* power of two */
+#define MAX_TRACKS          64      /* per capture file */
+#define HIST_BIN_NS         100
+#define HIST_BINS           1024    /* up to 102.4 us, then one overflow bin */
+#define DROPOUT_FACTOR      4       /* an interval this many times the median */
+#define PEAK_MIN_SHARE      100     /* a peak holds at least 1/n of the intervals */
+
+#define TASK_INDEX          0
+#define TASK_TRACK          1
+
+typedef struct {
+    char path[PATH_MAX];
+    int fd;
+    uint32_t sample_hz;
+    atomic_int refs;        /* tasks still to run on this file */
+} capture_file_t;
+
+typedef struct {
+    int kind;
+    capture_file_t *file;
+    off_t start;
+    off_t end;
+    int track;
+} task_t;
+
+/* Owner pushes and pops at the bottom, thieves take from the top */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t top;
+    size_t bottom;
+    task_t tasks[DEQUE_SIZE];
+} deque_t;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    deque_t deque;
+    unsigned int seed;
+    capture_stream_t stream;
+    uint64_t hist[HIST_BINS + 1];
+} worker_t;
+
+typedef struct {
+    uint64_t transitions;
+    uint64_t tach;
+    uint64_t total_ns;
+    uint32_t p1, p50, p99;
+    uint32_t peaks[3];
+    uint64_t dropouts;
+    uint64_t dropout_ns;
+    double flux_per_tach_min;
+    double flux_per_tach_max;
+} track_result_t;
+
+static worker_t *_g_workers;
+static int _g_worker_count;
+
+static atomic_long _g_outstanding;     /* tasks queued or running */
+static atomic_long _g_queued;          /* tasks sitting in a deque */
+static atomic_int _g_producer_done;
+
+static pthread_mutex_t _g_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _g_idle_cond = PTHREAD_COND_INITIALIZER;
+static atomic_int _g_idle_waiters;
+
+static pthread_mutex_t _g_files_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _g_files_cond = PTHREAD_COND_INITIALIZER;
+static int _g_files_open;
+static int _g_files_limit;
+
+static pthread_mutex_t _g_csv_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *_g_csv;
+static atomic_long _g_tracks_done;
+static atomic_long _g_files_failed;
+
+static void wake_idle(bool all)
+{
+    if (!atomic_load(&_g_idle_waiters))
+        return;
+
+    pthread_mutex_lock(&_g_idle_lock);
+
+    if (all)
+        pthread_cond_broadcast(&_g_idle_cond);
+    else
+        pthread_cond_signal(&_g_idle_cond);
+
+    pthread_mutex_unlock(&_g_idle_lock);
+}
+
+static bool deque_push(deque_t *deque, const task_t *task)
+{
+    bool pushed = false;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom - deque->top < DEQUE_SIZE)
+    {
+        deque->tasks[deque->bottom++ & (DEQUE_SIZE - 1)] = *task;
+        pushed = true;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+
+    if (pushed)
+    {
+        atomic_fetch_add(&_g_queued, 1);
+        wake_idle(false);
+    }
+
+    return pushed;
+}
+
+static bool deque_pop(deque_t *deque, task_t *task, bool steal)
+{
+    bool popped = false;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom != deque->top)
+    {
+        if (steal)
+            *task = deque->tasks[deque->top++ & (DEQUE_SIZE - 1)];
+        else
+            *task = deque->tasks[--deque->bottom & (DEQUE_SIZE - 1)];
+
+        popped = true;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+
+    if (popped)
+        atomic_fetch_sub(&_g_queued, 1);
+
+    return popped;
+}
+
+/* Own deque first, then every other worker from a random starting point */
+static bool take_task(worker_t *self, task_t *task)
+{
+    int start;
+    int i;
+
+    if (deque_pop(&self->deque, task, false))
+        return true;
+
+    start = rand_r(&self->seed) % _g_worker_count;
+
+    for (i = 0; i < _g_worker_count; i++)
+    {
+        worker_t *victim = &_g_workers[(start + i) % _g_worker_count];
+
+        if (victim != self && deque_pop(&victim->deque, task, true))
+            return true;
+    }
+
+    return false;
+}
+
+static void file_release(capture_file_t *file)
+{
+    if (atomic_fetch_sub(&file->refs, 1) != 1)
+        return;
+
+    close(file->fd);
+    free(file);
+
+    pthread_mutex_lock(&_g_files_lock);
+    _g_files_open--;
+    pthread_cond_signal(&_g_files_cond);
+    pthread_mutex_unlock(&_g_files_lock);
+}
+
+static void task_done(void)
+{
+    // The last task after the reader has finished lets everyone go
+    if (atomic_fetch_sub(&_g_outstanding, 1) == 1 && atomic_load(&_g_producer_done))
+        wake_idle(true);
+}
+
+/* Pushed to this worker's deque, or run here and now if that is full */
+static void run_task(worker_t *self, task_t *task);
+
+static void submit(worker_t *self, const task_t *task)
+{
+    atomic_fetch_add(&_g_outstanding, 1);
+
+    if (!deque_push(&self->deque, task))
+    {
+        task_t copy = *task;
+        run_task(self, &copy);
+    }
+}
+
+static void index_file(worker_t *self, capture_file_t *file)
+{
+    capture_stream_t *stream = &self->stream;
+    off_t size = lseek(file->fd, 0, SEEK_END);
+    off_t start = 0;
+    int track = -1;
+    int tracks = 0;
+    uint32_t value;
+    int event;
+
+    capture_stream_init(stream, file->fd, CAPTURE_HEADER_SIZE, size);
+
+    while ((event = capture_next(stream, &value)) != CAPTURE_EV_EOF)
+    {
+        if (event == CAPTURE_EV_ERROR)
+        {
+            fprintf(stderr, "tapescan: %s: bad data at offset %lld\n", file->path, (long long)capture_tell(stream));
+            atomic_fetch_add(&_g_files_failed, 1);
+            break;
+        }
+
+        if (event == CAPTURE_EV_TRACK)
+        {
+            track = (int)value;
+            start = capture_tell(stream);
+        }
+        else if (event == CAPTURE_EV_END && track >= 0)
+        {
+            task_t task = { TASK_TRACK, file, start, capture_tell(stream), track };
+
+            if (++tracks > MAX_TRACKS)
+            {
+                fprintf(stderr, "tapescan: %s: more than %d tracks\n", file->path, MAX_TRACKS);
+                break;
+            }
+
+            atomic_fetch_add(&file->refs, 1);
+            submit(self, &task);
+            track = -1;
+        }
+    }
+}
+
+static uint32_t hist_percentile(const uint64_t *hist, uint64_t total, unsigned int percent)
+{
+    uint64_t want = (total * percent + 99) / 100;
+    uint64_t seen = 0;
+    int i;
+
+    for (i = 0; i <= HIST_BINS; i++)
+    {
+        seen += hist[i];
+
+        if (seen >= want && want)
+            return (uint32_t)(i * HIST_BIN_NS + HIST_BIN_NS / 2);
+    }
+
+    return 0;
+}
+
+/*
+ * The three tallest local maxima of a 3 bin moving sum, listed by
+ * position. A maximum within a quarter of a taller one is noise on the
+ * same peak and is skipped.
+ */
+static void hist_peaks(const uint64_t *hist, uint64_t total, uint32_t *peaks)
+{
+    uint32_t where[3] = { 0, 0, 0 };
+    uint64_t sums[HIST_BINS];
+    int order[HIST_BINS];
+    int candidates = 0;
+    int found = 0;
+    int i;
+    int j;
+
+    for (i = 1; i < HIST_BINS - 1; i++)
+        sums[i] = hist[i - 1] + hist[i] + hist[i + 1];
+
+    for (i = 2; i < HIST_BINS - 2; i++)
+    {
+        if (sums[i] >= sums[i - 1] && sums[i] > sums[i + 1] && sums[i] * PEAK_MIN_SHARE >= total)
+            order[candidates++] = i;
+    }
+
+    // Tallest first
+    for (i = 1; i < candidates; i++)
+    {
+        int bin = order[i];
+
+        for (j = i; j > 0 && sums[order[j - 1]] < sums[bin]; j--)
+            order[j] = order[j - 1];
+
+        order[j] = bin;
+    }
+
+    for (i = 0; i < candidates && found < 3; i++)
+    {
+        uint32_t ns = (uint32_t)(order[i] * HIST_BIN_NS + HIST_BIN_NS / 2);
+        bool near = false;
+
+        for (j = 0; j < found; j++)
+        {
+            uint32_t gap = (ns > where[j]) ? ns - where[j] : where[j] - ns;
+
+            if (gap * 4 < where[j])
+                near = true;
+        }
+
+        if (near)
+            continue;
+
+        where[found++] = ns;
+    }
+
+    // By position, unused slots last
+    for (i = 0; i < 3; i++)
+    {
+        for (j = i + 1; j < 3; j++)
+        {
+            if (where[j] && (!where[i] || where[j] < where[i]))
+            {
+                uint32_t swap = where[i];
+                where[i] = where[j];
+                where[j] = swap;
+            }
+        }
+
+        peaks[i] = where[i];
+    }
+}
+
+/*
+ * Two passes over the track. The first builds the interval histogram
+ * and the flux count between tach pulses, which is density per length
+ * of tape whatever the speed. The second counts dropouts against the
+ * median the first pass found.
+ */
+static void analyse_track(worker_t *self, const task_t *task, track_result_t *result)
+{
+    capture_stream_t *stream = &self->stream;
+    uint64_t *hist = self->hist;
+    double ns_per_tick = 1e9 / task->file->sample_hz;
+    uint64_t window = 0;
+    uint64_t threshold;
+    uint32_t value;
+    int event;
+
+    memset(result, 0, sizeof(*result));
+    memset(hist, 0, sizeof(self->hist));
+
+    capture_stream_init(stream, task->file->fd, task->start, task->end);
+
+    while ((event = capture_next(stream, &value)) > CAPTURE_EV_EOF)
+    {
+        if (event == CAPTURE_EV_INTERVAL)
+        {
+            uint64_t ns = (uint64_t)(value * ns_per_tick + 0.5);
+            uint64_t bin = ns / HIST_BIN_NS;
+
+            hist[bin < HIST_BINS ? bin : HIST_BINS]++;
+            result->transitions++;
+            result->total_ns += ns;
+            window++;
+        }
+        else if (event == CAPTURE_EV_TACH)
+        {
+            // The flux before the first pulse is a partial window
+            if (result->tach == 1)
+            {
+                result->flux_per_tach_min = result->flux_per_tach_max = (double)window;
+            }
+            else if (result->tach > 1)
+            {
+                if (window < result->flux_per_tach_min)
+                    result->flux_per_tach_min = (double)window;
+                if (window > result->flux_per_tach_max)
+                    result->flux_per_tach_max = (double)window;
+            }
+
+            result->tach++;
+            window = 0;
+        }
+    }
+
+    if (!result->transitions)
+        return;
+
+    result->p1 = hist_percentile(hist, result->transitions, 1);
+    result->p50 = hist_percentile(hist, result->transitions, 50);
+    result->p99 = hist_percentile(hist, result->transitions, 99);
+    hist_peaks(hist, result->transitions, result->peaks);
+
+    threshold = (uint64_t)result->p50 * DROPOUT_FACTOR;
+
+    capture_stream_init(stream, task->file->fd, task->start, task->end);
+
+    while ((event = capture_next(stream, &value)) > CAPTURE_EV_EOF)
+    {
+        if (event == CAPTURE_EV_INTERVAL)
+        {
+            uint64_t ns = (uint64_t)(value * ns_per_tick + 0.5);
+
+            if (ns > threshold)
+            {
+                result->dropouts++;
+                result->dropout_ns += ns;
+            }
+        }
+    }
+}
+
+static void write_row(const task_t *task, const track_result_t *r)
+{
+    double seconds = r->total_ns / 1e9;
+    double per_tach = (r->tach > 1) ? (double)r->transitions / r->tach : 0;
+
+    pthread_mutex_lock(&_g_csv_lock);
+
+    fprintf(_g_csv, "%s,%d,%llu,%llu,%.1f,%.0f,%u,%u,%u,%u,%u,%u,%llu,%.1f,%.2f,%.0f,%.0f,%.1f\n",
+        task->file->path, task->track,
+        (unsigned long long)r->transitions, (unsigned long long)r->tach,
+        seconds * 1000,
+        r->transitions ? (double)r->total_ns / r->transitions : 0,
+        r->p1, r->p50, r->p99, r->peaks[0], r->peaks[1], r->peaks[2],
+        (unsigned long long)r->dropouts, r->dropout_ns / 1000.0,
+        per_tach, r->flux_per_tach_min, r->flux_per_tach_max,
+        seconds > 0 ? r->tach / seconds : 0);
+
+    pthread_mutex_unlock(&_g_csv_lock);
+}
+
+static void run_task(worker_t *self, task_t *task)
+{
+    if (task->kind == TASK_INDEX)
+    {
+        index_file(self, task->file);
+    }
+    else
+    {
+        track_result_t result;
+
+        analyse_track(self, task, &result);
+        write_row(task, &result);
+        atomic_fetch_add(&_g_tracks_done, 1);
+    }
+
+    file_release(task->file);
+    task_done();
+}
+
+static bool all_done(void)
+{
+    return atomic_load(&_g_producer_done) && !atomic_load(&_g_outstanding);
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *self = arg;
+    task_t task;
+
+    for (;;)
+    {
+        if (take_task(self, &task))
+        {
+            run_task(self, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&_g_idle_lock);
+        atomic_fetch_add(&_g_idle_waiters, 1);
+
+        while (!atomic_load(&_g_queued) && !all_done())
+            pthread_cond_wait(&_g_idle_cond, &_g_idle_lock);
+
+        atomic_fetch_sub(&_g_idle_waiters, 1);
+        pthread_mutex_unlock(&_g_idle_lock);
+
+        if (all_done())
+            break;
+    }
+
+    return NULL;
+}
+
+static bool is_capture(const char *name)
+{
+    size_t len = strlen(name);
+
+    return len > 5 && !strcmp(name + len - 5, ".tcap");
+}
+
+/* Feeds one index task per capture, never holding more than the limit open */
+static void produce(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    int next = 0;
+
+    if (!d)
+    {
+        fprintf(stderr, "tapescan: %s: %s\n", dir, strerror(errno));
+        exit(1);
+    }
+
+    while ((entry = readdir(d)) != NULL)
+    {
+        capture_header_t header;
+        capture_file_t *file;
+        task_t task;
+
+        if (!is_capture(entry->d_name))
+            continue;
+
+        pthread_mutex_lock(&_g_files_lock);
+        while (_g_files_open >= _g_files_limit)
+            pthread_cond_wait(&_g_files_cond, &_g_files_lock);
+        pthread_mutex_unlock(&_g_files_lock);
+
+        file = calloc(1, sizeof(*file));
+        if (!file)
+        {
+            perror("tapescan: calloc");
+            exit(1);
+        }
+
+        snprintf(file->path, sizeof(file->path), "%s/%s", dir, entry->d_name);
+        file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+
+        if (file->fd < 0 || capture_read_header(file->fd, &header) < 0)
+        {
+            fprintf(stderr, "tapescan: %s: not a readable capture\n", file->path);
+            atomic_fetch_add(&_g_files_failed, 1);
+            if (file->fd >= 0)
+                close(file->fd);
+            free(file);
+            continue;
+        }
+
+        file->sample_hz = header.sample_hz;
+        atomic_init(&file->refs, 1);
+
+        pthread_mutex_lock(&_g_files_lock);
+        _g_files_open++;
+        pthread_mutex_unlock(&_g_files_lock);
+
+        task.kind = TASK_INDEX;
+        task.file = file;
+        task.start = task.end = 0;
+        task.track = -1;
+
+        atomic_fetch_add(&_g_outstanding, 1);
+
+        // Spread the index tasks round robin; track tasks then get stolen
+        while (!deque_push(&_g_workers[next].deque, &task))
+            next = (next + 1) % _g_worker_count;
+
+        next = (next + 1) % _g_worker_count;
+    }
+
+    closedir(d);
+
+    atomic_store(&_g_producer_done, 1);
+    wake_idle(true);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: tapescan [-j threads] [-f open_files] [-o summary.csv] directory\n"
+        "\t-j\tworker threads, default one per online CPU\n"
+        "\t-f\tcaptures open at once, default four per thread\n"
+        "\t-o\toutput file, default standard output\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = NULL;
+    int opt;
+    int i;
+
+    _g_worker_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    while ((opt = getopt(argc, argv, "j:f:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j':
+                _g_worker_count = atoi(optarg);
+                break;
+            case 'f':
+                _g_files_limit = atoi(optarg);
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind != argc - 1 || _g_worker_count < 1)
+        usage();
+
+    if (_g_files_limit < 1)
+        _g_files_limit = _g_worker_count * 4;
+
+    _g_csv = out ? fopen(out, "w") : stdout;
+    if (!_g_csv)
+    {
+        fprintf(stderr, "tapescan: %s: %s\n", out, strerror(errno));
+        return 1;
+    }
+
+    fprintf(_g_csv, "file,track,transitions,tach,duration_ms,mean_ns,p1_ns,p50_ns,p99_ns,"
+        "peak1_ns,peak2_ns,peak3_ns,dropouts,dropout_us,flux_per_tach,flux_per_tach_min,"
+        "flux_per_tach_max,tach_per_s\n");
+
+    _g_workers = calloc(_g_worker_count, sizeof(worker_t));
+    if (!_g_workers)
+    {
+        perror("tapescan: calloc");
+        return 1;
+    }
+
+    for (i = 0; i < _g_worker_count; i++)
+    {
+        _g_workers[i].id = i;
+        _g_workers[i].seed = (unsigned int)i * 2654435761u + 1;
+        pthread_mutex_init(&_g_workers[i].deque.lock, NULL);
+    }
+
+    for (i = 0; i < _g_worker_count; i++)
+    {
+        if (pthread_create(&_g_workers[i].thread, NULL, worker_main, &_g_workers[i]))
+        {
+            perror("tapescan: pthread_create");
+            return 1;
+        }
+    }
+
+    produce(argv[optind]);
+
+    for (i = 0; i < _g_worker_count; i++)
+        pthread_join(_g_workers[i].thread, NULL);
+
+    if (out)
+        fclose(_g_csv);
+
+    fprintf(stderr, "tapescan: %ld tracks, %ld captures failed, %d threads\n",
+        atomic_load(&_g_tracks_done), atomic_load(&_g_files_failed), _g_worker_count);
+
+    return atomic_load(&_g_files_failed) ? 1 : 0;
+}
@@ -0,0 +1,621 @@
+/*
+ * File:   tcx.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:56
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "tcx.h"
+
+// The mapped structures are used as they are
+typedef char tcx_header_size[(sizeof(tcx_header_t) == 64) ? 1 : -1];
+typedef char tcx_track_size[(sizeof(tcx_track_t) == 32) ? 1 : -1];
+typedef char tcx_chunk_size[(sizeof(tcx_chunk_t) == 32) ? 1 : -1];
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "tcx maps little endian structures directly"
+#endif
+
+#define TCX_ALIGN               8
+
+/* Reader */
+
+int tcx_open(tcx_file_t *file, const char *path)
+{
+    struct stat st;
+    const tcx_header_t *header;
+
+    memset(file, 0, sizeof(*file));
+
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0)
+        return -1;
+
+    if (fstat(file->fd, &st) < 0 || (size_t)st.st_size < sizeof(tcx_header_t))
+        goto bad;
+
+    file->size = (size_t)st.st_size;
+    file->map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+
+    if (file->map == MAP_FAILED)
+    {
+        file->map = NULL;
+        goto bad;
+    }
+
+    header = (const tcx_header_t *)file->map;
+
+    if (memcmp(header->magic, TCX_MAGIC, 4) || header->version != TCX_VERSION ||
+            header->track_table % TCX_ALIGN ||
+            header->track_table + (uint64_t)header->track_count * sizeof(tcx_track_t) > file->size)
+        goto bad;
+
+    file->header = header;
+    file->tracks = (const tcx_track_t *)(file->map + header->track_table);
+
+    return 0;
+
+bad:
+    tcx_close(file);
+    errno = EINVAL;
+    return -1;
+}
+
+void tcx_close(tcx_file_t *file)
+{
+    if (file->map)
+        munmap((void *)file->map, file->size);
+
+    if (file->fd >= 0)
+        close(file->fd);
+
+    file->map = NULL;
+    file->fd = -1;
+}
+
+const tcx_track_t *tcx_find_track(const tcx_file_t *file, unsigned int track)
+{
+    uint32_t i;
+
+    for (i = 0; i < file->header->track_count; i++)
+    {
+        if (file->tracks[i].track == track)
+            return &file->tracks[i];
+    }
+
+    return NULL;
+}
+
+/* The track's index, or NULL if it does not lie inside the file */
+const tcx_chunk_t *tcx_chunks(const tcx_file_t *file, const tcx_track_t *track)
+{
+    if (track->index % TCX_ALIGN ||
+            track->index + (uint64_t)track->chunk_count * sizeof(tcx_chunk_t) > file->size)
+        return NULL;
+
+    return (const tcx_chunk_t *)(file->map + track->index);
+}
+
+int tcx_cursor_init(tcx_cursor_t *cursor, const tcx_file_t *file, const tcx_chunk_t *chunk)
+{
+    if (chunk->offset + chunk->size > file->size)
+        return -1;
+
+    cursor->chunk = chunk;
+    cursor->p = file->map + chunk->offset;
+    cursor->end = cursor->p + chunk->size;
+    cursor->previous = 0;
+    cursor->run = 0;
+    cursor->word = 0;
+
+    return 0;
+}
+
+static bool get_varint(tcx_cursor_t *cursor, uint32_t *value)
+{
+    uint32_t result = 0;
+    unsigned int shift = 0;
+
+    while (cursor->p < cursor->end && shift < 35)
+    {
+        uint8_t byte = *cursor->p++;
+
+        result |= (uint32_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return true;
+        }
+
+        shift += 7;
+    }
+
+    return false;
+}
+
+/* Next .tcap word of a raw or run length chunk */
+static int next_word(tcx_cursor_t *cursor, uint16_t *word)
+{
+    if (cursor->chunk->encoding == TCX_RAW)
+    {
+        if (cursor->end - cursor->p < 2)
+            return cursor->p == cursor->end ? 0 : -1;
+
+        *word = (uint16_t)(cursor->p[0] | (cursor->p[1] << 8));
+        cursor->p += 2;
+        return 1;
+    }
+
+    if (!cursor->run)
+    {
+        uint32_t run;
+        uint32_t value;
+
+        if (cursor->p == cursor->end)
+            return 0;
+
+        if (!get_varint(cursor, &run) || !get_varint(cursor, &value) || !run || value > 0xFFFF)
+            return -1;
+
+        cursor->run = run;
+        cursor->word = (uint16_t)value;
+    }
+
+    cursor->run--;
+    *word = cursor->word;
+    return 1;
+}
+
+/* Returns a CAPTURE_EV_* event, as capture_next() does for a .tcap */
+int tcx_cursor_next(tcx_cursor_t *cursor, uint32_t *value)
+{
+    uint16_t word;
+    uint16_t lo;
+    uint16_t hi;
+    int got;
+
+    if (cursor->chunk->encoding == TCX_DELTA)
+    {
+        uint32_t coded;
+        int32_t delta;
+
+        if (cursor->p == cursor->end)
+            return CAPTURE_EV_EOF;
+
+        if (!get_varint(cursor, &coded))
+            return CAPTURE_EV_ERROR;
+
+        if (!coded)
+            return CAPTURE_EV_TACH;
+
+        coded--;
+        delta = (int32_t)(coded >> 1) ^ -(int32_t)(coded & 1);
+        cursor->previous += (uint32_t)delta;
+        *value = cursor->previous;
+        return CAPTURE_EV_INTERVAL;
+    }
+
+    if (cursor->chunk->encoding != TCX_RAW && cursor->chunk->encoding != TCX_RLE)
+        return CAPTURE_EV_ERROR;
+
+    got = next_word(cursor, &word);
+
+    if (got <= 0)
+        return got ? CAPTURE_EV_ERROR : CAPTURE_EV_EOF;
+
+    if (word)
+    {
+        *value = word;
+        return CAPTURE_EV_INTERVAL;
+    }
+
+    if (next_word(cursor, &word) <= 0)
+        return CAPTURE_EV_ERROR;
+
+    if (word == CAPTURE_TACH)
+        return CAPTURE_EV_TACH;
+
+    if (word != CAPTURE_LONG || next_word(cursor, &lo) <= 0 || next_word(cursor, &hi) <= 0)
+        return CAPTURE_EV_ERROR;
+
+    *value = lo | ((uint32_t)hi << 16);
+    return CAPTURE_EV_INTERVAL;
+}
+
+/*
+ * Leaves the cursor just after tach pulse 'tach' of the track (0 is the
+ * start of the track). The chunk is found by binary search on its first
+ * tach, then at most TCX_CHUNK_TACH pulses are decoded to get there.
+ */
+int tcx_seek(tcx_cursor_t *cursor, const tcx_file_t *file, const tcx_track_t *track, uint32_t tach)
+{
+    const tcx_chunk_t *chunks = tcx_chunks(file, track);
+    uint32_t lo = 0;
+    uint32_t hi;
+    uint32_t skip;
+    uint32_t value;
+
+    if (!chunks || !track->chunk_count || tach > track->tach_count)
+        return -1;
+
+    // Last chunk that starts before pulse 'tach'
+    hi = track->chunk_count;
+
+    while (hi - lo > 1)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (chunks[mid].first_tach < tach)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    if (tcx_cursor_init(cursor, file, &chunks[lo]) < 0)
+        return -1;
+
+    for (skip = tach - chunks[lo].first_tach; skip; )
+    {
+        int event = tcx_cursor_next(cursor, &value);
+
+        if (event == CAPTURE_EV_TACH)
+            skip--;
+        else if (event <= CAPTURE_EV_EOF)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Writer */
+
+struct tcx_writer {
+    FILE *fp;
+    uint64_t pos;
+    unsigned int flags;
+    tcx_header_t header;
+
+    tcx_track_t *tracks;
+    size_t track_room;
+
+    bool in_track;
+    tcx_track_t current;
+    tcx_chunk_t *chunks;
+    size_t chunk_room;
+
+    // The chunk being built, as .tcap words
+    uint16_t *words;
+    size_t word_count;
+    size_t word_room;
+    uint32_t chunk_tach;
+    uint32_t chunk_transitions;
+
+    uint8_t *encoded;
+    size_t encoded_room;
+};
+
+static int grow(void **buf, size_t *room, size_t need, size_t size)
+{
+    size_t want = *room ? *room : 64;
+    void *p;
+
+    if (need <= *room)
+        return 0;
+
+    while (want < need)
+        want *= 2;
+
+    p = realloc(*buf, want * size);
+    if (!p)
+        return -1;
+
+    *buf = p;
+    *room = want;
+    return 0;
+}
+
+static int put_bytes(tcx_writer_t *writer, const void *data, size_t len)
+{
+    if (len && fwrite(data, 1, len, writer->fp) != len)
+        return -1;
+
+    writer->pos += len;
+    return 0;
+}
+
+static int pad(tcx_writer_t *writer)
+{
+    static const uint8_t zeros[TCX_ALIGN];
+
+    return put_bytes(writer, zeros, (TCX_ALIGN - writer->pos % TCX_ALIGN) % TCX_ALIGN);
+}
+
+static int put_word(tcx_writer_t *writer, uint16_t word)
+{
+    if (grow((void **)&writer->words, &writer->word_room, writer->word_count + 1, sizeof(uint16_t)) < 0)
+        return -1;
+
+    writer->words[writer->word_count++] = word;
+    return 0;
+}
+
+static size_t put_varint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80)
+    {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/* Worst case for either encoding is five bytes per word */
+static size_t encode_delta(const uint16_t *words, size_t count, uint8_t *out)
+{
+    uint32_t previous = 0;
+    size_t n = 0;
+    size_t i = 0;
+
+    while (i < count)
+    {
+        uint32_t value;
+        int32_t delta;
+
+        if (words[i])
+        {
+            value = words[i++];
+        }
+        else if (words[i + 1] == CAPTURE_TACH)
+        {
+            out[n++] = 0;
+            i += 2;
+            continue;
+        }
+        else
+        {
+            value = words[i + 2] | ((uint32_t)words[i + 3] << 16);
+            i += 4;
+        }
+
+        delta = (int32_t)(value - previous);
+        n += put_varint(out + n, (((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31)) + 1);
+        previous = value;
+    }
+
+    return n;
+}
+
+static size_t encode_rle(const uint16_t *words, size_t count, uint8_t *out)
+{
+    size_t n = 0;
+    size_t i = 0;
+
+    while (i < count)
+    {
+        size_t run = 1;
+
+        while (i + run < count && words[i + run] == words[i])
+            run++;
+
+        n += put_varint(out + n, (uint32_t)run);
+        n += put_varint(out + n, words[i]);
+        i += run;
+    }
+
+    return n;
+}
+
+static int flush_chunk(tcx_writer_t *writer)
+{
+    tcx_chunk_t *chunk;
+    const void *data = writer->words;
+    size_t size = writer->word_count * sizeof(uint16_t);
+    uint16_t encoding = TCX_RAW;
+
+    if (!writer->word_count)
+        return 0;
+
+    if (writer->flags & TCX_COMPRESS)
+    {
+        size_t delta_size;
+        size_t rle_size;
+
+        if (grow((void **)&writer->encoded, &writer->encoded_room, writer->word_count * 10, 1) < 0)
+            return -1;
+
+        // Both encodings share one buffer, each in its own half
+        delta_size = encode_delta(writer->words, writer->word_count, writer->encoded);
+        rle_size = encode_rle(writer->words, writer->word_count, writer->encoded + writer->word_count * 5);
+
+        if (delta_size < size && delta_size <= rle_size)
+        {
+            encoding = TCX_DELTA;
+            data = writer->encoded;
+            size = delta_size;
+        }
+        else if (rle_size < size)
+        {
+            encoding = TCX_RLE;
+            data = writer->encoded + writer->word_count * 5;
+            size = rle_size;
+        }
+    }
+
+    if (grow((void **)&writer->chunks, &writer->chunk_room, writer->current.chunk_count + 1, sizeof(tcx_chunk_t)) < 0)
+        return -1;
+
+    if (pad(writer) < 0)
+        return -1;
+
+    chunk = &writer->chunks[writer->current.chunk_count++];
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->first_tach = writer->current.tach_count - writer->chunk_tach;
+    chunk->tach_count = writer->chunk_tach;
+    chunk->offset = writer->pos;
+    chunk->size = (uint32_t)size;
+    chunk->transitions = writer->chunk_transitions;
+    chunk->encoding = encoding;
+
+    if (put_bytes(writer, data, size) < 0)
+        return -1;
+
+    writer->word_count = 0;
+    writer->chunk_tach = 0;
+    writer->chunk_transitions = 0;
+
+    return 0;
+}
+
+tcx_writer_t *tcx_create(const char *path, uint32_t sample_hz, unsigned int flags)
+{
+    tcx_writer_t *writer = calloc(1, sizeof(*writer));
+
+    if (!writer)
+        return NULL;
+
+    writer->fp = fopen(path, "wb");
+    if (!writer->fp)
+    {
+        free(writer);
+        return NULL;
+    }
+
+    writer->flags = flags;
+    memcpy(writer->header.magic, TCX_MAGIC, 4);
+    writer->header.version = TCX_VERSION;
+    writer->header.flags = (uint16_t)flags;
+    writer->header.sample_hz = sample_hz;
+
+    // Rewritten by tcx_finish() once the track table is placed
+    if (put_bytes(writer, &writer->header, sizeof(writer->header)) < 0)
+    {
+        fclose(writer->fp);
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+int tcx_track_begin(tcx_writer_t *writer, unsigned int track)
+{
+    if (writer->in_track && tcx_track_end(writer) < 0)
+        return -1;
+
+    memset(&writer->current, 0, sizeof(writer->current));
+    writer->current.track = (uint16_t)track;
+    writer->in_track = true;
+
+    return 0;
+}
+
+int tcx_interval(tcx_writer_t *writer, uint32_t ticks)
+{
+    if (!writer->in_track || !ticks)
+        return -1;
+
+    writer->current.transitions++;
+    writer->chunk_transitions++;
+
+    if (ticks <= 0xFFFF)
+        return put_word(writer, (uint16_t)ticks);
+
+    if (put_word(writer, 0) < 0 || put_word(writer, CAPTURE_LONG) < 0 ||
+            put_word(writer, (uint16_t)ticks) < 0 || put_word(writer, (uint16_t)(ticks >> 16)) < 0)
+        return -1;
+
+    return 0;
+}
+
+/* A full chunk is closed here so every later chunk starts with its tach pulse */
+int tcx_tach(tcx_writer_t *writer)
+{
+    if (!writer->in_track)
+        return -1;
+
+    if (writer->chunk_tach == TCX_CHUNK_TACH && flush_chunk(writer) < 0)
+        return -1;
+
+    writer->current.tach_count++;
+    writer->chunk_tach++;
+
+    if (put_word(writer, 0) < 0 || put_word(writer, CAPTURE_TACH) < 0)
+        return -1;
+
+    return 0;
+}
+
+int tcx_track_end(tcx_writer_t *writer)
+{
+    size_t size;
+
+    if (!writer->in_track)
+        return -1;
+
+    if (flush_chunk(writer) < 0 || pad(writer) < 0)
+        return -1;
+
+    writer->current.index = writer->pos;
+    size = writer->current.chunk_count * sizeof(tcx_chunk_t);
+
+    if (put_bytes(writer, writer->chunks, size) < 0)
+        return -1;
+
+    if (grow((void **)&writer->tracks, &writer->track_room, writer->header.track_count + 1, sizeof(tcx_track_t)) < 0)
+        return -1;
+
+    writer->tracks[writer->header.track_count++] = writer->current;
+    writer->in_track = false;
+
+    return 0;
+}
+
+int tcx_finish(tcx_writer_t *writer)
+{
+    int result = 0;
+
+    if (writer->in_track && tcx_track_end(writer) < 0)
+        result = -1;
+
+    if (!result && pad(writer) < 0)
+        result = -1;
+
+    writer->header.track_table = writer->pos;
+
+    if (!result && put_bytes(writer, writer->tracks, writer->header.track_count * sizeof(tcx_track_t)) < 0)
+        result = -1;
+
+    if (!result && (fseek(writer->fp, 0, SEEK_SET) < 0 ||
+            fwrite(&writer->header, sizeof(writer->header), 1, writer->fp) != 1))
+        result = -1;
+
+    if (fclose(writer->fp) != 0)
+        result = -1;
+
+    free(writer->tracks);
+    free(writer->chunks);
+    free(writer->words);
+    free(writer->encoded);
+    free(writer);
+
+    return result;
+}
@@ -0,0 +1,122 @@
+/*
+ * File:   tcx.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:56
+ *
+ * Indexed tape capture container (.tcx).
+ *
+ * The same flux intervals and tach pulses as a .tcap, cut per track into
+ * chunks that each start on a tach pulse, with an index per track keyed
+ * by tach position. A reader maps the file and finds "track 5, tach
+ * 40000" with a binary search over that track's index, then decodes one
+ * chunk. Raw chunks are read in place from the mapping.
+ *
+ *   tcx_header_t             at 0
+ *   per track, in write order:
+ *     chunk data             each chunk 8 byte aligned
+ *     tcx_chunk_t[]          the track's index, at tcx_track_t.index
+ *   tcx_track_t[]            at header.track_table
+ *
+ * All fields are little endian and naturally aligned, so on a little
+ * endian host the mapped structures are used directly.
+ *
+ * Chunk encodings:
+ *   TCX_RAW      .tcap body words: non-zero intervals, zero escapes
+ *                for CAPTURE_TACH and CAPTURE_LONG
+ *   TCX_DELTA    LEB128 varints: 0 is a tach pulse, otherwise
+ *                zigzag(interval - previous interval) + 1
+ *   TCX_RLE      LEB128 pairs of run length and .tcap word, which
+ *                suits captures quantised to a few interval values
+ */
+
+#ifndef __TCX_H__
+#define __TCX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define TCX_MAGIC               "TCX1"
+#define TCX_VERSION             1
+
+#define TCX_RAW                 0
+#define TCX_DELTA               1
+#define TCX_RLE                 2
+
+// Writer flags
+#define TCX_COMPRESS            0x0001  /* store each chunk in its smallest encoding */
+
+#define TCX_CHUNK_TACH          16      /* tach pulses per chunk */
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t flags;
+    uint32_t sample_hz;
+    uint32_t track_count;
+    uint64_t track_table;
+    uint8_t reserved[40];
+} tcx_header_t;
+
+typedef struct {
+    uint16_t track;
+    uint16_t reserved;
+    uint32_t chunk_count;
+    uint64_t index;             /* offset of this track's tcx_chunk_t[] */
+    uint64_t transitions;
+    uint32_t tach_count;
+    uint32_t reserved2;
+} tcx_track_t;
+
+typedef struct {
+    uint32_t first_tach;        /* tach pulses before the chunk on this track */
+    uint32_t tach_count;
+    uint64_t offset;
+    uint32_t size;              /* stored bytes */
+    uint32_t transitions;
+    uint16_t encoding;
+    uint16_t reserved;
+    uint32_t reserved2;
+} tcx_chunk_t;
+
+/* Reader */
+
+typedef struct {
+    int fd;
+    const uint8_t *map;
+    size_t size;
+    const tcx_header_t *header;
+    const tcx_track_t *tracks;
+} tcx_file_t;
+
+typedef struct {
+    const tcx_chunk_t *chunk;
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t previous;          /* TCX_DELTA */
+    uint32_t run;               /* TCX_RLE: repeats left of word */
+    uint16_t word;
+} tcx_cursor_t;
+
+int tcx_open(tcx_file_t *file, const char *path);
+void tcx_close(tcx_file_t *file);
+const tcx_track_t *tcx_find_track(const tcx_file_t *file, unsigned int track);
+const tcx_chunk_t *tcx_chunks(const tcx_file_t *file, const tcx_track_t *track);
+int tcx_cursor_init(tcx_cursor_t *cursor, const tcx_file_t *file, const tcx_chunk_t *chunk);
+int tcx_seek(tcx_cursor_t *cursor, const tcx_file_t *file, const tcx_track_t *track, uint32_t tach);
+int tcx_cursor_next(tcx_cursor_t *cursor, uint32_t *value);
+
+/* Writer */
+
+typedef struct tcx_writer tcx_writer_t;
+
+tcx_writer_t *tcx_create(const char *path, uint32_t sample_hz, unsigned int flags);
+int tcx_track_begin(tcx_writer_t *writer, unsigned int track);
+int tcx_interval(tcx_writer_t *writer, uint32_t ticks);
+int tcx_tach(tcx_writer_t *writer);
+int tcx_track_end(tcx_writer_t *writer);
+int tcx_finish(tcx_writer_t *writer);
+
+#endif /* __TCX_H__ */
@@ -0,0 +1,225 @@
+/*
+ * File:   tcxbench.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:56
+ *
+ * Random access benchmark for .tcx containers.
+ *
+ * Each seek picks a random track and tach position, seeks there through
+ * the index and decodes the flux up to the next tach pulse, which is the
+ * access an analysis tool makes when it looks at one spot on the tape.
+ * With -r the same kind of seek is timed against the original .tcap,
+ * which has no index and has to be read from the start.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "tcx.h"
+
+#define RESCAN_SEEKS        20      /* .tcap seeks are slow, keep the count down */
+
+static capture_stream_t _g_stream;
+static uint64_t _g_checksum;        /* keeps the decode from being optimised out */
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static int seek_tcx(const tcx_file_t *file, const tcx_track_t *track, uint32_t tach)
+{
+    tcx_cursor_t cursor;
+    uint32_t value;
+    int event;
+
+    if (tcx_seek(&cursor, file, track, tach) < 0)
+        return -1;
+
+    // On to the end of this tach window, crossing into the next chunk if need be
+    for (;;)
+    {
+        event = tcx_cursor_next(&cursor, &value);
+
+        if (event == CAPTURE_EV_INTERVAL)
+            _g_checksum += value;
+        else if (event == CAPTURE_EV_TACH)
+            return 0;
+        else if (event == CAPTURE_EV_EOF)
+        {
+            const tcx_chunk_t *next = cursor.chunk + 1;
+
+            if (next == tcx_chunks(file, track) + track->chunk_count)
+                return 0;
+
+            if (tcx_cursor_init(&cursor, file, next) < 0)
+                return -1;
+        }
+        else
+            return -1;
+    }
+}
+
+/* The same seek without an index: read from the top of the capture */
+static int seek_tcap(int fd, unsigned int track, uint32_t tach)
+{
+    uint32_t value;
+    bool in_track = false;
+    uint32_t seen = 0;
+    int event;
+
+    capture_stream_init(&_g_stream, fd, CAPTURE_HEADER_SIZE, lseek(fd, 0, SEEK_END));
+
+    while ((event = capture_next(&_g_stream, &value)) > CAPTURE_EV_EOF)
+    {
+        if (event == CAPTURE_EV_TRACK)
+            in_track = (value == track);
+        else if (!in_track)
+            continue;
+        else if (event == CAPTURE_EV_END)
+            return 0;
+        else if (event == CAPTURE_EV_TACH && ++seen > tach)
+            return 0;
+        else if (event == CAPTURE_EV_INTERVAL && seen == tach)
+            _g_checksum += value;
+    }
+
+    return event;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: tcxbench [-n seeks] [-s seed] [-r capture.tcap] file.tcx\n"
+        "\t-n\trandom seeks to time, default 100000\n"
+        "\t-s\trandom seed, default 1\n"
+        "\t-r\talso time seeks by rescanning the original capture\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    tcx_file_t file;
+    const char *rescan = NULL;
+    long seeks = 100000;
+    uint64_t seed = 1;
+    uint64_t state;
+    double start;
+    double elapsed;
+    long i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                seeks = atol(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'r':
+                rescan = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind != argc - 1 || seeks < 1)
+        usage();
+
+    if (tcx_open(&file, argv[optind]) < 0)
+    {
+        fprintf(stderr, "tcxbench: %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    if (!file.header->track_count)
+    {
+        fprintf(stderr, "tcxbench: %s: no tracks\n", argv[optind]);
+        return 1;
+    }
+
+    state = seed;
+    start = now();
+
+    for (i = 0; i < seeks; i++)
+    {
+        const tcx_track_t *track = &file.tracks[next_random(&state) % file.header->track_count];
+        uint32_t tach = next_random(&state) % (track->tach_count + 1);
+
+        if (seek_tcx(&file, track, tach) < 0)
+        {
+            fprintf(stderr, "tcxbench: seek to track %u tach %u failed\n", track->track, tach);
+            return 1;
+        }
+    }
+
+    elapsed = now() - start;
+    printf("tcx:  %ld seeks in %.3f s, %.0f seeks/s, %.2f us/seek\n",
+        seeks, elapsed, seeks / elapsed, elapsed * 1e6 / seeks);
+
+    if (rescan)
+    {
+        int fd = open(rescan, O_RDONLY | O_CLOEXEC);
+        capture_header_t header;
+
+        if (fd < 0 || capture_read_header(fd, &header) < 0)
+        {
+            fprintf(stderr, "tcxbench: %s: not a capture\n", rescan);
+            return 1;
+        }
+
+        if (seeks > RESCAN_SEEKS)
+            seeks = RESCAN_SEEKS;
+
+        state = seed;
+        start = now();
+
+        for (i = 0; i < seeks; i++)
+        {
+            const tcx_track_t *track = &file.tracks[next_random(&state) % file.header->track_count];
+            uint32_t tach = next_random(&state) % (track->tach_count + 1);
+
+            if (seek_tcap(fd, track->track, tach) < 0)
+            {
+                fprintf(stderr, "tcxbench: %s: bad capture\n", rescan);
+                return 1;
+            }
+        }
+
+        elapsed = now() - start;
+        printf("tcap: %ld seeks in %.3f s, %.0f seeks/s, %.2f us/seek\n",
+            seeks, elapsed, seeks / elapsed, elapsed * 1e6 / seeks);
+
+        close(fd);
+    }
+
+    tcx_close(&file);
+
+    fprintf(stderr, "tcxbench: checksum %llu\n", (unsigned long long)_g_checksum);
+
+    return 0;
+}
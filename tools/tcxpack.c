@@ -0,0 +1,201 @@
+/*
+ * File:   tcxpack.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:56
+ *
+ * Converts a .tcap capture to an indexed .tcx container.
+ *
+ * The capture is read in one sequential pass and handed to the tcx
+ * writer event by event, the same calls a capture receiver makes as
+ * flux arrives, so memory is one chunk whatever the size of the
+ * capture. With -v the result is read back through the index and
+ * compared event for event against the capture.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "tcx.h"
+
+static capture_stream_t _g_stream;
+
+static int pack(int fd, const char *out, uint32_t sample_hz, unsigned int flags)
+{
+    tcx_writer_t *writer;
+    uint32_t value;
+    int event;
+    int result = 0;
+
+    writer = tcx_create(out, sample_hz, flags);
+    if (!writer)
+    {
+        fprintf(stderr, "tcxpack: %s: %s\n", out, strerror(errno));
+        return -1;
+    }
+
+    capture_stream_init(&_g_stream, fd, CAPTURE_HEADER_SIZE, lseek(fd, 0, SEEK_END));
+
+    while (!result && (event = capture_next(&_g_stream, &value)) != CAPTURE_EV_EOF)
+    {
+        switch (event)
+        {
+            case CAPTURE_EV_TRACK:
+                result = tcx_track_begin(writer, value);
+                break;
+            case CAPTURE_EV_INTERVAL:
+                result = tcx_interval(writer, value);
+                break;
+            case CAPTURE_EV_TACH:
+                result = tcx_tach(writer);
+                break;
+            case CAPTURE_EV_END:
+                result = tcx_track_end(writer);
+                break;
+            default:
+                result = -1;
+        }
+    }
+
+    if (result)
+        fprintf(stderr, "tcxpack: bad capture near offset %lld\n", (long long)capture_tell(&_g_stream));
+
+    if (tcx_finish(writer) < 0 && !result)
+    {
+        fprintf(stderr, "tcxpack: %s: %s\n", out, strerror(errno));
+        result = -1;
+    }
+
+    return result;
+}
+
+/* Walks every chunk of the .tcx alongside the capture */
+static int verify(int fd, const char *out)
+{
+    tcx_file_t file;
+    tcx_cursor_t cursor;
+    uint32_t i;
+    uint32_t c;
+    uint32_t value;
+    uint32_t expect;
+    int event;
+    int result = 0;
+
+    if (tcx_open(&file, out) < 0)
+    {
+        fprintf(stderr, "tcxpack: %s: %s\n", out, strerror(errno));
+        return -1;
+    }
+
+    capture_stream_init(&_g_stream, fd, CAPTURE_HEADER_SIZE, lseek(fd, 0, SEEK_END));
+
+    for (i = 0; i < file.header->track_count && !result; i++)
+    {
+        const tcx_track_t *track = &file.tracks[i];
+        const tcx_chunk_t *chunks = tcx_chunks(&file, track);
+
+        if (capture_next(&_g_stream, &expect) != CAPTURE_EV_TRACK || expect != track->track || !chunks)
+            result = -1;
+
+        for (c = 0; c < track->chunk_count && !result; c++)
+        {
+            if (tcx_cursor_init(&cursor, &file, &chunks[c]) < 0)
+                result = -1;
+
+            while (!result && (event = tcx_cursor_next(&cursor, &value)) != CAPTURE_EV_EOF)
+            {
+                if (event != capture_next(&_g_stream, &expect) ||
+                        (event == CAPTURE_EV_INTERVAL && value != expect))
+                    result = -1;
+            }
+        }
+
+        if (!result && capture_next(&_g_stream, &expect) != CAPTURE_EV_END)
+            result = -1;
+    }
+
+    if (!result && capture_next(&_g_stream, &expect) != CAPTURE_EV_EOF)
+        result = -1;
+
+    if (result)
+        fprintf(stderr, "tcxpack: %s does not match the capture at track index %u\n", out, i - 1);
+
+    tcx_close(&file);
+
+    return result;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: tcxpack [-c] [-v] capture.tcap out.tcx\n"
+        "\t-c\tstore each chunk in its smallest encoding\n"
+        "\t-v\tread the result back and compare it with the capture\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    capture_header_t header;
+    unsigned int flags = 0;
+    bool check = false;
+    struct stat in_st;
+    struct stat out_st;
+    int opt;
+    int fd;
+
+    while ((opt = getopt(argc, argv, "cv")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c':
+                flags |= TCX_COMPRESS;
+                break;
+            case 'v':
+                check = true;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if (optind != argc - 2)
+        usage();
+
+    fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &in_st) < 0)
+    {
+        fprintf(stderr, "tcxpack: %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    if (capture_read_header(fd, &header) < 0)
+    {
+        fprintf(stderr, "tcxpack: %s: not a capture\n", argv[optind]);
+        return 1;
+    }
+
+    if (pack(fd, argv[optind + 1], header.sample_hz, flags) < 0)
+        return 1;
+
+    if (check && verify(fd, argv[optind + 1]) < 0)
+        return 1;
+
+    if (stat(argv[optind + 1], &out_st) == 0)
+        fprintf(stderr, "tcxpack: %lld -> %lld bytes (%.1f%%)\n", (long long)in_st.st_size,
+            (long long)out_st.st_size, 100.0 * out_st.st_size / in_st.st_size);
+
+    close(fd);
+
+    return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ * File:   tracktest.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:25
+ *
+ * Host check of what the drive can see while the firmware changes its
+ * outputs. The firmware is built for the host against the register file
+ * in pic/, and that page is write-protected: every store faults, is
+ * single-stepped and recorded, so the check sees each state the port
+ * passes through in the order the compiled code produced it.
+ *
+ * For every pair of tracks drive_select_track() must:
+ *  - leave the other outputs on PORTA and PORTD untouched,
+ *  - change the track lines in at most two consecutive stores with
+ *    interrupts masked, so no code but the old and new one is visible
+ *    except for the single instruction between the PORTD and PORTA
+ *    stores, which only happens when a change needs both ports (TR3 is
+ *    on PORTA, TR0..TR2 on PORTD).
+ * For every change of direction and motion drive_go() must update GO and
+ * REV in a single store. An emergency stop taken before any store it
+ * makes with interrupts enabled must leave GO released.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include "pic/xc.h"
+#include "../project.h"
+#include "../iopins.h"
+#include "../plan.h"
+
+#define MAX_WRITES      32
+#define TRAP_FLAG       0x100
+
+#define TRISD_ADDR      0xF95
+#define GIEH_MASK       0x80
+
+typedef struct {
+    uint16_t addr;
+    uint8_t trisa;
+    uint8_t trisd;
+    uint8_t intcon;
+} sfr_write_t;
+
+static sfr_write_t _g_writes[MAX_WRITES];
+static volatile int _g_write_count;
+static volatile uintptr_t _g_pending;
+static volatile int _g_stop_at = -1;
+static volatile bool _g_stopped;
+
+static void protect(bool on)
+{
+    if (mprotect((void *)_g_sfr, SFR_PAGE, on ? PROT_READ : PROT_READ | PROT_WRITE))
+    {
+        perror("mprotect");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// A store to the register file: let it through for one instruction
+static void on_fault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+
+    (void)sig;
+
+    if (addr < (uintptr_t)_g_sfr || addr >= (uintptr_t)_g_sfr + SFR_PAGE)
+    {
+        fprintf(stderr, "unexpected fault at %p\n", info->si_addr);
+        abort();
+    }
+
+    _g_pending = addr - (uintptr_t)_g_sfr + SFR_BASE;
+    protect(false);
+
+    // The emergency stop interrupt, taken just before this store
+    if (_g_write_count == _g_stop_at && (INTCON & GIEH_MASK))
+    {
+        EMERGENCY_STOP();
+        _g_estop = 1;
+        _g_stopped = true;
+    }
+    uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+// The store has happened: record the ports and protect the page again
+static void on_step(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    (void)sig;
+    (void)info;
+
+    if (_g_write_count < MAX_WRITES)
+    {
+        sfr_write_t *w = &_g_writes[_g_write_count++];
+
+        w->addr = (uint16_t)_g_pending;
+        w->trisa = TRISA;
+        w->trisd = TRISD;
+        w->intcon = INTCON;
+    }
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+    protect(true);
+}
+
+static uint8_t visible_track(uint8_t trisa, uint8_t trisd)
+{
+    // Open collector: a line is asserted while its TRIS bit is 0
+    return (!(trisd & TR0mask) ? 0x01 : 0) | (!(trisd & TR1mask) ? 0x02 : 0) |
+        (!(trisd & TR2mask) ? 0x04 : 0) | (!(trisa & TR3mask) ? 0x08 : 0);
+}
+
+static void start_recording(void)
+{
+    _g_write_count = 0;
+    protect(true);
+}
+
+static void stop_recording(void)
+{
+    protect(false);
+}
+
+static int check_track_change(uint8_t from, uint8_t to, int *intermediates)
+{
+    uint8_t trisa;
+    uint8_t trisd;
+    uint8_t code = from;
+    int changes = 0;
+    int last_change = -1;
+    int i;
+
+    drive_select_track(from);
+
+    // Unrelated outputs in a mixed state, to catch stray bits
+    TRISA = (TRISA & TRACK_A_MASK) | (uint8_t)(~TRACK_A_MASK & 0x5A);
+    TRISD = (TRISD & TRACK_D_MASK) | (uint8_t)(~TRACK_D_MASK & 0xA5);
+    INTCON = GIEH_MASK;
+    trisa = TRISA;
+    trisd = TRISD;
+
+    start_recording();
+    drive_select_track(to);
+    stop_recording();
+
+    for (i = 0; i < _g_write_count; i++)
+    {
+        const sfr_write_t *w = &_g_writes[i];
+        uint8_t now = visible_track(w->trisa, w->trisd);
+
+        if ((w->trisa & ~TRACK_A_MASK) != (trisa & ~TRACK_A_MASK) ||
+                (w->trisd & ~TRACK_D_MASK) != (trisd & ~TRACK_D_MASK))
+        {
+            printf("track %u to %u: other outputs changed\n", from, to);
+            return 1;
+        }
+
+        if (now == code)
+            continue;
+
+        if (w->intcon & GIEH_MASK)
+        {
+            printf("track %u to %u: lines changed with interrupts enabled\n", from, to);
+            return 1;
+        }
+
+        if (last_change >= 0 && last_change != i - 1)
+        {
+            printf("track %u to %u: track stores are not consecutive\n", from, to);
+            return 1;
+        }
+
+        if (now != to)
+            (*intermediates)++;
+
+        code = now;
+        last_change = i;
+        changes++;
+    }
+
+    if (code != to || changes > 2)
+    {
+        printf("track %u to %u: ended on %u after %d stores\n", from, to, code, changes);
+        return 1;
+    }
+
+    if (changes == 2 && ((from ^ to) & 0x08) == 0)
+    {
+        printf("track %u to %u: intermediate code without a PORTA change\n", from, to);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_motion(bool go_from, bool rev_from, bool go_to, bool rev_to)
+{
+    int stores = 0;
+    int i;
+
+    PORTC = 0;      // SLD asserted: the drive is selected
+    drive_go(go_from, rev_from);
+
+    start_recording();
+    drive_go(go_to, rev_to);
+    stop_recording();
+
+    for (i = 0; i < _g_write_count; i++)
+        if (_g_writes[i].addr == TRISD_ADDR)
+            stores++;
+
+    if (stores != 1 || OUTPUT_ASSERTED(GO) != go_to || OUTPUT_ASSERTED(REV) != rev_to)
+    {
+        printf("motion %u%u to %u%u: %d stores to TRISD\n", go_from, rev_from, go_to, rev_to, stores);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_stop_race(void)
+{
+    int failures = 0;
+    int at;
+
+    for (at = 0; at < 4; at++)
+    {
+        PORTC = 0;
+        _g_estop = 0;
+        drive_go(false, false);
+
+        _g_stop_at = at;
+        _g_stopped = false;
+        start_recording();
+        drive_go(true, false);
+        stop_recording();
+        _g_stop_at = -1;
+
+        if (_g_stopped && OUTPUT_ASSERTED(GO))
+        {
+            printf("emergency stop before store %d: GO asserted again\n", at);
+            failures++;
+        }
+    }
+
+    _g_estop = 0;
+
+    return failures;
+}
+
+int main(void)
+{
+    struct sigaction sa;
+    int failures = 0;
+    int intermediates = 0;
+    int from;
+    int to;
+    int m;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = on_fault;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = on_step;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    TRISA = 0xFF;
+    TRISD = 0xFF;
+
+    for (from = 0; from <= MAX_TRACK; from++)
+        for (to = 0; to <= MAX_TRACK; to++)
+            failures += check_track_change((uint8_t)from, (uint8_t)to, &intermediates);
+
+    for (m = 0; m < 16; m++)
+        failures += check_motion(m & 1, (m >> 1) & 1, (m >> 2) & 1, (m >> 3) & 1);
+
+    failures += check_stop_race();
+
+    printf("track changes: %d, one-instruction intermediate codes: %d (TR3 changes only)\n",
+        (MAX_TRACK + 1) * (MAX_TRACK + 1), intermediates);
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# Links every named build in the MPLAB project with XC8 and checks its
+# memory summary against the PIC18F4320. Run from tools/ ('make
+# xc8-size'). This is the real check; fwsize.sh only estimates.
+#
+# The builds are the confs in nbproject/configurations.xml. Each one
+# differs only in its define-macros, the FEATURE_xxx set it carries.
+# Names on the command line pick builds, otherwise all are linked. The
+# options match the project: PRO mode, optimised for space at level 9.
+# XC8 names the compiler driver; the options are those of XC8 1.x, which
+# the project uses.
+# Exits non-zero when a build fails to link or is over budget.
+
+XC8=${XC8:-xc8}
+CHIP=${CHIP:-18F4320}
+FLASH_BUDGET=${FLASH_BUDGET:-8192}
+RAM_BUDGET=${RAM_BUDGET:-512}
+SRC=$(cd "${SRC:-..}" && pwd) || exit 2
+PROJECT=${PROJECT:-$SRC/nbproject/configurations.xml}
+
+if ! command -v "$XC8" > /dev/null
+then
+    echo "Error: $XC8 not found; set XC8 to the XC8 1.x compiler driver" >&2
+    exit 2
+fi
+
+# One line per build: name, then its macros separated by ';'
+builds()
+{
+    awk '
+        /<conf name=/ { split($0, a, "\""); conf = a[2] }
+        /key="define-macros"/ && conf != "" {
+            split($0, a, "\"")
+            print conf, a[4]
+            conf = ""
+        }' "$PROJECT"
+}
+
+TMP=$(mktemp -d) || exit 2
+trap 'rm -rf "$TMP"' EXIT
+
+printf "%-24s %6s %6s\n" "build" "flash" "ram"
+
+builds | while read -r name macros
+do
+    if [ $# -gt 0 ]
+    then
+        case " $* " in
+            *" $name "*) ;;
+            *) continue ;;
+        esac
+    fi
+
+    defines=$(echo "$macros" | tr ';' '\n' | sed -n 's/^./-D&/p')
+
+    rm -rf "$TMP/$name"
+    mkdir "$TMP/$name"
+    if ! (cd "$TMP/$name" && "$XC8" --chip=$CHIP --mode=pro \
+            --opt=default,+asm,+asmfile,-speed,+space,9 --summary=default,+mem \
+            -I"$SRC" $defines -ofw.hex "$SRC"/*.c) > "$TMP/$name.log" 2>&1
+    then
+        printf "%-24s %6s %6s\n" "$name" "-" "-"
+        grep -i "error" "$TMP/$name.log" | head -5
+        echo 1 >> "$TMP/failed"
+        continue
+    fi
+
+    flash=$(sed -n 's/.*Program space *used *[0-9A-Fa-f]*h *( *\([0-9]*\)).*/\1/p' "$TMP/$name.log" | head -1)
+    ram=$(sed -n 's/.*Data space *used *[0-9A-Fa-f]*h *( *\([0-9]*\)).*/\1/p' "$TMP/$name.log" | head -1)
+    if [ -z "$flash" ] || [ -z "$ram" ]
+    then
+        echo "Error: no memory summary from $XC8 for $name"
+        echo 1 >> "$TMP/failed"
+        continue
+    fi
+    printf "%-24s %6d %6d\n" "$name" "$flash" "$ram"
+
+    if [ "$flash" -gt $FLASH_BUDGET ] || [ "$ram" -gt $RAM_BUDGET ]
+    then
+        echo "Error: $name is over the $FLASH_BUDGET/$RAM_BUDGET byte budget"
+        echo 1 >> "$TMP/failed"
+    fi
+done
+
+[ -f "$TMP/failed" ] && exit 1
+exit 0
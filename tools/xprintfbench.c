@@ -0,0 +1,166 @@
+/*
+ * File:   xprintfbench.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 09:24
+ *
+ * Host benchmark for the firmware formatter, xprintf.c built as is.
+ *
+ * Every message below is a format the firmware prints, with typical
+ * arguments. Each one is rendered by xprintf() into a buffer through
+ * putch() and by the C library's snprintf(), the outputs are compared,
+ * and the cycles per message are timed for both. Code size on the PIC18
+ * is in the 'make size' report (xprintf row); XC8's printf cannot be
+ * priced without XC8, so the comparison here is against the host printf
+ * family, which covers the same conversions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "../xprintf.h"
+
+#define ROUNDS          20000
+#define OUT_SIZE        128
+
+typedef struct {
+    const char *name;
+    int (*host)(char *out);
+    void (*firmware)(void);
+} message_t;
+
+static char _g_out[OUT_SIZE];
+static size_t _g_out_len;
+
+void putch(char c)
+{
+    if (_g_out_len < OUT_SIZE - 1)
+        _g_out[_g_out_len++] = c;
+}
+
+/*
+ * The firmware passes 16 bit ints; on the host they are plain ints, and
+ * the 'l' conversions take uint32_t, which is unsigned int here. The host
+ * side uses the matching conversions so both print the same text.
+ */
+static int host_where(char *out)
+{
+    return snprintf(out, OUT_SIZE, "Zone: %s track: %u position: %d tach\r\n", "data", 3u, -1234);
+}
+
+static void fw_where(void)
+{
+    xprintf("Zone: %s track: %u position: %d tach\r\n", "data", 3u, -1234);
+}
+
+static int host_speed(char *out)
+{
+    return snprintf(out, OUT_SIZE, "Speed: %u tach/s (%u cycles/tach)%s\r\n", 1536000u / 1200u, 1200u, " high speed");
+}
+
+static void fw_speed(void)
+{
+    xprintf("Speed: %lu tach/s (%u cycles/tach)%s\r\n", (uint32_t)(1536000u / 1200u), 1200u, " high speed");
+}
+
+static int host_stats(char *out)
+{
+    return snprintf(out, OUT_SIZE, "Uptime: %u s traversals: %u tach: %u\r\n", 86400u, 212u, 4123456u);
+}
+
+static void fw_stats(void)
+{
+    xprintf("Uptime: %lu s traversals: %u tach: %lu\r\n", (uint32_t)86400u, 212u, (uint32_t)4123456u);
+}
+
+static int host_register(char *out)
+{
+    return snprintf(out, OUT_SIZE, "EEPROM %02X: %02X\r\n", 0x4Au, 0x07u);
+}
+
+static void fw_register(void)
+{
+    xprintf("EEPROM %02x: %02x\r\n", 0x4Au, 0x07u);
+}
+
+static int host_error(char *out)
+{
+    return snprintf(out, OUT_SIZE, "Error: failed to start drive motor. Drive not selected.\r\n");
+}
+
+static void fw_error(void)
+{
+    xprintf("Error: failed to start drive motor. Drive not selected.\r\n");
+}
+
+static int host_leg(char *out)
+{
+    return snprintf(out, OUT_SIZE, "Done in %s s, saved %s s, %c\r\n", "81.4", "52.9", '*');
+}
+
+static void fw_leg(void)
+{
+    xprintf("Done in %s s, saved %s s, %c\r\n", "81.4", "52.9", '*');
+}
+
+static const message_t _g_messages[] = {
+    { "where",      host_where,     fw_where },
+    { "speed",      host_speed,     fw_speed },
+    { "stats",      host_stats,     fw_stats },
+    { "register",   host_register,  fw_register },
+    { "error",      host_error,     fw_error },
+    { "leg",        host_leg,       fw_leg },
+};
+
+#define MESSAGES    (sizeof(_g_messages) / sizeof(_g_messages[0]))
+
+int main(void)
+{
+    char expected[OUT_SIZE];
+    uint64_t start;
+    double firmware;
+    double host;
+    size_t i;
+    int r;
+    int failures = 0;
+
+    printf("message     chars  xprintf  snprintf  (cycles per message)\n");
+
+    for (i = 0; i < MESSAGES; i++)
+    {
+        const message_t *m = &_g_messages[i];
+
+        m->host(expected);
+        _g_out_len = 0;
+        m->firmware();
+        _g_out[_g_out_len] = 0;
+
+        if (strcmp(expected, _g_out))
+        {
+            printf("%-10s  output differs\n  xprintf:  %s  snprintf: %s", m->name, _g_out, expected);
+            failures++;
+            continue;
+        }
+
+        start = __rdtsc();
+        for (r = 0; r < ROUNDS; r++)
+        {
+            _g_out_len = 0;
+            m->firmware();
+        }
+        firmware = (double)(__rdtsc() - start) / ROUNDS;
+
+        start = __rdtsc();
+        for (r = 0; r < ROUNDS; r++)
+            m->host(expected);
+        host = (double)(__rdtsc() - start) / ROUNDS;
+
+        printf("%-10s  %5zu  %7.0f  %8.0f\n", m->name, strlen(expected), firmware, host);
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
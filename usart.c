@@ -19,8 +19,20 @@
 #define SPBRG SP1BRG
 #define TXREG TX1REG
 #define RCREG RC1REG
+#define RCIE_BIT PIE3bits.RC1IE
+#define RCIP_BIT IPR3bits.RC1IP
+#else
+#define RCIE_BIT PIE1bits.RCIE
+#define RCIP_BIT IPR1bits.RCIP
 #endif
 
+#define RX_BUFFER_SIZE  8
+
+/* Filled by the receive interrupt once usart1_rx_interrupt() enables it */
+static volatile char _g_rx_buf[RX_BUFFER_SIZE];
+static volatile uint8_t _g_rx_head;
+static volatile uint8_t _g_rx_tail;
+
 void usart1_open(uint8_t flags, uint8_t brg)
 {
     if (flags & USART_SYNC)
@@ -102,6 +114,9 @@ void usart1_put(char c)
 
 bool usart1_data_ready(void)
 {
+    if (RCIE_BIT)
+        return _g_rx_head != _g_rx_tail;
+
 #ifdef __PIC18_K40__
     if (PIR3bits.RC1IF)
 #else
@@ -114,10 +129,38 @@ bool usart1_data_ready(void)
 char usart1_get(void)
 {
     char data;
+
+    if (RCIE_BIT)
+    {
+        data = _g_rx_buf[_g_rx_tail];
+        _g_rx_tail = (_g_rx_tail + 1) & (RX_BUFFER_SIZE - 1);
+        return data;
+    }
+
     data = RCREG;
     return data;
 }
 
+void usart1_rx_push(char c)
+{
+    uint8_t next = (_g_rx_head + 1) & (RX_BUFFER_SIZE - 1);
+
+    // Drop the character if the buffer is full
+    if (next != _g_rx_tail)
+    {
+        _g_rx_buf[_g_rx_head] = c;
+        _g_rx_head = next;
+    }
+}
+
+void usart1_rx_interrupt(bool enable)
+{
+    _g_rx_head = 0;
+    _g_rx_tail = 0;
+    RCIP_BIT = 1;
+    RCIE_BIT = enable;
+}
+
 void usart1_clear_oerr(void)
 {
 #ifndef __PIC18_K42__
@@ -29,6 +29,8 @@ void usart1_put(char c);
 bool usart1_data_ready(void);
 char usart1_get(void);
 void usart1_clear_oerr(void);
+void usart1_rx_interrupt(bool enable);
+void usart1_rx_push(char c);
 
 #endif /* _USART1_ */
 
@@ -5,7 +5,6 @@
  * Created on 09 August 2015, 1429
  */
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -15,6 +14,9 @@
 #include "util.h"
 #include "usart.h"
 #include "config.h"
+#include "persist.h"
+#include "odometer.h"
+#include "telemetry.h"
 
 #ifdef __PIC16__
 #include "usart.h"
@@ -22,6 +24,15 @@
 
 void reset(void)
 {
+    // Keep the run state so the next boot can carry on from here
+    persist_save(&_g_rs);
+    reset_cold();
+}
+
+void reset_cold(void)
+{
+    odometer_sync();
+
     while (usart1_busy());
     /* Uses the watch dog timer to reset */
 #ifdef __PIC16__
@@ -32,12 +43,50 @@ void reset(void)
     while (1);
 }
 
+#if FEATURE_MONITOR
+static char *_g_capture;
+static uint8_t _g_capture_size;
+static uint8_t _g_capture_len;
+#endif
+
 void putch(char byte)
 {
+#if FEATURE_MONITOR
+    if (_g_capture)
+    {
+        if (_g_capture_len < _g_capture_size)
+            _g_capture[_g_capture_len++] = byte;
+        return;
+    }
+#endif
+
+    // The UART belongs to a frame until its last byte
+    telemetry_finish();
+
     while (usart1_busy());
     usart1_put(byte);
 }
 
+#if FEATURE_MONITOR
+
+/*
+ * Sends putch() output to buf instead of the UART until capture_end(),
+ * which returns how many bytes were kept. Output past size is dropped.
+ */
+void capture_start(char *buf, uint8_t size)
+{
+    _g_capture = buf;
+    _g_capture_size = size;
+    _g_capture_len = 0;
+}
+
+uint8_t capture_end(void)
+{
+    _g_capture = NULL;
+    return _g_capture_len;
+}
+#endif
+
 void delay_10ms(uint8_t delay)
 {
     uint8_t i;
@@ -48,6 +97,32 @@ void delay_10ms(uint8_t delay)
     }
 }
 
+void format_fixedpoint(char *buf, int16_t value, uint8_t type)
+{
+    char digits[5];
+    uint8_t count = 0;
+    uint16_t uvalue = (uint16_t)value;
+
+    if (type == I_1DP && value < 0)
+    {
+        *buf++ = '-';
+        uvalue = (uint16_t)-value;
+    }
+
+    // At least one digit either side of the point
+    do {
+        digits[count++] = '0' + (uvalue % _1DP_BASE);
+        uvalue /= _1DP_BASE;
+    } while (uvalue || count < 2);
+
+    while (count > 1)
+        *buf++ = digits[--count];
+
+    *buf++ = '.';
+    *buf++ = digits[0];
+    *buf = 0;
+}
+
 char wdt_getch(void)
 {
     usart1_clear_oerr();
@@ -58,30 +133,42 @@ char wdt_getch(void)
     return usart1_get();
 }
 
-void eeprom_write_data(uint8_t addr, uint8_t *bytes, uint8_t len)
+/* Starts writing one byte, or returns false if the last write is still running */
+bool eeprom_write_byte(uint8_t addr, uint8_t byte)
 {
-    uint8_t i;
+    bool gie = INTCONbits.GIE;
 
-    for (i = 0; i < len; i++)
-    {
-        while (EECON1bits.WR);
+    if (EECON1bits.WR)
+        return false;
 
-        EECON1bits.EEPGD = 0;
-        EECON1bits.CFGS = 0;
-        INTCONbits.GIE = 0;
+    EECON1bits.EEPGD = 0;
+    EECON1bits.CFGS = 0;
+    INTCONbits.GIE = 0;
 
-        EEADR = addr + i;
-        EEDATA = *bytes;
+    EEADR = addr;
+    EEDATA = byte;
 
-        EECON1bits.WREN = 1;
-        EECON1bits.EEPGD = 0;
+    EECON1bits.WREN = 1;
+    EECON1bits.EEPGD = 0;
 
-        EECON2 = 0x55;
-        EECON2 = 0xAA;
+    EECON2 = 0x55;
+    EECON2 = 0xAA;
 
-        EECON1bits.WR = 1;
+    EECON1bits.WR = 1;
 
-        INTCONbits.GIE = 1;
+    // Only the unlock sequence runs with interrupts masked
+    INTCONbits.GIE = gie;
+
+    return true;
+}
+
+void eeprom_write_data(uint8_t addr, uint8_t *bytes, uint8_t len)
+{
+    uint8_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        while (!eeprom_write_byte(addr + i, *bytes));
 
         bytes++;
     }
@@ -91,6 +178,9 @@ void eeprom_read_data(uint8_t addr, uint8_t *bytes, uint8_t len)
 {
     uint8_t i;
 
+    // odometer_poll() may have left a write running; EEADR must not change under it
+    while (EECON1bits.WR);
+
     for (i = 0; i < len; i++)
     {
         EEADR = addr + i;
@@ -100,4 +190,46 @@ void eeprom_read_data(uint8_t addr, uint8_t *bytes, uint8_t len)
         *bytes = EEDATA;
         bytes++;
     }
-}
\ No newline at end of file
+}
+
+/* CRC-16/CCITT-FALSE */
+uint16_t crc16(const uint8_t *data, uint8_t len)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+
+        for (i = 0; i < 8; i++)
+        {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc <<= 1;
+        }
+    }
+
+    return crc;
+}
+
+#if FEATURE_SHUTTLE
+static uint16_t _g_prng = 1;
+
+void prng_seed(uint16_t seed)
+{
+    // Zero is the one state xorshift never leaves
+    _g_prng = seed ? seed : 1;
+}
+
+/* 16 bit xorshift (7, 9, 8), period 65535 */
+uint16_t prng_next(void)
+{
+    _g_prng ^= _g_prng << 7;
+    _g_prng ^= _g_prng >> 9;
+    _g_prng ^= _g_prng << 8;
+
+    return _g_prng;
+}
+#endif
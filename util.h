@@ -8,16 +8,28 @@
 #ifndef __UTIL_H__
 #define	__UTIL_H__
 
+void putch(char byte);
+#if FEATURE_MONITOR
+void capture_start(char *buf, uint8_t size);
+uint8_t capture_end(void);
+#endif
 void delay_10ms(uint8_t delay);
 void reset(void);
+void reset_cold(void);
 void format_fixedpoint(char *buf, int16_t value, uint8_t type);
 void eeprom_read_data(uint8_t addr, uint8_t *bytes, uint8_t len);
 void eeprom_write_data(uint8_t addr, uint8_t *bytes, uint8_t len);
+bool eeprom_write_byte(uint8_t addr, uint8_t byte);
 char wdt_getch(void);
+uint16_t crc16(const uint8_t *data, uint8_t len);
+void prng_seed(uint16_t seed);
+uint16_t prng_next(void);
 
 #define I_1DP               0
 #define U_1DP               1
 
+#define _1DP_BASE           10
+
 #define fixedpoint_sign(value, tag) \
     char tag##_sign[2]; \
     tag##_sign[1] = 0; \
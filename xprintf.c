@@ -0,0 +1,151 @@
+/*
+ * File:   xprintf.c
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:30
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include "project.h"
+#include "util.h"
+#include "xprintf.h"
+
+static void put_number(uint32_t value, bool negative, uint8_t base, uint8_t width, char pad)
+{
+    char buf[10];
+    uint8_t count = 0;
+
+    // Most values fit 16 bits, which is far cheaper to divide on the PIC18
+    if (value <= 0xFFFF)
+    {
+        uint16_t value16 = (uint16_t)value;
+        do {
+            uint8_t digit = (uint8_t)(value16 % base);
+            buf[count++] = digit < 10 ? '0' + digit : 'A' - 10 + digit;
+            value16 /= base;
+        } while (value16);
+    }
+    else
+    {
+        do {
+            uint8_t digit = (uint8_t)(value % base);
+            buf[count++] = digit < 10 ? '0' + digit : 'A' - 10 + digit;
+            value /= base;
+        } while (value);
+    }
+
+    if (negative)
+    {
+        if (width)
+            width--;
+        if (pad == '0')
+            putch('-');
+    }
+
+    while (width > count)
+    {
+        putch(pad);
+        width--;
+    }
+
+    if (negative && pad != '0')
+        putch('-');
+
+    while (count)
+        putch(buf[--count]);
+}
+
+void xputs(const char *str)
+{
+    while (*str)
+        putch(*str++);
+}
+
+void xvprintf(const char *fmt, va_list ap)
+{
+    char c;
+
+    while ((c = *fmt++))
+    {
+        bool is_long = false;
+        uint8_t width = 0;
+        char pad = ' ';
+        uint32_t value;
+
+        if (c != '%')
+        {
+            putch(c);
+            continue;
+        }
+
+        c = *fmt++;
+
+        if (c == '0')
+        {
+            pad = '0';
+            c = *fmt++;
+        }
+
+        if (c >= '1' && c <= '9')
+        {
+            width = c - '0';
+            c = *fmt++;
+        }
+
+        if (c == 'l')
+        {
+            is_long = true;
+            c = *fmt++;
+        }
+
+        switch (c)
+        {
+            case 'd':
+            {
+                int32_t svalue = is_long ? va_arg(ap, int32_t) : va_arg(ap, int);
+                bool negative = svalue < 0;
+                put_number(negative ? (uint32_t)-svalue : (uint32_t)svalue, negative, 10, width, pad);
+                break;
+            }
+            case 'u':
+            case 'x':
+            {
+                value = is_long ? va_arg(ap, uint32_t) : va_arg(ap, unsigned int);
+                put_number(value, false, c == 'x' ? 16 : 10, width, pad);
+                break;
+            }
+            case 'c':
+            {
+                putch((char)va_arg(ap, int));
+                break;
+            }
+            case 's':
+            {
+                const char *str = va_arg(ap, const char *);
+                xputs(str ? str : "(null)");
+                break;
+            }
+            case 0:
+            {
+                return;
+            }
+            default:
+            {
+                putch(c);
+                break;
+            }
+        }
+    }
+}
+
+void xprintf(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    xvprintf(fmt, ap);
+    va_end(ap);
+}
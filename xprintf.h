@@ -0,0 +1,25 @@
+/*
+ * File:   xprintf.h
+ * Author: Matt
+ *
+ * Created on 19 October 2026, 08:30
+ */
+
+#ifndef __XPRINTF_H__
+#define __XPRINTF_H__
+
+#include <stdarg.h>
+
+/*
+ * Minimal replacement for the XC8 printf. Output goes straight to putch().
+ *
+ * Supported conversions: %d %u %x %c %s %% with an optional 'l' length
+ * modifier for 32 bit values, an optional '0' flag and a single digit
+ * field width. Fixed point values are rendered with format_fixedpoint()
+ * and printed with %s.
+ */
+void xprintf(const char *fmt, ...);
+void xvprintf(const char *fmt, va_list ap);
+void xputs(const char *str);
+
+#endif /* __XPRINTF_H__ */